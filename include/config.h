@@ -5,8 +5,17 @@
 //#define DEBUG_WIFI_STATUS_INTERVAL 10000 // Interval to print WiFi status in milliseconds
 
 // Device Configuration
+#ifdef NATIVE_TEST
+#include "configs/native-test.hpp" // Host build of the unit tests
+#else
 #include "configs/rgb-rf24-controller.hpp"
 //#include "configs/bedside-lamp.hpp"
+#endif
+
+// Derived Configuration
+#if defined(RF24RADIO_ENABLED) || defined(ESPNOW_REMOTES_ENABLED) || defined(REMOTE_LOOPBACK_ENABLED)
+#define REMOTES_ENABLED // Remote handling is needed by at least one transport
+#endif
 
 
 
@@ -3,13 +3,74 @@
 #define SW_VERSION "1.2.0" // Software version
 #define LED_MAX_VAL 1024   // Maximum value for LED brightness and color (1024 for 10-bit PWM) DO NOT CHANGE
 
+// Task Configuration, higher priorities preempt lower ones
+#define IO_TASK_PRIORITY 3           // LED transitions and buttons, highest so fades stay smooth
+#define IO_TASK_STACK_SIZE 4096      // Stack size of the io task in bytes
+#define IO_TASK_INTERVAL 10          // Maximum time between LED updates in milliseconds
+#define RADIO_TASK_PRIORITY 2        // Remote reception, above the network so remote input is not delayed by TCP
+#define RADIO_TASK_STACK_SIZE 4096   // Stack size of the radio task in bytes
+#define NETWORK_TASK_PRIORITY 1      // WiFi, MQTT, OTA and the web portal
+#define NETWORK_TASK_STACK_SIZE 8192 // Stack size of the network task in bytes, same as the Arduino loop task
+#define NETWORK_TASK_INTERVAL 10     // Maximum time the network task waits for events before polling the connections in milliseconds
+#define NETWORK_EVENT_QUEUE_LENGTH 8 // Events that can be pending for the network task
+
+// LED Configuration
+#define LIGHT_COMMAND_COALESCE_TIME 10                // Time network and remote light commands are merged before they are applied in milliseconds
+#define LIGHT_COMMAND_QUEUE_LENGTH 4                  // Merged light commands that can be pending, a scene store ends a merged command
+#define LED_POWER_ON_BEHAVIOR POWER_ON_BEHAVIOR::LAST // Light state after a power cycle, warm reboots always restore the last state
+#define LED_POWER_ON_FADE_TIME 2000                   // Fade in time of POWER_ON_BEHAVIOR::FADE_IN in milliseconds
+#define LED_SETTINGS_SAVE_DELAY 2000                  // Time the LED settings must be unchanged before they are written to NVS in milliseconds
+
+// Time Sync Configuration
+#define TIME_SYNC_SERVER "pool.ntp.org"     // SNTP server, a local server keeps lamps closer together
+#define TIME_SYNC_INTERVAL 3600000          // Interval between SNTP updates in milliseconds
+#define TIME_SYNC_MAX_SCHEDULE_AHEAD 60000  // Latest accepted start time of a light command in milliseconds from now
+
+// Local API Configuration
+#define LOCAL_API_ENABLED           // Comment out to disable the local REST and WebSocket control API
+#define LOCAL_API_WEBSOCKET_PORT 81 // Port of the WebSocket state stream, REST runs on the web portal
+
+// Group Control Configuration
+#define GROUP_CONTROL_ENABLED                   // Comment out to disable synchronized group commands over UDP multicast
+#define GROUP_CONTROL_ADDRESS "239.255.76.71"   // Multicast address of the group commands
+#define GROUP_CONTROL_PORT 4571                 // UDP port of the group commands
+#define GROUP_CONTROL_SENDER_SLOTS 8            // Senders whose sequence numbers are tracked for deduplication
+#define GROUP_CONTROL_SEQUENCE_TIMEOUT 10000    // Time after which any sequence of a sender is accepted again in milliseconds
+
 // WiFi Configuration
-#define WIFI_RECONNECT_ATTEMPT_INTERVAL 2000 // Interval between WiFi reconnection attempts in milliseconds
+#define WIFI_RECONNECT_INITIAL_DELAY 2000 // Delay before the second WiFi reconnection attempt in milliseconds, doubled after every failure
+#define WIFI_RECONNECT_MAX_DELAY 60000    // Maximum delay between WiFi reconnection attempts in milliseconds
+#define WIFI_FAST_CONNECT_TIMEOUT 5000    // Time to connect to the cached access point before falling back to a scan in milliseconds
+#define WIFI_FAST_CONNECT_MAX_FAILURES 3  // Failed fast connects in a row after which the cached access point is forgotten
 
 // MQTT Configuration
-#define MQTT_MIN_DELAY 50                    // Minimum delay between MQTT messages in milliseconds
+#define MQTT_PUBLISH_RATE 20                 // Sustained rate of outgoing MQTT messages per second
+#define MQTT_PUBLISH_BURST 8                 // Messages that can be sent at once after an idle period
 #define MQTT_PUBLISH_INTERVAL 5000           // Interval between MQTT publishes in milliseconds (-1 for no interval)
-#define MQTT_RECONNECT_ATTEMPT_INTERVAL 5000 // Interval between MQTT reconnection attempts in milliseconds
+#define MQTT_KEEPALIVE_INTERVAL 300000       // Interval after which unchanged payloads are published again in milliseconds
+#define MQTT_STATS_INTERVAL 60000            // Interval between publishes of the counters on the stats topic in milliseconds
+#define MQTT_RSSI_DEADBAND 4                 // RSSI change in dBm before the diagnostics are published again, smaller changes are noise
+#define MQTT_RECONNECT_INITIAL_DELAY 5000    // Delay before the first MQTT reconnection attempt in milliseconds, doubled after every failure
+#define MQTT_RECONNECT_MAX_DELAY 120000      // Maximum delay between MQTT reconnection attempts in milliseconds
+#define MQTT_ALL_TOPIC_ENABLED               // Comment out to ignore broadcast commands on <base>/all/set
+#define MQTT_MAX_GROUPS 4                    // Groups whose <base>/group/<name>/set topics can be subscribed
+#define MQTT_MAX_BROKERS 3                   // Primary broker plus backup brokers tried in order when it fails
+#define MQTT_PRIMARY_PROBE_INTERVAL 60000    // Interval in which a connection to a backup broker checks if the primary is back in milliseconds
+#define MQTT_PRIMARY_PROBE_TIMEOUT 500       // Timeout of the TCP probe of the primary broker in milliseconds
+#define MQTT_HA_REPUBLISH_SPREAD 5000        // Window over which the fleet republishes its state after Home Assistant came online in milliseconds
+#define MQTT_HA_RESEND_DELAY 5000            // Delay of the second state publish after Home Assistant came online in milliseconds
+#define MQTT_CONNECT_TIMEOUT 3000            // Timeout of the TCP connect and of waiting for CONNACK in milliseconds
+#define MQTT_SUBSCRIBE_QOS 1                 // QoS of the command subscriptions, 1 lets the broker queue commands while offline
+#define MQTT_CLEAN_SESSION false             // Keep the broker session between connections so queued commands are delivered
+#define MQTT_COMMAND_MAX_AGE 30000           // Commands the broker queued while the device was offline longer than this are dropped in milliseconds
+#define MQTT_REPLAY_WINDOW 2000              // Time after CONNACK in which commands without a start time count as queued by the broker in milliseconds
+#define MQTT_BUFFER_SIZE 512                 // MQTT client buffer for state payloads and incoming commands in bytes
+// #define MQTT_FLEET_TELEMETRY_ENABLED                     // Uncomment to publish compact telemetry for fleet tooling on <base>/<chipID>/fleet
+#define MQTT_FLEET_PAYLOAD_FORMAT PAYLOAD_FORMATS::MSGPACK // Payload format of the fleet telemetry
+#define MQTT_STREAM_CHUNK_SIZE 128           // Chunk size used when streaming large payloads like discovery in bytes
+// #define MQTT_TLS_ENABLED                  // Connect to the brokers over TLS, usually on port 8883, set by the -tls environments in platformio.ini
+#define MQTT_TLS_CA_MAX_SIZE 3072            // Maximum size of the PEM CA certificate stored in preferences in bytes
+#define MQTT_TLS_HANDSHAKE_TIMEOUT 5         // Timeout of the TLS handshake in seconds
 
 enum class LED_MODES
 {
@@ -20,6 +81,20 @@ enum class LED_MODES
     RGBWW   // RGBWW LED (LED1 = Red, LED2 = Green, LED3 = Blue, LED4 = Warm White, LED5 = Cold White)
 };
 
+enum class PAYLOAD_FORMATS
+{
+    JSON,   // Readable, required for Home Assistant topics
+    MSGPACK // Compact binary encoding of the same document
+};
+
+enum class POWER_ON_BEHAVIOR
+{
+    LAST,   // Restore the last state
+    ON,     // Restore the last brightness and color turned on
+    OFF,    // Restore the last brightness and color turned off
+    FADE_IN // Turn on and fade in from dark
+};
+
 enum class BUTTON_BEHAVIOR
 {
     TOGGLE, // Toggle the LED state
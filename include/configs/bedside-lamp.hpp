@@ -31,6 +31,11 @@
 
 // RF24 Configuration
 // #define RF24RADIO_ENABLED // Uncomment to enable RF24 radio
+// #define RF24RADIO_ACK_PAYLOAD_ENABLED // Uncomment to send the lamp state to remotes in ACK payloads
 // #define PIN_RADIO_CE -1   // Radio CE pin
 // #define PIN_RADIO_CSN -1  // Radio CSN pin
-// #define PIN_RADIO_IRQ -1  // Radio IRQ pin
\ No newline at end of file
+// #define PIN_RADIO_IRQ -1  // Radio IRQ pin
+
+// ESP-NOW Remote Configuration
+// #define ESPNOW_REMOTES_ENABLED          // Uncomment to receive remote frames over ESP-NOW
+// #define ESPNOW_REMOTES_FEEDBACK_ENABLED // Uncomment to reply to ESP-NOW remotes with the lamp state
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+#include "base.hpp"
+
+// Host configuration of the unit tests, selected by NATIVE_TEST in [env:native]
+// Mirrors the RF24 controller, the RF24 radio is replaced by the in memory loopback transport
+
+// Model Configuration
+#define MODELNAME "SMART-WIFI-RF24-Lamp" // Model name used as default device name
+
+// Output LED Configuration
+#define LED_MODE LED_MODES::CCT               // Set the LED mode
+#define DEFAULT_TRANSITION_TIME 250           // Default transition time in milliseconds
+#define LED_PWM_FREQUENCY 30000               // Frequency for LED PWM Control
+#define BRIGHTNESS_STEP_SIZE LED_MAX_VAL / 16 // Number of brightness steps
+#define COLOR_STEP_SIZE LED_MAX_VAL / 16      // Number of color steps
+#define LED_FADE_STEP_SIZE 20                 // LED fade step size
+#define MIN_BRIGHTNESS 5                      // Minimum brightness value
+#define MIN_MIREDS 153                        // Minimum color temperature in Mireds (6500K)
+#define MAX_MIREDS 370                        // Maximum color temperature in Mireds (2700K)
+#define LED1_PIN 3                            // Pin for LED1
+#define LED2_PIN 2                            // Pin for LED2 set to -1 if not used
+#define LED3_PIN -1                           // Pin for LED3 set to -1 if not used
+#define LED4_PIN -1                           // Pin for LED4 set to -1 if not used
+#define LED5_PIN -1                           // Pin for LED5 set to -1 if not used
+
+// Remote Configuration
+#define REMOTE_LOOPBACK_ENABLED // In memory transport the tests inject remote frames into
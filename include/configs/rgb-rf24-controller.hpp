@@ -33,6 +33,11 @@
 // RF24 Configuration
 #define RF24RADIO_ENABLED          // Uncomment to enable RF24 radio
 #define RF24RADIO_WATCHDOG_ENABLED // Uncomment to enable RF24 radio watchdog
+#define RF24RADIO_ACK_PAYLOAD_ENABLED // Uncomment to send the lamp state to remotes in ACK payloads
 #define PIN_RADIO_CE 7             // Radio CE pin
 #define PIN_RADIO_CSN 8            // Radio CSN pin
-#define PIN_RADIO_IRQ 9            // Radio IRQ pin
\ No newline at end of file
+#define PIN_RADIO_IRQ 9            // Radio IRQ pin
+
+// ESP-NOW Remote Configuration
+// #define ESPNOW_REMOTES_ENABLED          // Uncomment to receive remote frames over ESP-NOW
+// #define ESPNOW_REMOTES_FEEDBACK_ENABLED // Uncomment to reply to ESP-NOW remotes with the lamp state
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "eventBus.h"
+#include "Logging/logging.h"
+
+struct Subscriber
+{
+    uint32_t mask;
+    QueueHandle_t queue;
+};
+
+static Subscriber subscribers[EVENT_BUS_MAX_SUBSCRIBERS];
+static volatile size_t numSubscribers = 0;
+static volatile uint32_t droppedEvents = 0;
+static portMUX_TYPE subscriberMux = portMUX_INITIALIZER_UNLOCKED;
+
+// Create a bounded queue that receives all events matching the mask, subscribe before publishing tasks start
+QueueHandle_t eventBusSubscribe(uint32_t mask, size_t queueLength)
+{
+    if (numSubscribers >= EVENT_BUS_MAX_SUBSCRIBERS)
+    {
+        LOG_ERROR("Event bus subscriber limit reached\n");
+        return NULL;
+    }
+    QueueHandle_t queue = xQueueCreate(queueLength, sizeof(Event));
+    if (queue == NULL)
+    {
+        LOG_ERROR("Event bus queue could not be created\n");
+        return NULL;
+    }
+    portENTER_CRITICAL(&subscriberMux);
+    subscribers[numSubscribers] = {mask, queue};
+    numSubscribers = numSubscribers + 1; // Publish the entry only after it is complete
+    portEXIT_CRITICAL(&subscriberMux);
+    return queue;
+}
+
+// Deliver the event to all subscribers without blocking, events for full queues are dropped
+void eventBusPublish(const Event &event)
+{
+    size_t count = numSubscribers;
+    for (size_t i = 0; i < count; i++)
+    {
+        if ((subscribers[i].mask & EVENT_MASK(event.type)) == 0)
+        {
+            continue;
+        }
+        if (xQueueSend(subscribers[i].queue, &event, 0) != pdTRUE)
+        {
+            droppedEvents = droppedEvents + 1;
+        }
+    }
+}
+
+void eventBusPublish(EventTypes type)
+{
+    Event event = {};
+    event.type = type;
+    event.timestamp = micros();
+    eventBusPublish(event);
+}
+
+uint32_t eventBusGetDropped()
+{
+    return droppedEvents;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <Arduino.h>
+#include <cstdint>
+
+#define EVENT_BUS_MAX_SUBSCRIBERS 4 // Number of queues that can subscribe to the event bus
+
+enum class EventTypes : uint8_t
+{
+    LED_STATE_CHANGED, // LED settings were applied
+    REMOTE_SEEN,       // A remote was seen for the first time
+    REMOTE_EVENT,      // A remote sent an event, remote holds the sender and the event
+    REMOTE_EVICTED,    // A remote was removed to make room for a new one, remote holds its uuid
+    CONFIG_CHANGED,    // Settings that are reported to the network changed
+};
+
+#define EVENT_MASK(type) (1UL << (uint8_t)(type))
+
+struct Event
+{
+    EventTypes type;
+    uint32_t timestamp; // micros() when the event was published
+    struct
+    {
+        uint8_t uuid[4];
+        uint8_t event; // RemoteEvents value
+    } remote;
+};
+
+QueueHandle_t eventBusSubscribe(uint32_t mask, size_t queueLength);
+void eventBusPublish(const Event &event);
+void eventBusPublish(EventTypes type);
+uint32_t eventBusGetDropped();
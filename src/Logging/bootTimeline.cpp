@@ -0,0 +1,49 @@
+#include "bootTimeline.h"
+#include "logging.h"
+
+#include <Arduino.h>
+
+struct BootPhase
+{
+    const char *name;
+    uint32_t timeMs; // Milliseconds since reset
+};
+
+static BootPhase phases[BOOT_TIMELINE_MAX_PHASES];
+static uint8_t phaseCount = 0;
+static bool bootFinished = false;
+static portMUX_TYPE bootMux = portMUX_INITIALIZER_UNLOCKED;
+
+void bootTimelineMark(const char *phase)
+{
+    uint32_t now = esp_timer_get_time() / 1000; // Counts from reset, unlike millis() it includes the bootloader
+    portENTER_CRITICAL(&bootMux);
+    bool recorded = !bootFinished && phaseCount < BOOT_TIMELINE_MAX_PHASES;
+    uint32_t previous = phaseCount > 0 ? phases[phaseCount - 1].timeMs : 0;
+    if (recorded)
+    {
+        phases[phaseCount++] = {phase, now};
+    }
+    portEXIT_CRITICAL(&bootMux);
+    if (recorded)
+    {
+        LOG_INFO("Boot: %s after %lu ms (+%lu ms)\n", phase, (unsigned long)now, (unsigned long)(now - previous));
+    }
+}
+
+void bootTimelineEnd(const char *phase)
+{
+    if (bootFinished)
+    {
+        return;
+    }
+    bootTimelineMark(phase);
+    bootFinished = true;
+    LOG_INFO("---------------------BOOT-TIMELINE----------------\n");
+    for (uint8_t i = 0; i < phaseCount; i++)
+    {
+        uint32_t previous = i > 0 ? phases[i - 1].timeMs : 0;
+        LOG_INFO("%-20s %6lu ms %6lu ms\n", phases[i].name, (unsigned long)phases[i].timeMs, (unsigned long)(phases[i].timeMs - previous));
+    }
+    LOG_INFO("--------------------------------------------------\n");
+}
@@ -0,0 +1,9 @@
+#pragma once
+#define BOOT_TIMELINE_MAX_PHASES 12 // Number of boot phases that are recorded
+
+#include <cstdint>
+
+// Record the end of a boot phase, phases are logged with their time since reset and the time since the previous phase
+void bootTimelineMark(const char *phase);
+// Record the last phase and log the complete timeline, later marks are ignored
+void bootTimelineEnd(const char *phase);
@@ -0,0 +1,167 @@
+#include "asyncConnect.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <lwip/dns.h>
+#include <lwip/sockets.h>
+#include <lwip/tcpip.h>
+#include <cerrno>
+#include <cstring>
+
+// Called in the lwIP thread, also for lookups that were cancelled or replaced by another host in the meantime
+void AsyncResolver::dnsFound(const char *name, const ip_addr_t *ipaddr, void *arg)
+{
+    AsyncResolver *resolver = static_cast<AsyncResolver *>(arg);
+    if (!resolver->pending || strcmp(name, resolver->host) != 0)
+    {
+        return;
+    }
+    resolver->found = ipaddr != NULL;
+    if (ipaddr != NULL)
+    {
+        resolver->address = ip_2_ip4(ipaddr)->addr;
+    }
+    resolver->pending = false;
+}
+
+AsyncResults AsyncResolver::poll(const char *name, IPAddress &ip, uint32_t timeout)
+{
+    if (ip.fromString(name))
+    {
+        return AsyncResults::DONE;
+    }
+    if (strcmp(name, host) != 0 || (!pending && startTime == 0))
+    {
+        snprintf(host, sizeof(host), "%s", name);
+        ip_addr_t addr;
+        found = false;
+        pending = true;
+        startTime = max(millis(), 1UL);
+        LOCK_TCPIP_CORE();
+#if LWIP_IPV4 && LWIP_IPV6
+        err_t error = dns_gethostbyname_addrtype(host, &addr, dnsFound, this, LWIP_DNS_ADDRTYPE_IPV4);
+#else
+        err_t error = dns_gethostbyname(host, &addr, dnsFound, this);
+#endif
+        UNLOCK_TCPIP_CORE();
+        if (error == ERR_OK) // Cached or literal
+        {
+            address = ip_2_ip4(&addr)->addr;
+            found = true;
+            pending = false;
+        }
+        else if (error != ERR_INPROGRESS)
+        {
+            pending = false;
+        }
+    }
+    if (pending)
+    {
+        if (millis() - startTime < timeout)
+        {
+            return AsyncResults::PENDING;
+        }
+        LOG_WARNING("DNS lookup of %s timed out\n", host);
+        cancel();
+        return AsyncResults::FAILED;
+    }
+    startTime = 0; // The next poll starts a new lookup
+    if (!found)
+    {
+        return AsyncResults::FAILED;
+    }
+    ip = IPAddress(address);
+    return AsyncResults::DONE;
+}
+
+void AsyncResolver::cancel()
+{
+    pending = false; // A late answer is ignored
+    startTime = 0;
+    host[0] = '\0';
+}
+
+bool AsyncConnect::start(uint32_t address, uint16_t port)
+{
+    fd = lwip_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (fd < 0)
+    {
+        LOG_ERROR("Failed to create a socket: %i\n", errno);
+        return false;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = address;
+    if (lwip_connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS)
+    {
+        cancel();
+        return false;
+    }
+    ip = address;
+    this->port = port;
+    startTime = millis();
+    return true;
+}
+
+AsyncResults AsyncConnect::poll(IPAddress address, uint16_t port, uint32_t timeout, WiFiClient *client)
+{
+    if (fd >= 0 && (ip != (uint32_t)address || this->port != port))
+    {
+        cancel(); // A connect to another address was abandoned
+    }
+    if (fd < 0 && !start((uint32_t)address, port))
+    {
+        return AsyncResults::FAILED;
+    }
+
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(fd, &writable);
+    struct timeval noWait = {0, 0};
+    int ready = select(fd + 1, NULL, &writable, NULL, &noWait);
+    if (ready == 0)
+    {
+        if (millis() - startTime < timeout)
+        {
+            return AsyncResults::PENDING;
+        }
+        cancel();
+        return AsyncResults::FAILED;
+    }
+    int error = 0;
+    socklen_t length = sizeof(error);
+    if (ready < 0 || lwip_getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0 || error != 0)
+    {
+        cancel();
+        return AsyncResults::FAILED;
+    }
+    if (client == NULL)
+    {
+        cancel(); // Only checked if the server accepts connections
+        return AsyncResults::DONE;
+    }
+
+    // Same socket options as WiFiClient::connect, blocking again with timeouts for the MQTT client
+    struct timeval socketTimeout = {(time_t)(timeout / 1000), (suseconds_t)((timeout % 1000) * 1000)};
+    int enable = 1;
+    lwip_setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &socketTimeout, sizeof(socketTimeout));
+    lwip_setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &socketTimeout, sizeof(socketTimeout));
+    lwip_setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    lwip_setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &enable, sizeof(enable));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) & ~O_NONBLOCK);
+    *client = WiFiClient(fd); // The client owns the socket from now on
+    fd = -1;
+    return AsyncResults::DONE;
+}
+
+void AsyncConnect::cancel()
+{
+    if (fd >= 0)
+    {
+        lwip_close(fd);
+        fd = -1;
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "config.h"
+
+#include <WiFi.h>
+#include <lwip/ip_addr.h>
+#include <cstdint>
+
+// Host name lookups and TCP connects that are polled instead of waited for, so the network task keeps
+// serving the web portal, OTA and the active connection while a connection attempt is in progress
+
+enum class AsyncResults
+{
+    PENDING,
+    DONE,
+    FAILED,
+};
+
+// Resolves a host name with the lwIP DNS client, literal addresses and cached names resolve on the first poll
+class AsyncResolver
+{
+    char host[64] = "";
+    volatile bool pending = false;
+    volatile bool found = false;
+    volatile uint32_t address = 0; // Written by the lwIP thread before pending is cleared
+    unsigned long startTime = 0;
+
+    static void dnsFound(const char *name, const ip_addr_t *ipaddr, void *arg);
+
+public:
+    // Starts the lookup of host unless it is already running, returns DONE with ip set once resolved
+    AsyncResults poll(const char *name, IPAddress &ip, uint32_t timeout);
+    void cancel();
+};
+
+// Opens a TCP connection with a non-blocking socket that is handed to a WiFiClient once it is connected
+class AsyncConnect
+{
+    int fd = -1;
+    uint32_t ip = 0;
+    uint16_t port = 0;
+    unsigned long startTime = 0;
+
+    bool start(uint32_t address, uint16_t port);
+
+public:
+    // Starts the connect unless it is already running, client receives the connected socket, without a client it is closed
+    AsyncResults poll(IPAddress address, uint16_t port, uint32_t timeout, WiFiClient *client);
+    void cancel();
+};
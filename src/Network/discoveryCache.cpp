@@ -0,0 +1,58 @@
+#include "discoveryCache.h"
+#include "fingerprint.h"
+
+#include <Preferences.h>
+#include <cstdio>
+#include <cstring>
+
+static Preferences preferences;
+
+// Preference key of a retained topic on a broker
+static void getDiscoveryKey(const char *topic, const char *server, char *key, size_t len)
+{
+    uint32_t hash = fingerprint(topic, strlen(topic), fingerprint(server, strlen(server)));
+    snprintf(key, len, "%08lX", (unsigned long)hash);
+}
+
+bool discoveryCacheChanged(const char *topic, const char *server, uint32_t payloadFingerprint)
+{
+    char key[9];
+    getDiscoveryKey(topic, server, key, sizeof(key));
+    preferences.begin("ha_discovery", true);
+    uint32_t stored = preferences.getUInt(key, 0);
+    preferences.end();
+    return stored != payloadFingerprint;
+}
+
+void discoveryCacheStore(const char *topic, const char *server, uint32_t payloadFingerprint)
+{
+    if (!discoveryCacheChanged(topic, server, payloadFingerprint))
+    {
+        return; // Avoid rewriting the same value to flash
+    }
+    char key[9];
+    getDiscoveryKey(topic, server, key, sizeof(key));
+    preferences.begin("ha_discovery", false);
+    preferences.putUInt(key, payloadFingerprint);
+    preferences.end();
+}
+
+void discoveryCacheRemove(const char *topic, const char *server)
+{
+    char key[9];
+    getDiscoveryKey(topic, server, key, sizeof(key));
+    preferences.begin("ha_discovery", false);
+    if (preferences.isKey(key))
+    {
+        preferences.remove(key);
+    }
+    preferences.end();
+}
+
+// Keys of brokers that are no longer configured would never be used again
+void discoveryCacheClear()
+{
+    preferences.begin("ha_discovery", false);
+    preferences.clear();
+    preferences.end();
+}
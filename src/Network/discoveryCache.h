@@ -0,0 +1,16 @@
+#pragma once
+#include "config.h"
+
+#include <cstdint>
+
+// Fingerprints of the retained discovery documents on each broker, kept in NVS so documents that
+// did not change are not published again after a reconnect or reboot
+
+// Returns true if the payload differs from the one last published on the topic to the server
+bool discoveryCacheChanged(const char *topic, const char *server, uint32_t payloadFingerprint);
+// Remember the payload published on the topic to the server
+void discoveryCacheStore(const char *topic, const char *server, uint32_t payloadFingerprint);
+// Forget the topic on the server, its entity is gone and is published again if it returns
+void discoveryCacheRemove(const char *topic, const char *server);
+// Forget all topics on all servers
+void discoveryCacheClear();
@@ -0,0 +1,192 @@
+#include "fastConnect.h"
+#include "fingerprint.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+#include <cstdio>
+#include <cstring>
+
+#define ACCESS_POINT_CACHE_MAGIC 0x41504331 // "APC1"
+
+// Access point of the last successful connection
+struct AccessPointCache
+{
+    uint32_t magic;
+    uint8_t bssid[6];
+    uint8_t channel;
+    uint8_t failures; // Fast connects that timed out since the last successful connection
+    uint32_t checksum;
+};
+
+// Survives software resets, power cycles fall back to the copy in NVS
+static RTC_NOINIT_ATTR AccessPointCache rtcCache;
+static AccessPointCache cache;
+static bool cacheValid = false;
+static StaticIpSettings staticIpSettings;
+static Preferences preferences;
+
+static uint32_t getChecksum(const AccessPointCache &c)
+{
+    return fingerprint(&c, offsetof(AccessPointCache, checksum));
+}
+
+static bool isValid(const AccessPointCache &c)
+{
+    return c.magic == ACCESS_POINT_CACHE_MAGIC && c.channel > 0 && c.checksum == getChecksum(c);
+}
+
+static void loadStaticIpSettings()
+{
+    preferences.begin("wifi_config", true);
+    preferences.getString("staticIp", staticIpSettings.ip, sizeof(staticIpSettings.ip));
+    preferences.getString("gateway", staticIpSettings.gateway, sizeof(staticIpSettings.gateway));
+    preferences.getString("subnet", staticIpSettings.subnet, sizeof(staticIpSettings.subnet));
+    preferences.getString("dns", staticIpSettings.dns, sizeof(staticIpSettings.dns));
+    preferences.end();
+}
+
+// Apply the static IP before the connection is started so DHCP is skipped
+static void applyStaticIp()
+{
+    if (staticIpSettings.ip[0] == '\0')
+    {
+        return;
+    }
+    IPAddress ip, gateway, subnet, dns;
+    if (!ip.fromString(staticIpSettings.ip) || !gateway.fromString(staticIpSettings.gateway) || !subnet.fromString(staticIpSettings.subnet))
+    {
+        LOG_WARNING("Invalid static IP settings, using DHCP\n");
+        return;
+    }
+    if (!dns.fromString(staticIpSettings.dns))
+    {
+        dns = gateway;
+    }
+    if (!WiFi.config(ip, gateway, subnet, dns))
+    {
+        LOG_WARNING("Failed to set static IP %s\n", staticIpSettings.ip);
+        return;
+    }
+    LOG_INFO("Using static IP %s\n", staticIpSettings.ip);
+}
+
+void fastConnectInit()
+{
+    loadStaticIpSettings();
+    applyStaticIp();
+
+    if (isValid(rtcCache))
+    {
+        cache = rtcCache;
+    }
+    else
+    {
+        preferences.begin("wifi_config", true);
+        bool loaded = preferences.getBytes("apCache", &cache, sizeof(cache)) == sizeof(cache);
+        preferences.end();
+        if (!loaded || !isValid(cache))
+        {
+            return;
+        }
+        rtcCache = cache;
+    }
+    cacheValid = true;
+}
+
+// Connect to the cached access point without a scan, returns false if there is no cached access point
+bool fastConnectBegin(const char *ssid, const char *password)
+{
+    if (!cacheValid || ssid == NULL || ssid[0] == '\0')
+    {
+        return false;
+    }
+    LOG_INFO("Connecting to %s on channel %i via %02X:%02X:%02X:%02X:%02X:%02X\n", ssid, cache.channel,
+             cache.bssid[0], cache.bssid[1], cache.bssid[2], cache.bssid[3], cache.bssid[4], cache.bssid[5]);
+    WiFi.persistent(false); // Do not store the BSSID lock, a normal connect must still scan for the best access point
+    WiFi.begin(ssid, password, cache.channel, cache.bssid, true);
+    WiFi.persistent(true);
+    return true;
+}
+
+// Remember the access point of the current connection, NVS is only written if it changed
+void fastConnectSave()
+{
+    uint8_t *bssid = WiFi.BSSID();
+    int32_t channel = WiFi.channel();
+    if (bssid == NULL || channel <= 0)
+    {
+        return;
+    }
+    if (cacheValid && memcmp(cache.bssid, bssid, sizeof(cache.bssid)) == 0 && cache.channel == channel)
+    {
+        if (cache.failures > 0)
+        {
+            cache.failures = 0; // The access point is unchanged, the failed attempts were transient
+            cache.checksum = getChecksum(cache);
+            rtcCache = cache;
+        }
+        return;
+    }
+    memset(&cache, 0, sizeof(cache)); // The checksum also covers the padding
+    cache.magic = ACCESS_POINT_CACHE_MAGIC;
+    memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+    cache.channel = channel;
+    cache.checksum = getChecksum(cache);
+    rtcCache = cache;
+    cacheValid = true;
+
+    preferences.begin("wifi_config", false);
+    preferences.putBytes("apCache", &cache, sizeof(cache));
+    preferences.end();
+    LOG_INFO("Cached access point on channel %i\n", cache.channel);
+}
+
+static void invalidateCache()
+{
+    cacheValid = false;
+    rtcCache.magic = 0;
+    preferences.begin("wifi_config", false);
+    preferences.remove("apCache");
+    preferences.end();
+}
+
+// Count a fast connect that timed out, the cached access point is only forgotten after repeated failures
+// The count is kept in RTC memory only, after a power cycle the access point gets another chance
+void fastConnectFailed()
+{
+    if (!cacheValid)
+    {
+        return;
+    }
+    cache.failures++;
+    if (cache.failures >= WIFI_FAST_CONNECT_MAX_FAILURES)
+    {
+        LOG_WARNING("Fast connect failed %i times, forgetting the cached access point\n", cache.failures);
+        invalidateCache();
+        return;
+    }
+    cache.checksum = getChecksum(cache);
+    rtcCache = cache;
+}
+
+const StaticIpSettings &getStaticIpSettings()
+{
+    return staticIpSettings;
+}
+
+void setStaticIpSettings(const char *ip, const char *gateway, const char *subnet, const char *dns)
+{
+    snprintf(staticIpSettings.ip, sizeof(staticIpSettings.ip), "%s", ip);
+    snprintf(staticIpSettings.gateway, sizeof(staticIpSettings.gateway), "%s", gateway);
+    snprintf(staticIpSettings.subnet, sizeof(staticIpSettings.subnet), "%s", subnet);
+    snprintf(staticIpSettings.dns, sizeof(staticIpSettings.dns), "%s", dns);
+
+    preferences.begin("wifi_config", false);
+    preferences.putString("staticIp", staticIpSettings.ip);
+    preferences.putString("gateway", staticIpSettings.gateway);
+    preferences.putString("subnet", staticIpSettings.subnet);
+    preferences.putString("dns", staticIpSettings.dns);
+    preferences.end();
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "config.h"
+
+#include <cstdint>
+
+#define STATIC_IP_SIZE sizeof("255.255.255.255")
+
+// Static IP configuration, DHCP is used if ip is empty
+struct StaticIpSettings
+{
+    char ip[STATIC_IP_SIZE] = "";
+    char gateway[STATIC_IP_SIZE] = "";
+    char subnet[STATIC_IP_SIZE] = "";
+    char dns[STATIC_IP_SIZE] = "";
+};
+
+void fastConnectInit();
+bool fastConnectBegin(const char *ssid, const char *password);
+void fastConnectSave();
+void fastConnectFailed();
+const StaticIpSettings &getStaticIpSettings();
+void setStaticIpSettings(const char *ip, const char *gateway, const char *subnet, const char *dns);
@@ -0,0 +1,12 @@
+#include "fingerprint.h"
+
+uint32_t fingerprint(const void *data, size_t len, uint32_t hash)
+{
+    const uint8_t *bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u; // FNV-1a prime
+    }
+    return hash;
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#define FINGERPRINT_INIT 2166136261u // FNV-1a offset basis
+
+// FNV-1a fingerprint of a payload, pass the previous fingerprint to continue over multiple parts
+uint32_t fingerprint(const void *data, size_t len, uint32_t hash = FINGERPRINT_INIT);
@@ -0,0 +1,170 @@
+#include "config.h"
+#ifdef GROUP_CONTROL_ENABLED
+
+#include "groupControl.h"
+#include "timeSync.h"
+#include "Output/ledControl.h"
+#include "Logging/logging.h"
+
+#include <Preferences.h>
+#include <WiFi.h>
+#include <WiFiUdp.h>
+
+static_assert(sizeof(GroupPacket) == 40, "GroupPacket layout changed");
+
+struct SenderSequence
+{
+    uint32_t sender = 0;
+    uint32_t sequence = 0;
+    uint32_t lastSeen = 0;
+    bool used = false;
+};
+
+static WiFiUDP udp;
+static Preferences preferences;
+static bool udpStarted = false;
+static uint16_t groupId = GROUP_ID_NONE;
+static SenderSequence senders[GROUP_CONTROL_SENDER_SLOTS];
+static GroupControlStats stats;
+
+void groupControlInit()
+{
+    preferences.begin("group_config", false);
+    groupId = preferences.getUShort("groupId", GROUP_ID_NONE);
+    preferences.end();
+    LOG_INFO("Loaded group settings: Group: %i\n", groupId);
+}
+
+uint16_t getGroupId()
+{
+    return groupId;
+}
+
+void setGroupId(uint16_t group)
+{
+    groupId = group;
+    preferences.begin("group_config", false);
+    preferences.putUShort("groupId", groupId);
+    preferences.end();
+    LOG_INFO("Group set to %i\n", groupId);
+}
+
+GroupControlStats getGroupControlStats()
+{
+    return stats;
+}
+
+void groupControlBegin()
+{
+    if (udpStarted)
+    {
+        return;
+    }
+    IPAddress address;
+    address.fromString(GROUP_CONTROL_ADDRESS);
+    if (!udp.beginMulticast(address, GROUP_CONTROL_PORT))
+    {
+        LOG_ERROR("Failed to join multicast group %s:%i\n", GROUP_CONTROL_ADDRESS, GROUP_CONTROL_PORT);
+        return;
+    }
+    udpStarted = true;
+    LOG_INFO("Listening for group commands on %s:%i\n", GROUP_CONTROL_ADDRESS, GROUP_CONTROL_PORT);
+}
+
+// Returns true if the sequence is newer than the last one seen from the sender
+static bool acceptSequence(uint32_t sender, uint32_t sequence)
+{
+    SenderSequence *slot = nullptr;
+    SenderSequence *oldest = &senders[0];
+    for (auto &s : senders)
+    {
+        if (s.used && s.sender == sender)
+        {
+            slot = &s;
+            break;
+        }
+        if (!s.used || (oldest->used && s.lastSeen < oldest->lastSeen))
+        {
+            oldest = &s;
+        }
+    }
+
+    uint32_t now = millis();
+    if (slot == nullptr)
+    {
+        // Unknown sender, replace the least recently seen one
+        slot = oldest;
+        slot->used = true;
+        slot->sender = sender;
+    }
+    else if ((int32_t)(sequence - slot->sequence) <= 0 && now - slot->lastSeen < GROUP_CONTROL_SEQUENCE_TIMEOUT)
+    {
+        return false; // Repeated or reordered packet, a restarted sender is accepted again after the timeout
+    }
+    slot->sequence = sequence;
+    slot->lastSeen = now;
+    return true;
+}
+
+static void handlePacket(const GroupPacket &packet)
+{
+    if (packet.magic != GROUP_PACKET_MAGIC || packet.version != GROUP_PACKET_VERSION)
+    {
+        stats.invalid++;
+        return;
+    }
+    if (packet.group != GROUP_ID_ALL && (groupId == GROUP_ID_NONE || packet.group != groupId))
+    {
+        return; // Not addressed to this lamp
+    }
+    if (!acceptSequence(packet.sender, packet.sequence))
+    {
+        stats.duplicates++;
+        return;
+    }
+    stats.received++;
+
+    LightCommand command;
+    command.transitionTimeMs = packet.transitionTimeMs;
+    command.hasPower = packet.flags & GROUP_FLAG_POWER;
+    command.power = packet.flags & GROUP_FLAG_POWER_ON;
+    command.hasBrightness = packet.flags & GROUP_FLAG_BRIGHTNESS;
+    command.brightness = packet.brightness;
+    command.hasColorTemperature = LED_MODE == LED_MODES::CCT && (packet.flags & GROUP_FLAG_COLOR_TEMPERATURE);
+    command.mireds = packet.mireds;
+    command.hasRgb = (LED_MODE == LED_MODES::RGB || LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW) && (packet.flags & GROUP_FLAG_RGB);
+    command.red = packet.red;
+    command.green = packet.green;
+    command.blue = packet.blue;
+    command.hasWW = (LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW) && (packet.flags & GROUP_FLAG_WW);
+    command.ww = packet.ww;
+    command.hasCW = LED_MODE == LED_MODES::RGBWW && (packet.flags & GROUP_FLAG_CW);
+    command.cw = packet.cw;
+    if (packet.startAt != 0)
+    {
+        command.hasStartTime = epochToLocalMillis(packet.startAt, command.startTime);
+    }
+    queueLightCommand(command);
+    LOG_DEBUG("Group %i command %lu from %08lX\n", packet.group, (unsigned long)packet.sequence, (unsigned long)packet.sender);
+}
+
+void groupControlLoop()
+{
+    if (!udpStarted)
+    {
+        return;
+    }
+    int size;
+    while ((size = udp.parsePacket()) > 0)
+    {
+        GroupPacket packet;
+        if (size != sizeof(packet) || udp.read((uint8_t *)&packet, sizeof(packet)) != sizeof(packet))
+        {
+            stats.invalid++;
+            continue; // parsePacket discards the rest of the packet
+        }
+        handlePacket(packet);
+    }
+}
+
+#endif
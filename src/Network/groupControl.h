@@ -0,0 +1,58 @@
+#pragma once
+#include "config.h"
+#ifdef GROUP_CONTROL_ENABLED
+
+#include <cstdint>
+#include <cstddef>
+
+#define GROUP_ID_NONE 0     // Lamp is not a member of any group
+#define GROUP_ID_ALL 0xFFFF // Packets for this group are applied by every lamp
+
+#define GROUP_PACKET_MAGIC 0x474C // "LG" in little endian
+#define GROUP_PACKET_VERSION 2
+
+// Flags of the fields carried in a group packet
+#define GROUP_FLAG_POWER 0x01
+#define GROUP_FLAG_BRIGHTNESS 0x02
+#define GROUP_FLAG_COLOR_TEMPERATURE 0x04
+#define GROUP_FLAG_RGB 0x08
+#define GROUP_FLAG_WW 0x10
+#define GROUP_FLAG_CW 0x20
+#define GROUP_FLAG_POWER_ON 0x80 // Power state when GROUP_FLAG_POWER is set
+
+// Multicast packet with a full light state, all fields little endian.
+// Senders should send every packet several times with the same sequence number, duplicates are dropped by the lamps.
+struct __attribute__((packed)) GroupPacket
+{
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t group;
+    uint32_t sender;   // Unique id of the sender, sequence numbers are tracked per sender
+    uint32_t sequence; // Incremented for every new command of a sender
+    uint32_t transitionTimeMs;
+    uint16_t brightness;
+    uint16_t mireds;
+    uint16_t red;
+    uint16_t green;
+    uint16_t blue;
+    uint16_t ww;
+    uint16_t cw;
+    uint64_t startAt; // Unix time in milliseconds at which the transition starts, 0 to start on reception
+};
+
+struct GroupControlStats
+{
+    uint32_t received = 0;   // Valid packets addressed to this lamp
+    uint32_t duplicates = 0; // Packets dropped because their sequence was already seen
+    uint32_t invalid = 0;    // Packets with a wrong size, magic or version
+};
+
+void groupControlInit();
+void groupControlBegin();
+void groupControlLoop();
+uint16_t getGroupId();
+void setGroupId(uint16_t group);
+GroupControlStats getGroupControlStats();
+
+#endif
@@ -1,212 +1,290 @@
 #include "config.h"
 #include "haDiscovery.h"
+#include "mqttTopics.h"
+#include "fingerprint.h"
 #include "Logging/logging.h"
 #include "ChipID/chipID.h"
 
-#include <ArduinoJson.h>
-#include <sstream>
+#include <cstdio>
+#include <cstring>
 
-static const char* REMOTE_NAME = "RF24-Remote";
+#define HA_STR_(x) #x
+#define HA_STR(x) HA_STR_(x)
 
-std::string_view BaseHaDiscovery::getTopic()
-{
-    return topic;
-}
+static const char *REMOTE_NAME = "RF24-Remote";
 
-std::string_view BaseHaDiscovery::getPayloadString()
-{
-    return payloadStr;
-}
-
-// Constructor
-HaDiscovery::HaDiscovery(std::string_view baseTopic)
+// Supported color modes and color temperature range of the light, selected at compile time
+static constexpr const char *getColorModesFragment(LED_MODES mode)
 {
-    // Create the topic
-    std::ostringstream topicStream;
-    topicStream << "homeassistant/device/" << ChipID::getChipID() << "/config";
-    topic = topicStream.str();
-
-    // Create the payload
-    JsonDocument doc;
-
-    // Device Sub-Object
-    JsonObject device = doc["dev"].to<JsonObject>();
-    device["ids"] = ChipID::getChipID();
-    device["name"] = getDeviceName();
-    device["mf"] = "MarcusVoss";
-    device["mdl"] = MODELNAME;
-    device["sw"] = SW_VERSION;
-    device["sn"] = ChipID::getChipID();
-
-    // Orogin Sub-Object
-    JsonObject origin = doc["o"].to<JsonObject>();
-    origin["name"] = "MarcusVoss";
-
-    // Components
-    JsonObject components = doc["cmps"].to<JsonObject>();
-
-    // Light Sub-Object
-    JsonObject light = components["light"].to<JsonObject>();
-    light["p"] = "light";
-    light["name"] = "Light";
-    light["schema"] = "json";
-    light["device_class"] = "light";
-    light["brightness_scale"] = LED_MAX_VAL;
-    std::ostringstream commandTopicStream;
-    commandTopicStream << baseTopic << "/" << ChipID::getChipID() << "/set";
-    light["command_topic"] = commandTopicStream.str();
-    std::ostringstream availabilityTopicStream;
-    availabilityTopicStream << baseTopic << "/" << ChipID::getChipID() << "/status";
-    light["availability_topic"] = availabilityTopicStream.str();
-    JsonArray colorModes = light["supported_color_modes"].to<JsonArray>();
-    switch (LED_MODE)
+    switch (mode)
     {
     case LED_MODES::SINGLE:
-        colorModes.add("brightness");
-        break;
+        return "[\"brightness\"]";
     case LED_MODES::CCT:
-        colorModes.add("color_temp");
-        light["max_mireds"] = MAX_MIREDS;
-        light["min_mireds"] = MIN_MIREDS;
-        break;
+        return "[\"color_temp\"],\"max_mireds\":" HA_STR(MAX_MIREDS) ",\"min_mireds\":" HA_STR(MIN_MIREDS);
     case LED_MODES::RGB:
-        colorModes.add("rgb");
-        break;
+        return "[\"rgb\"]";
     case LED_MODES::RGBW:
-        colorModes.add("rgbw");
-        break;
+        return "[\"rgbw\"]";
     case LED_MODES::RGBWW:
-        colorModes.add("rgbww");
-        break;
+        return "[\"rgbww\"]";
     }
-    std::ostringstream stateTopicStream;
-    stateTopicStream << baseTopic << "/" << ChipID::getChipID() << "/light";
-    light["state_topic"] = stateTopicStream.str();
-    std::ostringstream uniqueIDStream;
-    uniqueIDStream << ChipID::getChipID() << "_light";
-    light["unique_id"] = uniqueIDStream.str();
-
-    // Diagnostic IP Address
-    JsonObject diagnosticIP = components["diagIP"].to<JsonObject>();
-    diagnosticIP["p"] = "sensor";
-    diagnosticIP["name"] = "IP Address";
-    diagnosticIP["entity_category"] = "diagnostic";
-    std::ostringstream uniqueIDIPStream;
-    uniqueIDIPStream << ChipID::getChipID() << "_ip";
-    diagnosticIP["unique_id"] = uniqueIDIPStream.str();
-    std::ostringstream stateTopicIPStream;
-    stateTopicIPStream << baseTopic << "/" << ChipID::getChipID() << "/diagnostic";
-    diagnosticIP["state_topic"] = stateTopicIPStream.str();
-    diagnosticIP["value_template"] = "{{ value_json.ip }}";
-
-    // Diagnostics RSSI
-    JsonObject diagnosticRSSI = components["diagRSSI"].to<JsonObject>();
-    diagnosticRSSI["p"] = "sensor";
-    diagnosticRSSI["name"] = "RSSI";
-    diagnosticRSSI["device_class"] = "signal_strength";
-    diagnosticRSSI["entity_category"] = "diagnostic";
-    std::ostringstream uniqueIDRSSIStream;
-    uniqueIDRSSIStream << ChipID::getChipID() << "_rssi";
-    diagnosticRSSI["unique_id"] = uniqueIDRSSIStream.str();
-    std::ostringstream stateTopicRSSIStream;
-    stateTopicRSSIStream << baseTopic << "/" << ChipID::getChipID() << "/diagnostic";
-    diagnosticRSSI["state_topic"] = stateTopicRSSIStream.str();
-    diagnosticRSSI["unit_of_measurement"] = "dBm";
-    diagnosticRSSI["value_template"] = "{{ value_json.rssi }}";
+    return "[]";
+}
+
+static constexpr const char *COLOR_MODES_FRAGMENT = getColorModesFragment(LED_MODE);
+
+// Every ${ of a template must be closed by a } before the next ${, checked at compile time
+static constexpr bool hasClosedPlaceholders(const char *payloadTemplate)
+{
+    bool open = false;
+    for (const char *c = payloadTemplate; *c != '\0'; c++)
+    {
+        if (c[0] == '$' && c[1] == '{')
+        {
+            if (open)
+            {
+                return false;
+            }
+            open = true;
+        }
+        else if (*c == '}')
+        {
+            open = false;
+        }
+    }
+    return !open;
+}
 
+// Device discovery payload, ${...} is replaced with JSON escaped runtime values
+static constexpr char DEVICE_TEMPLATE[] =
+    "{\"dev\":{\"ids\":\"${id}\",\"name\":\"${name}\",\"mf\":\"MarcusVoss\",\"mdl\":\"" MODELNAME "\",\"sw\":\"" SW_VERSION "\",\"sn\":\"${id}\"},"
+    "\"o\":{\"name\":\"MarcusVoss\"},"
+    "\"cmps\":{"
+    "\"light\":{\"p\":\"light\",\"name\":\"Light\",\"schema\":\"json\",\"device_class\":\"light\",\"brightness_scale\":" HA_STR(LED_MAX_VAL) ","
+    "\"command_topic\":\"${set}\",\"availability_topic\":\"${status}\",\"supported_color_modes\":${modes},"
+    "\"state_topic\":\"${light}\",\"unique_id\":\"${id}_light\"},"
+    "\"diagIP\":{\"p\":\"sensor\",\"name\":\"IP Address\",\"entity_category\":\"diagnostic\",\"unique_id\":\"${id}_ip\","
+    "\"state_topic\":\"${diagnostic}\",\"value_template\":\"{{ value_json.ip }}\"},"
+    "\"diagRSSI\":{\"p\":\"sensor\",\"name\":\"RSSI\",\"device_class\":\"signal_strength\",\"entity_category\":\"diagnostic\",\"unique_id\":\"${id}_rssi\","
+    "\"state_topic\":\"${diagnostic}\",\"unit_of_measurement\":\"dBm\",\"value_template\":\"{{ value_json.rssi }}\"}"
+    ",\"publishLatency\":{\"p\":\"sensor\",\"name\":\"Publish Latency\",\"device_class\":\"duration\",\"entity_category\":\"diagnostic\",\"unique_id\":\"${id}_publishLatency\","
+    "\"state_topic\":\"${diagnostic}\",\"unit_of_measurement\":\"ms\",\"value_template\":\"{{ value_json.publishLatency }}\","
+    "\"json_attributes_topic\":\"${stats}\"}"
 #ifdef RF24RADIO_ENABLED
-    JsonObject radioChannel = components["radioChannel"].to<JsonObject>();
-    radioChannel["p"] = "sensor";
-    radioChannel["name"] = "Radio Channel";
-    radioChannel["entity_category"] = "diagnostic";
-    std::ostringstream uniqueIDRadioChannelStream;
-    uniqueIDRadioChannelStream << ChipID::getChipID() << "_radioChannel";
-    radioChannel["unique_id"] = uniqueIDRadioChannelStream.str();
-    std::ostringstream stateTopicRadioChannelStream;
-    stateTopicRadioChannelStream << baseTopic << "/" << ChipID::getChipID() << "/diagnostic";
-    radioChannel["state_topic"] = stateTopicRadioChannelStream.str();
-    radioChannel["value_template"] = "{{ value_json.radioChannel }}";
-
-    JsonObject radioAddress = components["radioAddress"].to<JsonObject>();
-    radioAddress["p"] = "sensor";
-    radioAddress["name"] = "Radio Address";
-    radioAddress["entity_category"] = "diagnostic";
-    std::ostringstream uniqueIDRadioAddressStream;
-    uniqueIDRadioAddressStream << ChipID::getChipID() << "_radioAddress";
-    radioAddress["unique_id"] = uniqueIDRadioAddressStream.str();
-    std::ostringstream stateTopicRadioAddressStream;
-    stateTopicRadioAddressStream << baseTopic << "/" << ChipID::getChipID() << "/diagnostic";
-    radioAddress["state_topic"] = stateTopicRadioAddressStream.str();
-    radioAddress["value_template"] = "{{ value_json.radioAddress }}";
+    ",\"radioChannel\":{\"p\":\"sensor\",\"name\":\"Radio Channel\",\"entity_category\":\"diagnostic\",\"unique_id\":\"${id}_radioChannel\","
+    "\"state_topic\":\"${diagnostic}\",\"value_template\":\"{{ value_json.radioChannel }}\"},"
+    "\"radioAddress\":{\"p\":\"sensor\",\"name\":\"Radio Address\",\"entity_category\":\"diagnostic\",\"unique_id\":\"${id}_radioAddress\","
+    "\"state_topic\":\"${diagnostic}\",\"value_template\":\"{{ value_json.radioAddress }}\"}"
 #endif
+    "}}";
+static_assert(hasClosedPlaceholders(DEVICE_TEMPLATE), "Unclosed placeholder in the device discovery template");
+
+#ifdef REMOTES_ENABLED
+// Remote discovery payload, ${...} is replaced with JSON escaped runtime values
+static constexpr char REMOTE_TEMPLATE[] =
+    "{\"dev\":{\"ids\":\"${remote}\",\"name\":\"${remote}\",\"mf\":\"MarcusVoss\",\"mdl\":\"${model}\",\"state_topic\":\"${state}\",\"schema\":\"json\"},"
+    "\"o\":{\"name\":\"MarcusVoss\"},"
+    "\"cmps\":{"
+    "\"battery\":{\"p\":\"sensor\",\"name\":\"Battery\",\"device_class\":\"battery\",\"unit_of_measurement\":\"%\","
+    "\"unique_id\":\"${remote}_battery\",\"value_template\":\"{{ value_json.battery }}\"},"
+    "\"batteryVoltage\":{\"p\":\"sensor\",\"name\":\"Battery Voltage\",\"device_class\":\"voltage\",\"unit_of_measurement\":\"mV\","
+    "\"unique_id\":\"${remote}_batteryVoltage\",\"value_template\":\"{{ value_json.batteryVoltage }}\"},"
+    "\"lastSeenBy\":{\"p\":\"sensor\",\"name\":\"Last Seen By\",\"entity_category\":\"diagnostic\","
+    "\"unique_id\":\"${remote}_lastSeenBy\",\"value_template\":\"{{ value_json.lastSeenBy }}\"},"
+    "\"linkQuality\":{\"p\":\"sensor\",\"name\":\"Link Quality\",\"entity_category\":\"diagnostic\",\"unit_of_measurement\":\"%\","
+    "\"unique_id\":\"${remote}_linkQuality\",\"value_template\":\"{{ value_json.linkQuality }}\"},"
+    "\"lostFrames\":{\"p\":\"sensor\",\"name\":\"Lost Frames\",\"entity_category\":\"diagnostic\",\"state_class\":\"total_increasing\","
+    "\"unique_id\":\"${remote}_lostFrames\",\"value_template\":\"{{ value_json.lostFrames }}\"},"
+    "\"strongSignal\":{\"p\":\"sensor\",\"name\":\"Strong Signal\",\"entity_category\":\"diagnostic\",\"unit_of_measurement\":\"%\","
+    "\"unique_id\":\"${remote}_strongSignal\",\"value_template\":\"{{ value_json.strongSignal }}\"}"
+    "}}";
+static_assert(hasClosedPlaceholders(REMOTE_TEMPLATE), "Unclosed placeholder in the remote discovery template");
+#endif
+
+// Write a piece of the payload, without output only the size is counted
+static size_t writeRaw(Print *out, const char *data, size_t len)
+{
+    if (out != NULL && len > 0)
+    {
+        out->write(reinterpret_cast<const uint8_t *>(data), len);
+    }
+    return len;
+}
+
+// Write a value, escaped like ArduinoJson serializes strings
+static size_t writeEscaped(Print *out, const char *value)
+{
+    static const char *HEX_DIGITS = "0123456789abcdef";
+    size_t size = 0;
+    const char *run = value; // Start of the characters that need no escaping
+    for (const char *c = value; *c != '\0'; c++)
+    {
+        char escaped[7] = {'\\', 0};
+        switch (*c)
+        {
+        case '"':
+            escaped[1] = '"';
+            break;
+        case '\\':
+            escaped[1] = '\\';
+            break;
+        case '\b':
+            escaped[1] = 'b';
+            break;
+        case '\f':
+            escaped[1] = 'f';
+            break;
+        case '\n':
+            escaped[1] = 'n';
+            break;
+        case '\r':
+            escaped[1] = 'r';
+            break;
+        case '\t':
+            escaped[1] = 't';
+            break;
+        default:
+            if ((unsigned char)*c < 0x20)
+            {
+                memcpy(escaped + 1, "u00", 3);
+                escaped[4] = HEX_DIGITS[(*c >> 4) & 0x0F];
+                escaped[5] = HEX_DIGITS[*c & 0x0F];
+            }
+            break;
+        }
+        if (escaped[1] != 0)
+        {
+            size += writeRaw(out, run, c - run);
+            size += writeRaw(out, escaped, strlen(escaped));
+            run = c + 1;
+        }
+    }
+    size += writeRaw(out, run, strlen(run));
+    return size;
+}
+
+size_t BaseHaDiscovery::render(Print *out)
+{
+    size_t size = 0;
+    const char *run = payloadTemplate; // Start of the template text that is copied as is
+    const char *c = payloadTemplate;
+    while (*c != '\0')
+    {
+        if (c[0] != '$' || c[1] != '{')
+        {
+            c++;
+            continue;
+        }
+
+        size += writeRaw(out, run, c - run);
+        const char *end = strchr(c, '}');
+        if (end == NULL) // Templates are checked at compile time, this only guards templates added without the check
+        {
+            LOG_ERROR("Unclosed discovery template value: %.16s\n", c);
+            return size;
+        }
+        size_t keyLen = end - c - 2;
+        const HaSubstitution *substitution = NULL;
+        for (size_t i = 0; i < substitutionCount; i++)
+        {
+            if (strlen(substitutions[i].key) == keyLen && strncmp(substitutions[i].key, c + 2, keyLen) == 0)
+            {
+                substitution = &substitutions[i];
+                break;
+            }
+        }
+        if (substitution == NULL)
+        {
+            LOG_ERROR("Missing discovery template value: %.*s\n", keyLen, c + 2);
+        }
+        else if (substitution->raw)
+        {
+            size += writeRaw(out, substitution->value, strlen(substitution->value));
+        }
+        else
+        {
+            size += writeEscaped(out, substitution->value);
+        }
+        c = end + 1;
+        run = c;
+    }
+    size += writeRaw(out, run, c - run);
+    return size;
+}
+
+const char *BaseHaDiscovery::getTopic()
+{
+    return topic;
+}
+
+size_t BaseHaDiscovery::getPayloadSize()
+{
+    return render(NULL);
+}
+
+size_t BaseHaDiscovery::writePayload(Print &out)
+{
+    return render(&out);
+}
 
-    // Serialize the JSON document
-    size_t jsize = serializeJson(doc, payloadStr);
-    LOG_INFO("Serialized JSON size: %d str size: %d\n", jsize, payloadStr.size());
+// Hashes the rendered payload without storing it
+class FingerprintPrint : public Print
+{
+public:
+    uint32_t hash = FINGERPRINT_INIT;
+
+    size_t write(uint8_t c) override
+    {
+        hash = fingerprint(&c, 1, hash);
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        hash = fingerprint(buffer, size, hash);
+        return size;
+    }
+};
+
+uint32_t BaseHaDiscovery::getPayloadFingerprint()
+{
+    FingerprintPrint out;
+    render(&out);
+    return out.hash;
 }
 
-RemoteHaDiscovery::RemoteHaDiscovery(std::string_view baseTopic, std::string_view uuid)
+// Constructor
+HaDiscovery::HaDiscovery()
+    : deviceSubstitutions{
+          {"id", ChipID::getChipID()},
+          {"name", getDeviceName()},
+          {"set", getMqttTopics().set},
+          {"status", getMqttTopics().status},
+          {"light", getMqttTopics().light},
+          {"diagnostic", getMqttTopics().diagnostic},
+          {"stats", getMqttTopics().stats},
+          {"modes", COLOR_MODES_FRAGMENT, true},
+      }
 {
-    std:: ostringstream remoteName;
-    remoteName << REMOTE_NAME << "-" << uuid;
-
-    // Create the topic
-    std::ostringstream topicStream;
-    topicStream << "homeassistant/device/" << remoteName.str() << "/config";
-    topic = topicStream.str();
-
-    // Create the payload
-    JsonDocument doc;
-    
-    // Device Sub-Object
-    JsonObject device = doc["dev"].to<JsonObject>();
-    device["ids"] = remoteName.str();
-    device["name"] = remoteName.str();
-    device["mf"] = "MarcusVoss";
-    device["mdl"] = REMOTE_NAME;
-    std::ostringstream stateTopicStream;
-    stateTopicStream << baseTopic << "/" << remoteName.str();
-    device["state_topic"] = stateTopicStream.str();
-    device["schema"] = "json";
-
-    // Orogin Sub-Object
-    JsonObject origin = doc["o"].to<JsonObject>();
-    origin["name"] = "MarcusVoss";
-
-    // Components
-    JsonObject components = doc["cmps"].to<JsonObject>();
-
-    // Battery Sub-Object
-    JsonObject battery = components["battery"].to<JsonObject>();
-    battery["p"] = "sensor";
-    battery["name"] = "Battery";
-    battery["device_class"] = "battery";
-    battery["unit_of_measurement"] = "%";
-    std::ostringstream uniqueIDBatteryStream;
-    uniqueIDBatteryStream << remoteName.str() << "_battery";
-    battery["unique_id"] = uniqueIDBatteryStream.str();
-    battery["value_template"] = "{{ value_json.battery }}";
-
-    // Battery Voltage Sub-Object
-    JsonObject batteryVoltage = components["batteryVoltage"].to<JsonObject>();
-    batteryVoltage["p"] = "sensor";
-    batteryVoltage["name"] = "Battery Voltage";
-    batteryVoltage["device_class"] = "voltage";
-    batteryVoltage["unit_of_measurement"] = "mV";
-    std::ostringstream uniqueIDBatteryVoltageStream;
-    uniqueIDBatteryVoltageStream << remoteName.str() << "_batteryVoltage";
-    batteryVoltage["unique_id"] = uniqueIDBatteryVoltageStream.str();
-    batteryVoltage["value_template"] = "{{ value_json.batteryVoltage }}";
-
-    // lastSeenBy Sub-Object
-    JsonObject lastSeenBy = components["lastSeenBy"].to<JsonObject>();
-    lastSeenBy["p"] = "sensor";
-    lastSeenBy["name"] = "Last Seen By";
-    lastSeenBy["entity_category"] = "diagnostic";
-    std::ostringstream uniqueIDLastSeenByStream;
-    uniqueIDLastSeenByStream << remoteName.str() << "_lastSeenBy";
-    lastSeenBy["unique_id"] = uniqueIDLastSeenByStream.str();
-    lastSeenBy["value_template"] = "{{ value_json.lastSeenBy }}";
-
-    serializeJson(doc, payloadStr);
+    topic = getMqttTopics().discovery;
+    payloadTemplate = DEVICE_TEMPLATE;
+    substitutions = deviceSubstitutions;
+    substitutionCount = sizeof(deviceSubstitutions) / sizeof(deviceSubstitutions[0]);
 }
+
+#ifdef REMOTES_ENABLED
+RemoteHaDiscovery::RemoteHaDiscovery(const uint8_t *uuid)
+    : remoteSubstitutions{
+          {"remote", remoteName},
+          {"model", REMOTE_NAME},
+          {"state", getMqttRemoteTopic(uuid)},
+      }
+{
+    snprintf(remoteName, sizeof(remoteName), "%s-%02X%02X%02X%02X", REMOTE_NAME, uuid[0], uuid[1], uuid[2], uuid[3]);
+    topic = getMqttRemoteDiscoveryTopic(uuid);
+    payloadTemplate = REMOTE_TEMPLATE;
+    substitutions = remoteSubstitutions;
+    substitutionCount = sizeof(remoteSubstitutions) / sizeof(remoteSubstitutions[0]);
+}
+#endif
@@ -1,28 +1,55 @@
 #pragma once
-#include <string>
+#include "config.h"
+
+#include <Arduino.h>
+#include <cstddef>
+#include <cstdint>
+
+// Runtime value inserted into a discovery template at ${key}
+struct HaSubstitution
+{
+    const char *key;
+    const char *value;
+    bool raw = false; // Compile time JSON fragment, inserted without escaping
+};
 
 // Base class for Home Assistant Device based discovery
+// Payloads are rendered from compile time templates straight into the output,
+// so no buffer for the whole payload is needed
 class BaseHaDiscovery
 {
 protected:
-    std::string topic;
-    std::string payloadStr;
+    const char *topic = "";
+    const char *payloadTemplate = "";
+    const HaSubstitution *substitutions = NULL;
+    size_t substitutionCount = 0;
+
+    size_t render(Print *out);
 
 public:
-    std::string_view getTopic();
-    std::string_view getPayloadString();
+    const char *getTopic();
+    size_t getPayloadSize();
+    size_t writePayload(Print &out);
+    uint32_t getPayloadFingerprint();
 };
 
 // Home Assistant Device based discovery
 class HaDiscovery : public BaseHaDiscovery
 {
+    HaSubstitution deviceSubstitutions[8];
+
 public:
-    HaDiscovery(std::string_view baseTopic);
+    HaDiscovery();
 };
 
+#ifdef REMOTES_ENABLED
 // Remote Home Assistant Device based discovery
 class RemoteHaDiscovery : public BaseHaDiscovery
 {
+    char remoteName[24];
+    HaSubstitution remoteSubstitutions[3];
+
 public:
-    RemoteHaDiscovery(std::string_view baseTopic, std::string_view uuid);
-};
\ No newline at end of file
+    RemoteHaDiscovery(const uint8_t *uuid);
+};
+#endif
@@ -0,0 +1,119 @@
+#include "lightState.h"
+#include "timeSync.h"
+#include "Logging/logging.h"
+
+#include <ArduinoJson.h>
+#include <cstring>
+
+size_t serializeLightState(char *buff, size_t len)
+{
+    JsonDocument doc;
+    const char *mode = getLEDModeStr(LED_MODE); // Common Values for all modes
+    doc["mode"] = mode;
+    doc["state"] = getLedPower() ? "ON" : "OFF";
+    doc["brightness"] = getLedBrightness();
+    if (LED_MODE == LED_MODES::CCT)
+    {
+        doc["color_mode"] = "color_temp";
+        doc["color_temp"] = getLedColorTemperature();
+    }
+    else if (LED_MODE == LED_MODES::RGB || LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW)
+    {
+        doc["red"] = getLedRed();
+        doc["green"] = getLedGreen();
+        doc["blue"] = getLedBlue();
+    }
+    if (LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW)
+    {
+        doc["ww"] = getLedWW();
+    }
+    if (LED_MODE == LED_MODES::RGBWW)
+    {
+        doc["cw"] = getLedCW();
+    }
+    return serializeJson(doc, buff, len);
+}
+
+// Parse a light command, fields that are missing or invalid are left unchanged
+bool parseLightCommand(const char *payload, size_t length, LightCommand &command)
+{
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, payload, length);
+    if (error)
+    {
+        LOG_ERROR("deserializeJson() failed: %s\n", error.c_str());
+        return false;
+    }
+
+    // Read transition time (in seconds) and convert to milliseconds
+    if (doc["transition"].is<float>())
+    {
+        float transitionSec = doc["transition"];
+        if (transitionSec >= 0.0f)
+        {
+            command.transitionTimeMs = (uint32_t)(transitionSec * 1000.0f);
+        }
+        else
+        {
+            LOG_WARNING("Invalid transition value (negative): %f, using default\n", transitionSec);
+        }
+    }
+
+    // Optional Unix time in milliseconds at which the transition starts, shared by all lamps with a synchronized clock
+    if (doc["start_at"].is<uint64_t>())
+    {
+        command.hasStartTime = epochToLocalMillis(doc["start_at"].as<uint64_t>(), command.startTime);
+    }
+
+    if (doc["state"].is<const char *>())
+    {
+        const char *state = doc["state"];
+        if (strcasecmp(state, "ON") == 0)
+        {
+            command.hasPower = true;
+            command.power = true;
+        }
+        else if (strcasecmp(state, "OFF") == 0)
+        {
+            command.hasPower = true;
+            command.power = false;
+        }
+        else
+        {
+            LOG_WARNING("Invalid state value: %s\n", state);
+        }
+    }
+
+    if (doc["brightness"].is<uint16_t>())
+    {
+        command.hasBrightness = true;
+        command.brightness = doc["brightness"];
+    }
+
+    if (LED_MODE == LED_MODES::CCT && doc["color_temp"].is<uint16_t>())
+    {
+        command.hasColorTemperature = true;
+        command.mireds = doc["color_temp"];
+    }
+
+    // Channel values as reported in the state
+    bool rgbMode = LED_MODE == LED_MODES::RGB || LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW;
+    if (rgbMode && doc["red"].is<uint16_t>() && doc["green"].is<uint16_t>() && doc["blue"].is<uint16_t>())
+    {
+        command.hasRgb = true;
+        command.red = doc["red"];
+        command.green = doc["green"];
+        command.blue = doc["blue"];
+    }
+    if ((LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW) && doc["ww"].is<uint16_t>())
+    {
+        command.hasWW = true;
+        command.ww = doc["ww"];
+    }
+    if (LED_MODE == LED_MODES::RGBWW && doc["cw"].is<uint16_t>())
+    {
+        command.hasCW = true;
+        command.cw = doc["cw"];
+    }
+    return true;
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "config.h"
+#include "Output/ledControl.h"
+
+#include <cstddef>
+
+#define LIGHT_STATE_SIZE 192 // Buffer size of a serialized light state
+
+// Light state and commands in the Home Assistant JSON schema, shared by MQTT and the local API
+size_t serializeLightState(char *buff, size_t len);
+bool parseLightCommand(const char *payload, size_t length, LightCommand &command);
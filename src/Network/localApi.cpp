@@ -0,0 +1,162 @@
+#include "config.h"
+#ifdef LOCAL_API_ENABLED
+
+#include "localApi.h"
+#include "lightState.h"
+#include "mqtt.h"
+#include "publishScheduler.h"
+#include "Output/ledControl.h"
+#include "Logging/logging.h"
+
+#include <WebSocketsServer.h>
+
+static const char *LIGHT_PATH = "/api/light";
+static const char *STATS_PATH = "/api/stats";
+static const char *JSON_TYPE = "application/json";
+#ifdef MQTT_TLS_ENABLED
+static const char *CA_PATH = "/api/mqtt/ca"; // PEM CA certificate of the MQTT broker
+#endif
+
+// The number of WebSocket clients is bounded by WEBSOCKETS_SERVER_CLIENT_MAX, set in platformio.ini
+static WebSocketsServer webSocket(LOCAL_API_WEBSOCKET_PORT);
+static bool webSocketStarted = false;
+
+// Serialized light state shared by all responses, rebuilt only after the state changed
+// Validity is checked against the LED state sequence, so a dropped state event can not leave it stale
+static char stateCache[LIGHT_STATE_SIZE];
+static size_t stateCacheSize = 0;
+static int stateCacheSeq = -1;     // LED state sequence of the cached state, -1 if none was built
+static int broadcastSeq = -1;      // LED state sequence last sent to the WebSocket clients
+
+static const char *getStateCache()
+{
+    uint8_t seq = getLedStateSeq();
+    if (stateCacheSeq != seq)
+    {
+        stateCacheSize = serializeLightState(stateCache, sizeof(stateCache));
+        stateCacheSeq = seq;
+    }
+    return stateCache;
+}
+
+// Send the state to all WebSocket clients if it changed since the last broadcast
+static void broadcastState()
+{
+    if (!webSocketStarted || webSocket.connectedClients() == 0)
+    {
+        return;
+    }
+    getStateCache();
+    if (broadcastSeq != stateCacheSeq)
+    {
+        webSocket.broadcastTXT(stateCache, stateCacheSize);
+        broadcastSeq = stateCacheSeq;
+    }
+}
+
+static bool handleCommand(const char *payload, size_t length)
+{
+    LightCommand command;
+    if (!parseLightCommand(payload, length, command))
+    {
+        return false;
+    }
+    queueLightCommand(command);
+    return true;
+}
+
+static void webSocketEvent(uint8_t client, WStype_t type, uint8_t *payload, size_t length)
+{
+    switch (type)
+    {
+    case WStype_CONNECTED:
+        LOG_INFO("WebSocket client %i connected\n", client);
+        getStateCache();
+        webSocket.sendTXT(client, stateCache, stateCacheSize);
+        break;
+    case WStype_DISCONNECTED:
+        LOG_INFO("WebSocket client %i disconnected\n", client);
+        break;
+    case WStype_TEXT:
+        if (!handleCommand((const char *)payload, length))
+        {
+            webSocket.sendTXT(client, "{\"error\":\"invalid light command\"}");
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+// Add the API routes to the WiFiManager web server, called whenever the portal creates its server
+void localApiRegister(WebServer &server)
+{
+    WebServer *s = &server;
+    server.on(LIGHT_PATH, HTTP_GET, [s]()
+              {
+                  getStateCache();
+                  s->send_P(200, JSON_TYPE, stateCache, stateCacheSize); // Sent from the cache without a String copy
+              });
+    server.on(STATS_PATH, HTTP_GET, [s]()
+              {
+                  char stats[PUBLISH_SCHEDULER_PAYLOAD_SIZE];
+                  size_t size = serializeDeviceStats(stats, sizeof(stats));
+                  s->send_P(200, JSON_TYPE, stats, size);
+              });
+    server.on(LIGHT_PATH, HTTP_PUT, [s]()
+              {
+                  String body = s->arg("plain");
+                  if (!handleCommand(body.c_str(), body.length()))
+                  {
+                      s->send(400, JSON_TYPE, "{\"error\":\"invalid light command\"}");
+                      return;
+                  }
+                  s->send(202, JSON_TYPE, "{\"queued\":true}"); // Applied with the next LED update
+              });
+#ifdef MQTT_TLS_ENABLED
+    server.on(CA_PATH, HTTP_PUT, [s]()
+              {
+                  String body = s->arg("plain");
+                  if (!setMqttCaCert(body.c_str(), body.length()))
+                  {
+                      s->send(400, JSON_TYPE, "{\"error\":\"invalid certificate\"}");
+                      return;
+                  }
+                  s->send(200, JSON_TYPE, "{\"stored\":true}");
+              });
+#endif
+    LOG_INFO("Local API registered on %s\n", LIGHT_PATH);
+}
+
+void localApiBegin()
+{
+    if (webSocketStarted)
+    {
+        return;
+    }
+    webSocket.begin();
+    webSocket.onEvent(webSocketEvent);
+    webSocketStarted = true;
+    LOG_INFO("Local API WebSocket started on port %i\n", LOCAL_API_WEBSOCKET_PORT);
+}
+
+void localApiLoop()
+{
+    if (webSocketStarted)
+    {
+        webSocket.loop();
+        broadcastState(); // Catches state changes whose event was dropped
+    }
+}
+
+// Push state changes to all WebSocket clients as soon as they happen
+void localApiHandleEvent(const Event &event)
+{
+    if (event.type != EventTypes::LED_STATE_CHANGED)
+    {
+        return;
+    }
+    broadcastState();
+}
+
+#endif
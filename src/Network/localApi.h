@@ -0,0 +1,15 @@
+#pragma once
+#include "config.h"
+#ifdef LOCAL_API_ENABLED
+
+#include "Events/eventBus.h"
+
+#include <WebServer.h>
+
+// REST and WebSocket control of the light on the local network, independent of the MQTT broker
+void localApiRegister(WebServer &server);
+void localApiBegin();
+void localApiLoop();
+void localApiHandleEvent(const Event &event);
+
+#endif
@@ -2,9 +2,22 @@
 #include "Logging/logging.h"
 #include "ChipID/chipID.h"
 #include "mqtt.h"
+#include "mqttTopics.h"
+#include "mqttSession.h"
 #include "haDiscovery.h"
+#include "discoveryCache.h"
+#include "publishScheduler.h"
+#include "reconnectPolicy.h"
+#include "Logging/bootTimeline.h"
+#include "lightState.h"
+#include "timeSync.h"
+#include "groupControl.h"
+#include "tlsSessionClient.h"
+#include "asyncConnect.h"
 #include "RF/radio.h"
+#include "RF/remoteRegistry.h"
 #include "Output/ledControl.h"
+#include "Events/eventBus.h"
 
 #include <WiFi.h>
 #include <PubSubClient.h>
@@ -12,168 +25,394 @@
 #include <ArduinoJson.h>
 
 MQTT_Settings mqttSettings;
-static unsigned long mqttReconnectTimer = ULONG_MAX;
+static ReconnectPolicy mqttReconnectPolicy("MQTT", MQTT_RECONNECT_INITIAL_DELAY, MQTT_RECONNECT_MAX_DELAY);
 
+// Steps of a connection attempt, handleMQTTConnection advances at most one step per call
+enum class MqttConnectionStates
+{
+    DISCONNECTED, // Waiting for the reconnect interval
+    RESOLVE,      // Resolve the broker address
+    TCP_CONNECT,  // Open the socket
+    CONNECT,      // Send CONNECT and wait for CONNACK
+    SUBSCRIBE,    // Subscribe to the command topics
+    DISCOVERY,    // Publish Home Assistant discovery
+    ONLINE,       // Publish the online status
+    CONNECTED,
+};
+
+static MqttConnectionStates connectionState = MqttConnectionStates::DISCONNECTED;
+static IPAddress brokerIP;
+static AsyncResolver brokerResolver;
+#ifndef MQTT_TLS_ENABLED
+static AsyncConnect brokerConnect;
+#endif
+static uint8_t activeBroker = 0;  // Index of the broker in mqttSettings.brokers that is used
+static uint8_t failedBrokers = 0; // Brokers that failed in a row in the current round of connection attempts
+static unsigned long primaryProbeTimer = 0;
+static bool primaryProbing = false; // Check of the primary broker in progress while connected to a backup broker
+static bool primaryProbeResolved = false;
+static IPAddress primaryProbeIP;
+static AsyncResolver primaryProbeResolver;
+static AsyncConnect primaryProbeConnect;
+#ifdef MQTT_TLS_ENABLED
+static TlsSessionClient espClient;
+static char *caCert = NULL;             // PEM of the broker CA loaded from preferences, NULL to skip verification
+static uint32_t tlsHandshakeTime = 0;     // Duration of the last TCP connect and TLS handshake in milliseconds
+static uint32_t tlsHeapUsed = 0;          // Heap held by the TLS connection of the last handshake in bytes
+static uint32_t tlsFullHandshakeTime = 0; // Same for the last full handshake, to compare with resumed handshakes
+static uint32_t tlsFullHeapUsed = 0;
+#else
 static WiFiClient espClient;
+#endif
 static PubSubClient mqttClient(espClient);
 static Preferences preferences;
-static bool ledStateChange = false;
-static char deviceTopic[64];
+static bool ledStateChange = false;     // LED change waiting for its publish, used for the latency measurement
+static uint32_t ledStateChangeTime = 0; // micros() of the oldest LED change that was not published yet
+static bool homeassistantOnline = false; // Home Assistant came online and the state was not yet republished
+static unsigned long homeassistantOnlineTimer = 0;
 static bool homeassistantReconnect = false;
 static unsigned long homeassistantReconnectTimer = 0;
+static MQTT_PublishStats publishStats;
+static Deadband rssiDeadband(MQTT_RSSI_DEADBAND);
+
+// Serialize a payload in the format configured for its topic
+static size_t serializePayload(const JsonDocument &doc, PAYLOAD_FORMATS format, char *buff, size_t len)
+{
+    if (format == PAYLOAD_FORMATS::MSGPACK)
+    {
+        return serializeMsgPack(doc, buff, len);
+    }
+    return serializeJson(doc, buff, len);
+}
 
+static size_t getMqttLightMessage(char *buff, size_t len, uint32_t context)
+{
+    size_t size = serializeLightState(buff, len);
+
+    // The payload is built right before it is published, so this is the LED change to publish latency
+    if (ledStateChange)
+    {
+        publishStats.latency = micros() - ledStateChangeTime;
+        publishStats.maxLatency = max(publishStats.maxLatency, publishStats.latency);
+        ledStateChange = false;
+    }
+    return size;
+}
+
+static size_t getMqttDiagnosticMessage(char *buff, size_t len, uint32_t context)
+{
+    JsonDocument doc;
+    doc["ip"] = WiFi.localIP().toString();
+    doc["rssi"] = rssiDeadband.filter(WiFi.RSSI());
+    doc["publishLatency"] = publishStats.latency / 1000;
+    doc["timeSynced"] = getTimeSynced();
+    doc["broker"] = mqttSettings.brokers[activeBroker].server;
+#ifdef MQTT_TLS_ENABLED
+    doc["tlsHandshake"] = tlsHandshakeTime;
+    doc["tlsHeap"] = tlsHeapUsed;
+    doc["tlsResumed"] = espClient.getResumed();
+    doc["tlsFullHandshake"] = tlsFullHandshakeTime;
+    doc["tlsFullHeap"] = tlsFullHeapUsed;
+#endif
 #ifdef RF24RADIO_ENABLED
-static bool newRadioSeen = false;
+    doc["radioChannel"] = getRadioChannel();
+    doc["radioAddress"] = getRadioAddressString();
+#endif
+    return serializePayload(doc, PAYLOAD_FORMATS::JSON, buff, len);
+}
+
+// Counters of the publish path, the command queue, the event bus and group control
+size_t serializeDeviceStats(char *buff, size_t len)
+{
+    const MQTT_PublishStats &mqttStats = getMqttPublishStats();
+    LightCommandStats commandStats = getLightCommandStats();
+    JsonDocument doc;
+    doc["published"] = mqttStats.sent;
+    doc["suppressed"] = mqttStats.suppressed;
+    doc["publishDropped"] = mqttStats.dropped;
+    doc["publishBytes"] = mqttStats.bytes;
+    doc["publishLatency"] = mqttStats.latency / 1000;
+    doc["publishMaxLatency"] = mqttStats.maxLatency / 1000;
+    doc["commandsReceived"] = commandStats.received;
+    doc["commandsApplied"] = commandStats.applied;
+    doc["commandsStale"] = mqttSessionGetStaleCount();
+    doc["eventsDropped"] = eventBusGetDropped();
+#ifdef GROUP_CONTROL_ENABLED
+    GroupControlStats groupStats = getGroupControlStats();
+    doc["groupReceived"] = groupStats.received;
+    doc["groupDuplicates"] = groupStats.duplicates;
+    doc["groupInvalid"] = groupStats.invalid;
 #endif
+    return serializePayload(doc, PAYLOAD_FORMATS::JSON, buff, len);
+}
 
-static char *getDecviceTopic()
+static size_t getMqttStatsMessage(char *buff, size_t len, uint32_t context)
 {
-    snprintf(deviceTopic, sizeof(deviceTopic), "%s/%s", mqttSettings.topic, ChipID::getChipID());
-    return deviceTopic;
+    return serializeDeviceStats(buff, len);
 }
 
-static void getMqttLightMessage(char *buff, size_t len)
+#ifdef MQTT_FLEET_TELEMETRY_ENABLED
+// Compact state and diagnostics in one payload with short keys for fleet tooling
+static size_t getMqttFleetMessage(char *buff, size_t len, uint32_t context)
 {
     JsonDocument doc;
-    const char *mode = getLEDModeStr(LED_MODE); // Common Values for all modes
-    doc["mode"] = mode;
-    doc["state"] = getLedPower() ? "ON" : "OFF";
-    doc["brightness"] = getLedBrightness();
+    doc["v"] = SW_VERSION;
+    doc["on"] = getLedPower();
+    doc["bri"] = getLedBrightness();
     if (LED_MODE == LED_MODES::CCT)
     {
-        doc["color_mode"] = "color_temp";
-        doc["color_temp"] = getLedColorTemperature();
+        doc["ct"] = getLedColorTemperature();
     }
     else if (LED_MODE == LED_MODES::RGB || LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW)
     {
-        doc["red"] = getLedRed();
-        doc["green"] = getLedGreen();
-        doc["blue"] = getLedBlue();
+        JsonArray rgb = doc["rgb"].to<JsonArray>();
+        rgb.add(getLedRed());
+        rgb.add(getLedGreen());
+        rgb.add(getLedBlue());
     }
-    if (LED_MODE == LED_MODES::RGBW || LED_MODE == LED_MODES::RGBWW)
+    doc["rssi"] = rssiDeadband.filter(WiFi.RSSI());
+    doc["lat"] = publishStats.latency / 1000;
+    return serializePayload(doc, MQTT_FLEET_PAYLOAD_FORMAT, buff, len);
+}
+#endif
+
+static bool sendPayload(const char *topic, const uint8_t *payload, size_t size)
+{
+    if (size > 0 && payload[0] == '{')
     {
-        doc["ww"] = getLedWW();
+        log(LOG_LEVEL::INFO, "Publish MQTT message on topic %s with payload: %.*s\n", topic, size, payload);
     }
-    if (LED_MODE == LED_MODES::RGBWW)
+    else
     {
-        doc["cw"] = getLedCW();
+        log(LOG_LEVEL::INFO, "Publish MQTT message on topic %s with %u byte binary payload\n", topic, size);
     }
-    serializeJson(doc, buff, len);
+    return mqttClient.publish(topic, payload, size, false);
 }
 
-static void getMqttDiagnosticMessage(char *buff, size_t len)
+static PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+
+#ifdef REMOTES_ENABLED
+static size_t getMqttRemoteMessage(char *buff, size_t len, uint32_t id)
 {
+    Remote remote; // Copy, the radio task keeps updating the remotes
+    if (!getRemote(id, remote))
+    {
+        LOG_ERROR("Remote ID not found: %i\n", id);
+        return 0;
+    }
+
     JsonDocument doc;
-    doc["ip"] = WiFi.localIP().toString();
-    doc["rssi"] = WiFi.RSSI();
-#ifdef RF24RADIO_ENABLED
-    doc["radioChannel"] = getRadioChannel();
-    doc["radioAddress"] = getRadioAddressString();
-#endif
-    serializeJson(doc, buff, len);
+    doc["battery"] = remote.batteryPercentage;
+    doc["batteryVoltage"] = remote.batteryVoltage;
+    doc["lastSeenBy"] = getDeviceName();
+    doc["linkQuality"] = remote.link.getQuality();
+    doc["lostFrames"] = remote.link.getLost() + remote.link.getDuplicates() + remote.link.getChecksumFailures();
+    doc["strongSignal"] = remote.link.getStrongSignalPercentage();
+    return serializePayload(doc, PAYLOAD_FORMATS::JSON, buff, len);
 }
+#endif
 
-static void publish(const char *topic, const char *payload)
+// Schedule the state topics, force skips the change detection
+static void mqttPublish(bool force)
 {
-    log(LOG_LEVEL::INFO, "Publish MQTT message on topic %s with payload: %s\n", topic, payload);
-    if (!mqttClient.publish(topic, payload))
+    const MqttTopics &topics = getMqttTopics();
+    scheduler.schedule(topics.light, PublishPriorities::STATE, getMqttLightMessage, 0, force);
+    scheduler.schedule(topics.diagnostic, PublishPriorities::DIAGNOSTIC, getMqttDiagnosticMessage, 0, force);
+    // The counters change with every publish, so they are only published every MQTT_STATS_INTERVAL
+    static unsigned long lastStatsPublish = 0;
+    if (force || lastStatsPublish == 0 || millis() - lastStatsPublish >= MQTT_STATS_INTERVAL)
     {
-        LOG_ERROR("MQTT publish failed for topic: %s\n", topic);
+        scheduler.schedule(topics.stats, PublishPriorities::DIAGNOSTIC, getMqttStatsMessage, 0, force);
+        lastStatsPublish = max(millis(), 1UL);
     }
+#ifdef MQTT_FLEET_TELEMETRY_ENABLED
+    scheduler.schedule(topics.fleet, PublishPriorities::DIAGNOSTIC, getMqttFleetMessage, 0, force);
+#endif
+#ifdef REMOTES_ENABLED
+    uint32_t ids[REMOTE_REGISTRY_MAX];
+    size_t count = getRemoteIds(ids, REMOTE_REGISTRY_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t uuid[4];
+        memcpy(uuid, &ids[i], sizeof(uuid));
+        scheduler.schedule(getMqttRemoteTopic(uuid), PublishPriorities::REMOTE, getMqttRemoteMessage, ids[i], force);
+    }
+#endif
 }
 
-static bool getMqttRemoteMessage(char *buff, size_t len, size_t id)
+// Collects small writes into chunks before handing them to the MQTT client
+class MqttPublishStream : public Print
 {
-    if (getRemoteMap().find(id) == getRemoteMap().end())
+    uint8_t chunk[MQTT_STREAM_CHUNK_SIZE];
+    size_t used = 0;
+
+public:
+    size_t write(uint8_t c) override
     {
-        LOG_ERROR("Remote ID not found: %i\n", id);
-        return false;
+        return write(&c, 1);
     }
 
-    JsonDocument doc;
-    doc["battery"] = getRemoteMap()[id].batteryPercentage;
-    doc["batteryVoltage"] = getRemoteMap()[id].batteryVoltage;
-    doc["lastSeenBy"] = getDeviceName();
-    serializeJson(doc, buff, len);
-    return true;
+    size_t write(const uint8_t *data, size_t len) override
+    {
+        size_t written = len;
+        while (len > 0)
+        {
+            size_t n = min(len, sizeof(chunk) - used);
+            memcpy(chunk + used, data, n);
+            used += n;
+            data += n;
+            len -= n;
+            if (used == sizeof(chunk))
+            {
+                flush();
+            }
+        }
+        return written;
+    }
+
+    void flush()
+    {
+        if (used > 0)
+        {
+            mqttClient.write(chunk, used);
+            used = 0;
+        }
+    }
+};
+
+// Stream a retained discovery payload to the broker without buffering the whole message
+// Returns the payload size or 0 if the publish failed
+static size_t publishDiscovery(BaseHaDiscovery &discovery)
+{
+    size_t size = discovery.getPayloadSize();
+    if (!mqttClient.beginPublish(discovery.getTopic(), size, true))
+    {
+        return 0;
+    }
+    MqttPublishStream stream;
+    discovery.writePayload(stream);
+    stream.flush();
+    return mqttClient.endPublish() == 1 ? size : 0;
+}
+
+// Compare the payload fingerprint with the one stored when the discovery was last published to the active broker
+static bool getDiscoveryChanged(const char *topic, uint32_t payloadFingerprint)
+{
+    return discoveryCacheChanged(topic, mqttSettings.brokers[activeBroker].server, payloadFingerprint);
 }
 
-static void mqttPublish()
+static void storeDiscoveryFingerprint(const char *topic, uint32_t payloadFingerprint)
 {
-    // Return if MQTT is not enabled or not connected
-    if (!mqttClient.connected())
+    discoveryCacheStore(topic, mqttSettings.brokers[activeBroker].server, payloadFingerprint);
+}
+
+#ifdef REMOTES_ENABLED
+// Forget the discovery fingerprints of a topic on all brokers once its entity is gone
+static void removeDiscoveryFingerprint(const char *topic)
+{
+    for (uint8_t i = 0; i < MQTT_MAX_BROKERS; i++)
     {
-        return;
+        discoveryCacheRemove(topic, mqttSettings.brokers[i].server);
     }
-    char buffPayload[128];
-    char topic[64];
+}
+#endif
 
-    getMqttLightMessage(buffPayload, sizeof(buffPayload));
-    snprintf(topic, sizeof(topic), "%s/light", getDecviceTopic());
-    publish(topic, buffPayload);
+static size_t streamHomeAssistantDiscovery(const char *topic, uint32_t context)
+{
+    HaDiscovery haDiscovery;
+    size_t size = publishDiscovery(haDiscovery);
+    if (size == 0)
+    {
+        LOG_ERROR("MQTT Home Assistant Discovery failed\n");
+        return 0;
+    }
+    storeDiscoveryFingerprint(topic, haDiscovery.getPayloadFingerprint());
+    LOG_INFO("MQTT Home Assistant Discovery published, free heap: %u min free heap: %u\n", ESP.getFreeHeap(), ESP.getMinFreeHeap());
+    return size;
+}
 
-    getMqttDiagnosticMessage(buffPayload, sizeof(buffPayload));
-    snprintf(topic, sizeof(topic), "%s/diagnostic", getDecviceTopic());
-    publish(topic, buffPayload);
+#ifdef REMOTES_ENABLED
+static void mqttRemoteHomeAssistandDiscovery(const uint8_t *uuid, bool force);
+#endif
 
-#ifdef RF24RADIO_ENABLED
-    char uuid[9];
-    for (auto r : getRemoteMap())
+// Schedule the discovery documents whose content changed, or all of them if forced, followed by the current state
+static void mqttHomeAssistandDiscovery(bool force)
+{
+    const char *topic = getMqttTopics().discovery;
+    HaDiscovery haDiscovery;
+    if (force || getDiscoveryChanged(topic, haDiscovery.getPayloadFingerprint()))
     {
-        if (getMqttRemoteMessage(buffPayload, sizeof(buffPayload), r.first))
-        {
-            sprintf(uuid, "%02X%02X%02X%02X", r.second.uuid[0], r.second.uuid[1], r.second.uuid[2], r.second.uuid[3]);
-            snprintf(topic, sizeof(topic), "%s/RF24-Remote-%s", mqttSettings.topic, uuid);
-            publish(topic, buffPayload);
-        }
+        scheduler.scheduleStream(topic, PublishPriorities::DISCOVERY, streamHomeAssistantDiscovery);
+    }
+    else
+    {
+        LOG_INFO("MQTT Home Assistant Discovery unchanged\n");
+    }
+#ifdef REMOTES_ENABLED
+    uint32_t ids[REMOTE_REGISTRY_MAX];
+    size_t count = getRemoteIds(ids, REMOTE_REGISTRY_MAX);
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t uuid[4];
+        memcpy(uuid, &ids[i], sizeof(uuid));
+        mqttRemoteHomeAssistandDiscovery(uuid, force);
     }
 #endif
+    mqttPublish(true);
 }
 
-#ifdef RF24RADIO_ENABLED
-static void mqttRemotesHomeAssistandDiscovery()
+#ifdef REMOTES_ENABLED
+static size_t streamRemoteHomeAssistantDiscovery(const char *topic, uint32_t context)
 {
+    uint8_t uuid[4];
+    memcpy(uuid, &context, sizeof(uuid));
+    RemoteHaDiscovery remoteHaDiscovery(uuid);
+    size_t size = publishDiscovery(remoteHaDiscovery);
+    if (size == 0)
+    {
+        LOG_ERROR("MQTT Remote Home Assistant Discovery failed\n");
+        return 0;
+    }
+    storeDiscoveryFingerprint(topic, remoteHaDiscovery.getPayloadFingerprint());
+    LOG_INFO("MQTT Remote Home Assistant Discovery published\n");
+    return size;
+}
 
-    RemoteMap remoteMap = getRemoteMap();
-    for (auto r : remoteMap)
+static void mqttRemoteHomeAssistandDiscovery(const uint8_t *uuid, bool force)
+{
+    uint32_t id;
+    memcpy(&id, uuid, sizeof(id));
+    const char *topic = getMqttRemoteDiscoveryTopic(uuid);
+    RemoteHaDiscovery remoteHaDiscovery(uuid);
+    if (force || getDiscoveryChanged(topic, remoteHaDiscovery.getPayloadFingerprint()))
     {
-        JsonDocument doc;
-        char uuid[9];
-        sprintf(uuid, "%02X%02X%02X%02X", r.second.uuid[0], r.second.uuid[1], r.second.uuid[2], r.second.uuid[3]);
-        RemoteHaDiscovery remoteHaDiscovery(mqttSettings.topic, uuid);
-        std::string topic(remoteHaDiscovery.getTopic());
-        std::string_view payload = remoteHaDiscovery.getPayloadString();
-        bool res = mqttClient.publish(topic.c_str(), reinterpret_cast<const uint8_t *>(payload.data()), payload.size(), true);
-        if (res)
-        {
-            LOG_INFO("MQTT Remote Home Assistant Discovery published\n");
-        }
-        else
-        {
-            LOG_ERROR("MQTT Remote Home Assistant Discovery failed\n");
-        }
+        scheduler.scheduleStream(topic, PublishPriorities::DISCOVERY, streamRemoteHomeAssistantDiscovery, id);
     }
 }
-#endif
 
-static void mqttHomeAssistandDiscovery()
+// Drop pending publishes of a remote whose topic buffers are released, they would go out on the next remote's topics
+static void mqttRemoteTopicsReleased(const uint8_t *uuid, const char *stateTopic, const char *discoveryTopic)
 {
-    HaDiscovery haDiscovery(mqttSettings.topic);
-    std::string topic(haDiscovery.getTopic());
-    // std::string payload2(haDiscovery.getPayloadString());
-    std::string_view payload = haDiscovery.getPayloadString();
+    scheduler.remove(stateTopic);
+    scheduler.remove(discoveryTopic);
+    removeDiscoveryFingerprint(discoveryTopic); // Published again if the remote returns
+}
+#endif
 
-    // Send with retain flag
-    bool res = mqttClient.publish(topic.c_str(), reinterpret_cast<const uint8_t *>(payload.data()), payload.size(), true);
-    if (res)
+// Device settings that can be changed at runtime, currently {"groups":"name,name"}
+static void handleConfigMessage(const char *payload, size_t length)
+{
+    JsonDocument doc;
+    DeserializationError error = deserializeJson(doc, payload, length);
+    if (error)
     {
-        LOG_INFO("MQTT Home Assistant Discovery published\n");
+        LOG_ERROR("deserializeJson() failed: %s\n", error.c_str());
+        return;
     }
-    else
+    if (doc["groups"].is<const char *>())
     {
-        LOG_ERROR("MQTT Home Assistant Discovery failed\n");
+        setMqttGroups(doc["groups"].as<const char *>());
     }
-    mqttPublish(); // Publish current state to MQTT
 }
 
 IRAM_ATTR static void mqttCallback(char *topic, byte *payload, unsigned int length)
@@ -182,17 +421,14 @@ IRAM_ATTR static void mqttCallback(char *topic, byte *payload, unsigned int leng
     LOG_INFO("Message arrived [%s] payload: %.*s\n", topic, length, payload);
 
     // Check if the message is a homeassistant status message
-    if (strcmp(topic, "homeassistant/status") == 0)
+    if (strcmp(topic, MQTT_HA_STATUS_TOPIC) == 0)
     {
         // Check if the payload is "online"
         if (strcasecmp((char *)payload, "online") == 0)
         {
             LOG_INFO("Home Assistant changed status to online\n");
-            mqttPublish(); // Publish current state to MQTT
-
-            // Resend current Status again after in case Home Assistant missed it
-            homeassistantReconnect = true;
-            homeassistantReconnectTimer = millis();
+            homeassistantOnline = true; // Republished after the device jitter so the fleet does not publish at once
+            homeassistantOnlineTimer = millis();
         }
         else if (strcasecmp((char *)payload, "offline") == 0)
         {
@@ -205,91 +441,325 @@ IRAM_ATTR static void mqttCallback(char *topic, byte *payload, unsigned int leng
         return;
     }
 
-    // Convert payload to JSON
-    JsonDocument doc;
-    DeserializationError error = deserializeJson(doc, payload, length);
-    if (error)
+    if (strcmp(topic, getMqttTopics().config) == 0)
     {
-        LOG_ERROR("deserializeJson() failed: %s\n", error.c_str());
+        handleConfigMessage((const char *)payload, length);
         return;
     }
-    
-    // Read transition time (in seconds) and convert to milliseconds
-    uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME;
-    if (doc["transition"].is<float>())
+
+    // The session may still deliver commands queued on topics of earlier settings
+    if (!mqttSessionIsSubscribed(topic))
     {
-        float transitionSec = doc["transition"];
-        if (transitionSec >= 0.0f)
+        LOG_WARNING("Ignoring message on %s, the topic is no longer subscribed\n", topic);
+        return;
+    }
+
+    // Device, group and broadcast commands are queued and coalesced, so a slider drag ends up as a single LED update
+    LightCommand command;
+    if (parseLightCommand((const char *)payload, length, command) && !mqttSessionIsStale(command))
+    {
+        queueLightCommand(command);
+    }
+}
+
+static const char *getConnectionStateStr(MqttConnectionStates state)
+{
+    switch (state)
+    {
+    case MqttConnectionStates::DISCONNECTED:
+        return "DISCONNECTED";
+    case MqttConnectionStates::RESOLVE:
+        return "RESOLVE";
+    case MqttConnectionStates::TCP_CONNECT:
+        return "TCP_CONNECT";
+    case MqttConnectionStates::CONNECT:
+        return "CONNECT";
+    case MqttConnectionStates::SUBSCRIBE:
+        return "SUBSCRIBE";
+    case MqttConnectionStates::DISCOVERY:
+        return "DISCOVERY";
+    case MqttConnectionStates::ONLINE:
+        return "ONLINE";
+    case MqttConnectionStates::CONNECTED:
+        return "CONNECTED";
+    }
+    return "UNKNOWN";
+}
+
+static void setConnectionState(MqttConnectionStates state)
+{
+    LOG_DEBUG("MQTT connection state: %s -> %s\n", getConnectionStateStr(connectionState), getConnectionStateStr(state));
+    connectionState = state;
+}
+
+static uint8_t getBrokerCount()
+{
+    uint8_t count = 0;
+    while (count < MQTT_MAX_BROKERS && mqttSettings.brokers[count].server[0] != '\0')
+    {
+        count++;
+    }
+    return count;
+}
+
+static bool changeSubscription(const char *topic, bool subscribe)
+{
+    return subscribe ? mqttClient.subscribe(topic, MQTT_SUBSCRIBE_QOS) : mqttClient.unsubscribe(topic);
+}
+
+// Subscribe to the device, config, broadcast and group command topics and the homeassistant status topic
+// Topics of earlier settings that the persistent session still holds are unsubscribed
+// Without resubscribe only topics the session does not have yet are subscribed
+static bool mqttSubscribeCommands(bool resubscribe)
+{
+    const MqttTopics &topics = getMqttTopics();
+    const char *list[MQTT_SESSION_MAX_TOPICS];
+    uint8_t count = 0;
+    list[count++] = topics.set;
+    list[count++] = topics.config;
+    list[count++] = MQTT_HA_STATUS_TOPIC;
+#ifdef MQTT_ALL_TOPIC_ENABLED
+    list[count++] = topics.all;
+#endif
+    for (uint8_t i = 0; i < topics.groupCount; i++)
+    {
+        list[count++] = topics.groups[i];
+    }
+    return mqttSessionSubscribe(mqttSettings.brokers[activeBroker].server, list, count, resubscribe, changeSubscription);
+}
+
+// Change the group subscriptions, groups that stay are not touched so no command is missed
+void setMqttGroups(const char *groups)
+{
+    if (strcmp(groups, mqttSettings.groups) == 0)
+    {
+        return;
+    }
+    snprintf(mqttSettings.groups, sizeof(mqttSettings.groups), "%s", groups);
+    mqttTopicsBuildGroups(mqttSettings.groups);
+    preferences.begin("mqtt_config", false);
+    preferences.putString("mqttGroups", mqttSettings.groups);
+    preferences.end();
+    LOG_INFO("MQTT groups set to %s\n", mqttSettings.groups);
+
+    if (!getMQTTConnected())
+    {
+        return; // The stored session still lists the removed groups, they are unsubscribed with the next connection
+    }
+    if (!mqttSubscribeCommands(false))
+    {
+        LOG_WARNING("Failed to change the MQTT group subscriptions\n");
+    }
+}
+
+// Drop a DNS lookup or TCP connect that is still in progress
+static void mqttCancelAttempt()
+{
+    brokerResolver.cancel();
+#ifndef MQTT_TLS_ENABLED
+    brokerConnect.cancel();
+#endif
+    primaryProbeResolver.cancel();
+    primaryProbeConnect.cancel();
+    primaryProbeResolved = false;
+    primaryProbing = false;
+}
+
+// Abort the connection attempt, a failed broker is replaced by the next one right away and the reconnect
+// backs off once every broker failed in this round, the next round starts with the primary broker
+// A lost connection is retried on the same broker without counting, so a single drop does not switch the broker
+static void mqttConnectFailed(const char *step)
+{
+    LOG_INFO("MQTT connection to %s failed in step %s, rc=%i\n", mqttSettings.brokers[activeBroker].server, step, mqttClient.state());
+    bool connectionLost = connectionState == MqttConnectionStates::CONNECTED;
+    mqttSessionOffline();
+    mqttClient.disconnect();
+    espClient.stop();
+    mqttCancelAttempt();
+    if (connectionLost)
+    {
+        failedBrokers = 0;
+        setConnectionState(MqttConnectionStates::DISCONNECTED);
+        return;
+    }
+    uint8_t brokerCount = max(getBrokerCount(), (uint8_t)1);
+    if (++failedBrokers < brokerCount)
+    {
+        activeBroker = (activeBroker + 1) % brokerCount;
+        LOG_INFO("Failing over to MQTT broker %s\n", mqttSettings.brokers[activeBroker].server);
+        setConnectionState(MqttConnectionStates::RESOLVE); // Without waiting for the backoff of earlier rounds
+        return;
+    }
+    failedBrokers = 0;
+    activeBroker = 0;
+    mqttReconnectPolicy.failed();
+    setConnectionState(MqttConnectionStates::DISCONNECTED);
+}
+
+// Advance the connection by one step, the DNS lookup and the TCP connect are polled and bounded by MQTT_CONNECT_TIMEOUT
+// The TLS handshake and waiting for CONNACK still block, together for up to MQTT_CONNECT_TIMEOUT plus
+// MQTT_TLS_HANDSHAKE_TIMEOUT seconds with TLS and MQTT_CONNECT_TIMEOUT without, see their steps
+static void mqttConnectStep()
+{
+    switch (connectionState)
+    {
+    case MqttConnectionStates::DISCONNECTED:
+        if (mqttReconnectPolicy.ready())
         {
-            transitionTimeMs = (uint32_t)(transitionSec * 1000.0f);
+            setConnectionState(MqttConnectionStates::RESOLVE);
         }
-        else
+        break;
+
+    case MqttConnectionStates::RESOLVE:
+    {
+        // Polled, the network task keeps running while the DNS server answers
+        AsyncResults result = brokerResolver.poll(mqttSettings.brokers[activeBroker].server, brokerIP, MQTT_CONNECT_TIMEOUT);
+        if (result == AsyncResults::FAILED)
+        {
+            mqttConnectFailed("RESOLVE");
+        }
+        else if (result == AsyncResults::DONE)
         {
-            LOG_WARNING("Invalid transition value (negative): %f, using default\n", transitionSec);
+            setConnectionState(MqttConnectionStates::TCP_CONNECT);
         }
+        break;
     }
-    
-    if (doc["state"].is<const char *>())
+
+    case MqttConnectionStates::TCP_CONNECT:
     {
-        const char *state = doc["state"];
-        if (strcasecmp(state, "ON") == 0)
+#ifdef MQTT_TLS_ENABLED
+        // Connect by name so the certificate is verified against the host name, the lookup is cached by RESOLVE
+        // The session of the last connection to this broker is offered, so a reconnect usually skips the full handshake
+        // WiFiClientSecure connects and runs the handshake in one call, so this step blocks for up to
+        // MQTT_CONNECT_TIMEOUT for the TCP connect plus MQTT_TLS_HANDSHAKE_TIMEOUT for the handshake
+        uint32_t freeHeap = ESP.getFreeHeap();
+        unsigned long handshakeStart = millis();
+        bool connected = espClient.connect(mqttSettings.brokers[activeBroker].server, mqttSettings.brokers[activeBroker].port, MQTT_CONNECT_TIMEOUT);
+        tlsHandshakeTime = millis() - handshakeStart;
+        if (!connected)
         {
-            setLedPower(true, transitionTimeMs);
+            char error[64];
+            espClient.lastError(error, sizeof(error));
+            LOG_WARNING("TLS connection failed after %lu ms: %s\n", (unsigned long)tlsHandshakeTime, error);
+            mqttConnectFailed("TCP_CONNECT");
+            break;
         }
-        else if (strcasecmp(state, "OFF") == 0)
+        tlsHeapUsed = freeHeap > ESP.getFreeHeap() ? freeHeap - ESP.getFreeHeap() : 0;
+        if (!espClient.getResumed())
         {
-            setLedPower(false, transitionTimeMs);
+            tlsFullHandshakeTime = tlsHandshakeTime;
+            tlsFullHeapUsed = tlsHeapUsed;
         }
-        else
+        LOG_INFO("TLS handshake %s took %lu ms and %lu bytes of heap, the last full handshake took %lu ms and %lu bytes\n",
+                 espClient.getResumed() ? "resuming the session" : "without resumption", (unsigned long)tlsHandshakeTime,
+                 (unsigned long)tlsHeapUsed, (unsigned long)tlsFullHandshakeTime, (unsigned long)tlsFullHeapUsed);
+        setConnectionState(MqttConnectionStates::CONNECT);
+#else
+        // Polled, the socket is handed to espClient once the broker accepted the connection
+        AsyncResults result = brokerConnect.poll(brokerIP, mqttSettings.brokers[activeBroker].port, MQTT_CONNECT_TIMEOUT, &espClient);
+        if (result == AsyncResults::FAILED)
         {
-            LOG_WARNING("Invalid state value: %s\n", state);
+            mqttConnectFailed("TCP_CONNECT");
         }
+        else if (result == AsyncResults::DONE)
+        {
+            setConnectionState(MqttConnectionStates::CONNECT);
+        }
+#endif
+        break;
     }
 
-    if (doc["brightness"].is<uint16_t>())
+    case MqttConnectionStates::CONNECT:
     {
-        uint16_t brightness = doc["brightness"];
-        setLedBrightness(brightness, transitionTimeMs);
+        // The socket is already open, so PubSubClient only sends CONNECT and waits for CONNACK
+        // PubSubClient has no way to send CONNECT without waiting, so this step blocks for up to MQTT_CONNECT_TIMEOUT
+        // Without a clean session the broker keeps the subscriptions and queues QoS 1 commands while the device is offline
+        mqttClient.setServer(brokerIP, mqttSettings.brokers[activeBroker].port);
+        mqttClient.setCallback(mqttCallback);
+        mqttClient.setBufferSize(MQTT_BUFFER_SIZE); // Large payloads are streamed, see publishDiscovery
+        mqttClient.setSocketTimeout(max(MQTT_CONNECT_TIMEOUT / 1000, 1));
+        const MqttTopics &topics = getMqttTopics();
+        if (!mqttClient.connect(ChipID::getChipID(), mqttSettings.username, mqttSettings.password, topics.status, 1, true, "offline", MQTT_CLEAN_SESSION))
+        {
+            mqttConnectFailed("CONNECT");
+            break;
+        }
+        mqttSessionOnline();
+        setConnectionState(MqttConnectionStates::SUBSCRIBE);
+        break;
     }
-    
-    if (LED_MODE == LED_MODES::CCT && doc["color_temp"].is<uint16_t>())
-    {
-        uint16_t color_temp = doc["color_temp"];
-        setLedColorTemperature(color_temp, transitionTimeMs);
+
+    case MqttConnectionStates::SUBSCRIBE:
+        if (!mqttSubscribeCommands(true))
+        {
+            mqttConnectFailed("SUBSCRIBE");
+            break;
+        }
+        setConnectionState(MqttConnectionStates::DISCOVERY);
+        break;
+
+    case MqttConnectionStates::DISCOVERY:
+        // State changed while offline is still pending in the scheduler and is flushed with the discovery
+        ledStateChange = false; // Offline time is not publish latency
+        mqttHomeAssistandDiscovery(false); // Retained discovery is only republished if it differs from the one on this broker
+        setConnectionState(MqttConnectionStates::ONLINE);
+        break;
+
+    case MqttConnectionStates::ONLINE:
+        mqttClient.publish(getMqttTopics().status, "online", true);
+        LOG_INFO("MQTT connected to %s\n", mqttSettings.brokers[activeBroker].server);
+        mqttReconnectPolicy.succeeded();
+        failedBrokers = 0;
+        primaryProbeTimer = millis();
+        bootTimelineEnd("MQTT connected");
+        setConnectionState(MqttConnectionStates::CONNECTED);
+        break;
+
+    case MqttConnectionStates::CONNECTED:
+        if (!mqttClient.connected())
+        {
+            mqttConnectFailed("CONNECTED"); // Connection lost
+        }
+        break;
     }
 }
 
-static void mqttConnect()
+// Drop the current connection and start a new connection attempt
+static void mqttReconnect()
 {
-    // Make sure the connection is disconnected
+    mqttSessionOffline();
     if (mqttClient.connected())
     {
         mqttClient.disconnect();
-        delay(500);
-    }
-
-    mqttClient.setServer(mqttSettings.server, mqttSettings.port);
-    mqttClient.setCallback(mqttCallback);
-    mqttClient.setBufferSize(2048); // Increase the buffer size
-    if (mqttClient.connect(ChipID::getChipID(), mqttSettings.username, mqttSettings.password, (String(getDecviceTopic()) + "/status").c_str(), 1, true, "offline"))
-    {                
-        mqttClient.subscribe((String(getDecviceTopic()) + "/set").c_str()); // Subscribe to the set topic
-        mqttClient.subscribe("homeassistant/status");                       // Subscribe to the homeassistant status topic
-        setLedCallback([]()
-                       { ledStateChange = true; });
-#ifdef RF24RADIO_ENABLED
-        setRadioCallback([]()
-                         { newRadioSeen = true; });
-#endif
-        LOG_INFO("MQTT connected\n");
-        delay(100);
-        mqttHomeAssistandDiscovery();
-        mqttClient.publish((String(getDecviceTopic()) + "/status").c_str(), "online", true);
     }
-    else
+    espClient.stop();
+    mqttCancelAttempt();
+    scheduler.clear(); // Topics may have changed
+    activeBroker = 0;
+    failedBrokers = 0;
+    setConnectionState(MqttConnectionStates::RESOLVE);
+}
+
+// Check with a plain TCP connect if the primary broker accepts connections again
+// Polled like the connection steps, so the connection to the backup broker keeps running meanwhile
+static AsyncResults probePrimaryBroker()
+{
+    const MQTT_Broker &primary = mqttSettings.brokers[0];
+    if (!primaryProbeResolved)
     {
-        LOG_INFO("MQTT connection failed, rc=%i\n", mqttClient.state());
+        AsyncResults result = primaryProbeResolver.poll(primary.server, primaryProbeIP, MQTT_CONNECT_TIMEOUT);
+        if (result != AsyncResults::DONE)
+        {
+            return result;
+        }
+        primaryProbeResolved = true;
     }
+    AsyncResults result = primaryProbeConnect.poll(primaryProbeIP, primary.port, MQTT_PRIMARY_PROBE_TIMEOUT, NULL);
+    if (result != AsyncResults::PENDING)
+    {
+        primaryProbeResolved = false;
+    }
+    return result;
 }
 
 void handleMQTTConnection()
@@ -300,54 +770,137 @@ void handleMQTTConnection()
         return;
     }
 
-    // Send MQTT status message to Home Assistant if Home Assistant just reconnected
-    if (homeassistantReconnect && millis() - homeassistantReconnectTimer > 5000)
+    mqttConnectStep(); // Advance the connection by at most one step
+    if (connectionState != MqttConnectionStates::CONNECTED)
     {
-        LOG_INFO("Sending MQTT status message again to Home Assistant\n");
-        mqttPublish(); // Publish current state to MQTT
-        homeassistantReconnect = false;
+        return;
     }
 
-    // Attempt MQTT reconnection if disconnected and interval has passed
-    if (!mqttClient.connected() && millis() - mqttReconnectTimer > MQTT_RECONNECT_ATTEMPT_INTERVAL)
+    // Return to the primary broker once it is back, pending publishes are kept for the new connection
+    if (activeBroker != 0 && (primaryProbing || millis() - primaryProbeTimer >= MQTT_PRIMARY_PROBE_INTERVAL))
     {
-        mqttConnect();                 // Establish MQTT connection
-        mqttReconnectTimer = millis(); // Reset the timer after a connection attempt
+        primaryProbing = true;
+        AsyncResults result = probePrimaryBroker();
+        if (result != AsyncResults::PENDING)
+        {
+            primaryProbing = false;
+            primaryProbeTimer = millis();
+        }
+        if (result == AsyncResults::DONE)
+        {
+            LOG_INFO("Primary MQTT broker %s is reachable again\n", mqttSettings.brokers[0].server);
+            mqttSessionOffline();
+            mqttClient.disconnect();
+            espClient.stop();
+            activeBroker = 0;
+            failedBrokers = 0;
+            setConnectionState(MqttConnectionStates::RESOLVE);
+            return;
+        }
     }
 
-    static unsigned long lastPublishTime = 0;
-    unsigned long delta = millis() - lastPublishTime;
+    // Publish discovery and state once Home Assistant came online, spread over MQTT_HA_REPUBLISH_SPREAD across the fleet
+    if (homeassistantOnline && millis() - homeassistantOnlineTimer >= getDeviceJitter(MQTT_HA_REPUBLISH_SPREAD))
+    {
+        mqttHomeAssistandDiscovery(true);
+        homeassistantOnline = false;
+        homeassistantReconnect = true; // Resend in case Home Assistant missed it
+        homeassistantReconnectTimer = millis();
+    }
 
-    if (delta < MQTT_MIN_DELAY)
+    // Send MQTT status message to Home Assistant if Home Assistant just reconnected
+    if (homeassistantReconnect && millis() - homeassistantReconnectTimer > MQTT_HA_RESEND_DELAY)
     {
-        return; // Prevent MQTT messages from being sent too frequently
+        LOG_INFO("Sending MQTT status message again to Home Assistant\n");
+        mqttPublish(true); // Publish current state to MQTT
+        homeassistantReconnect = false;
     }
 
-    if (ledStateChange || (MQTT_PUBLISH_INTERVAL != -1 && (delta >= MQTT_PUBLISH_INTERVAL)))
+    // Periodically refresh all state topics, unchanged payloads are suppressed by the scheduler
+    static unsigned long lastPeriodicPublish = 0;
+    if (MQTT_PUBLISH_INTERVAL != -1 && millis() - lastPeriodicPublish >= MQTT_PUBLISH_INTERVAL)
     {
-        mqttPublish(); // Publish data to MQTT
-        lastPublishTime = millis();
-        ledStateChange = false;
+        mqttPublish(false);
+        lastPeriodicPublish = millis();
     }
-#ifdef RF24RADIO_ENABLED
-    if (newRadioSeen)
+
+    scheduler.process(); // Publish pending topics by priority within the rate limit
+    mqttClient.loop();   // Allow MQTT client to process incoming and outgoing messages
+}
+
+void mqttHandleEvent(const Event &event)
+{
+    switch (event.type)
     {
-        mqttRemotesHomeAssistandDiscovery();
-        newRadioSeen = false;
+    case EventTypes::LED_STATE_CHANGED:
+        if (!ledStateChange)
+        {
+            ledStateChangeTime = event.timestamp;
+        }
+        ledStateChange = true;
+        scheduler.schedule(getMqttTopics().light, PublishPriorities::STATE, getMqttLightMessage);
+        break;
+#ifdef REMOTES_ENABLED
+    case EventTypes::REMOTE_SEEN:
+        mqttRemoteHomeAssistandDiscovery(event.remote.uuid, false);
+        break;
+    case EventTypes::REMOTE_EVENT:
+    {
+        // Battery and link state of the sender may have changed
+        uint32_t id;
+        memcpy(&id, event.remote.uuid, sizeof(id));
+        scheduler.schedule(getMqttRemoteTopic(event.remote.uuid), PublishPriorities::REMOTE, getMqttRemoteMessage, id);
+        break;
     }
+    case EventTypes::REMOTE_EVICTED:
+        mqttTopicsReleaseRemote(event.remote.uuid);
+        break;
 #endif
-    mqttClient.loop(); // Allow MQTT client to process incoming and outgoing messages
+    case EventTypes::CONFIG_CHANGED:
+        mqttHomeAssistandDiscovery(false); // Republish changed discovery and the state with the new settings
+        break;
+    default:
+        break;
+    }
 }
 
 bool getMqttEnabled()
 {
-    bool enabled = (strlen(mqttSettings.server) > 0 && mqttSettings.port > 0);
+    bool enabled = (strlen(mqttSettings.brokers[0].server) > 0 && mqttSettings.brokers[0].port > 0);
     return enabled;
 }
 
+const char *getMqttActiveBroker()
+{
+    return mqttSettings.brokers[activeBroker].server;
+}
+
+const MQTT_PublishStats &getMqttPublishStats()
+{
+    const PublishSchedulerStats &schedulerStats = scheduler.getStats();
+    publishStats.sent = schedulerStats.sent;
+    publishStats.suppressed = schedulerStats.suppressed;
+    publishStats.dropped = schedulerStats.dropped;
+    publishStats.bytes = schedulerStats.bytes;
+    return publishStats;
+}
+
 bool getMQTTConnected()
 {
-    return (mqttClient.connected());
+    return (connectionState == MqttConnectionStates::CONNECTED && mqttClient.connected());
+}
+
+// Preference keys of a broker, the primary broker keeps the keys from before the broker list
+static void getBrokerKeys(uint8_t index, char *serverKey, char *portKey, size_t len)
+{
+    if (index == 0)
+    {
+        snprintf(serverKey, len, "mqttServer");
+        snprintf(portKey, len, "mqttPort");
+        return;
+    }
+    snprintf(serverKey, len, "mqttServer%i", index);
+    snprintf(portKey, len, "mqttPort%i", index);
 }
 
 static void saveMqttSettings()
@@ -355,24 +908,78 @@ static void saveMqttSettings()
     LOG_INFO("Saving MQTT settings\n");
     preferences.begin("mqtt_config", false);
     preferences.putString("deviceName", getDeviceName());
-    preferences.putString("mqttServer", mqttSettings.server);
+    for (uint8_t i = 0; i < MQTT_MAX_BROKERS; i++)
+    {
+        char serverKey[16], portKey[16];
+        getBrokerKeys(i, serverKey, portKey, sizeof(serverKey));
+        preferences.putString(serverKey, mqttSettings.brokers[i].server);
+        preferences.putInt(portKey, mqttSettings.brokers[i].port);
+    }
     preferences.putString("mqttUsername", mqttSettings.username);
     preferences.putString("mqttPassword", mqttSettings.password);
     preferences.putString("mqttTopic", mqttSettings.topic);
-    preferences.putInt("mqttPort", mqttSettings.port);
     preferences.end();
 }
 
-void setMqttSettings(const char *server, const unsigned int port, const char *username, const char *password, const char *topic)
+// Parse "host:port,host:port" into the backup brokers, the port defaults to 1883
+static void parseBackupBrokers(const char *list)
+{
+    for (uint8_t i = 1; i < MQTT_MAX_BROKERS; i++)
+    {
+        mqttSettings.brokers[i] = MQTT_Broker();
+    }
+    uint8_t index = 1;
+    while (list != NULL && *list != '\0' && index < MQTT_MAX_BROKERS)
+    {
+        const char *end = strchr(list, ',');
+        size_t length = end != NULL ? end - list : strlen(list);
+        const char *colon = (const char *)memchr(list, ':', length);
+        size_t serverLength = colon != NULL ? colon - list : length;
+        if (serverLength > 0 && serverLength < sizeof(mqttSettings.brokers[index].server))
+        {
+            MQTT_Broker &broker = mqttSettings.brokers[index++];
+            memcpy(broker.server, list, serverLength);
+            broker.server[serverLength] = '\0';
+            broker.port = colon != NULL ? atoi(colon + 1) : 1883;
+        }
+        list = end != NULL ? end + 1 : NULL;
+    }
+}
+
+void getMqttBackupBrokers(char *buff, size_t len)
+{
+    size_t offset = 0;
+    buff[0] = '\0';
+    for (uint8_t i = 1; i < MQTT_MAX_BROKERS && mqttSettings.brokers[i].server[0] != '\0' && offset < len; i++)
+    {
+        offset += snprintf(buff + offset, len - offset, "%s%s:%i", i > 1 ? "," : "", mqttSettings.brokers[i].server, mqttSettings.brokers[i].port);
+    }
+}
+
+void setMqttSettings(const char *server, const unsigned int port, const char *username, const char *password, const char *topic, const char *backupBrokers)
 {
-    strcpy(mqttSettings.server, server);
-    mqttSettings.port = port;
+    MQTT_Broker previousBrokers[MQTT_MAX_BROKERS];
+    memcpy(previousBrokers, mqttSettings.brokers, sizeof(previousBrokers));
+    bool topicChanged = strcmp(mqttSettings.topic, topic) != 0;
+    strcpy(mqttSettings.brokers[0].server, server);
+    mqttSettings.brokers[0].port = port;
+    parseBackupBrokers(backupBrokers);
     strcpy(mqttSettings.username, username);
     strcpy(mqttSettings.password, password);
     strcpy(mqttSettings.topic, topic);
+    mqttTopicsBuild(mqttSettings.topic);
+    bool brokersChanged = false;
+    for (uint8_t i = 0; i < MQTT_MAX_BROKERS; i++)
+    {
+        brokersChanged = brokersChanged || strcmp(previousBrokers[i].server, mqttSettings.brokers[i].server) != 0;
+    }
+    if (topicChanged || brokersChanged)
+    {
+        discoveryCacheClear(); // The discovery is published again to the new topics or brokers
+    }
     LOG_INFO("MQTT settings updated\n");
     saveMqttSettings();
-    mqttConnect(); // Reconnect to MQTT with new settings
+    mqttReconnect(); // Reconnect to MQTT with new settings
 }
 
 static void loadMQTTsettings()
@@ -383,17 +990,73 @@ static void loadMQTTsettings()
     {
         setDeviceName(deviceName);
     }
-    strcpy(mqttSettings.server, preferences.getString("mqttServer", "").c_str());
-    mqttSettings.port = preferences.getInt("mqttPort", 1883);
+    for (uint8_t i = 0; i < MQTT_MAX_BROKERS; i++)
+    {
+        char serverKey[16], portKey[16];
+        getBrokerKeys(i, serverKey, portKey, sizeof(serverKey));
+        strcpy(mqttSettings.brokers[i].server, preferences.getString(serverKey, "").c_str());
+        mqttSettings.brokers[i].port = preferences.getInt(portKey, 1883);
+    }
     strcpy(mqttSettings.username, preferences.getString("mqttUsername", "").c_str());
     strcpy(mqttSettings.password, preferences.getString("mqttPassword", "").c_str());
     strcpy(mqttSettings.topic, preferences.getString("mqttTopic", "").c_str());
+    preferences.getString("mqttGroups", mqttSettings.groups, sizeof(mqttSettings.groups));
     preferences.end();
-    LOG_INFO("MQTT Settings loaded: Server: %s Port: %i Username: %s Password: %s Topic: %s\n",
-             mqttSettings.server, mqttSettings.port, mqttSettings.username, mqttSettings.password, mqttSettings.topic);
+    mqttTopicsBuildGroups(mqttSettings.groups);
+    mqttTopicsBuild(mqttSettings.topic);
+    char backupBrokers[MQTT_BROKER_LIST_SIZE];
+    getMqttBackupBrokers(backupBrokers, sizeof(backupBrokers));
+    LOG_INFO("MQTT Settings loaded: Server: %s Port: %i Backup: %s Username: %s Password: %s Topic: %s\n",
+             mqttSettings.brokers[0].server, mqttSettings.brokers[0].port, backupBrokers, mqttSettings.username, mqttSettings.password, mqttSettings.topic);
 }
 
+#ifdef MQTT_TLS_ENABLED
+// Apply the CA from preferences, without one the connection is encrypted but the broker is not verified
+static void loadMqttCaCert()
+{
+    preferences.begin("mqtt_config", true);
+    String pem = preferences.getString("caCert", "");
+    preferences.end();
+    free(caCert);
+    caCert = NULL;
+    espClient.clearSession(); // Sessions were verified with the previous certificate
+    if (pem.length() == 0)
+    {
+        LOG_WARNING("No MQTT CA certificate stored, the broker is not verified\n");
+        espClient.setInsecure();
+        return;
+    }
+    caCert = strdup(pem.c_str()); // Must stay valid as long as the client uses it
+    espClient.setCACert(caCert);
+    LOG_INFO("Loaded MQTT CA certificate with %u bytes\n", pem.length());
+}
+
+// Store a PEM CA certificate for the broker, an empty certificate disables verification
+bool setMqttCaCert(const char *pem, size_t length)
+{
+    const char *header = "-----BEGIN CERTIFICATE-----";
+    if (length > MQTT_TLS_CA_MAX_SIZE || (length > 0 && strncmp(pem, header, strlen(header)) != 0))
+    {
+        LOG_WARNING("Invalid MQTT CA certificate\n");
+        return false;
+    }
+    preferences.begin("mqtt_config", false);
+    preferences.putString("caCert", length > 0 ? pem : "");
+    preferences.end();
+    loadMqttCaCert();
+    mqttReconnect(); // Connect again with the new certificate
+    return true;
+}
+#endif
+
 void mqttInit()
 {
     loadMQTTsettings();
+#ifdef REMOTES_ENABLED
+    setMqttRemoteTopicsReleasedCallback(mqttRemoteTopicsReleased);
+#endif
+#ifdef MQTT_TLS_ENABLED
+    loadMqttCaCert();
+    espClient.setHandshakeTimeout(MQTT_TLS_HANDSHAKE_TIMEOUT);
+#endif
 }
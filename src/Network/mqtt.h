@@ -1,18 +1,51 @@
 #pragma once
+#include "config.h"
+#include "Events/eventBus.h"
+#include "mqttTopics.h"
 
-struct MQTT_Settings
+#include <cstddef>
+#include <cstdint>
+
+#define MQTT_BROKER_LIST_SIZE ((MQTT_MAX_BROKERS - 1) * 47) // "host:port," for every backup broker
+
+struct MQTT_Broker
 {
     char server[40] = "";
+    int port = 1883;
+};
+
+struct MQTT_Settings
+{
+    MQTT_Broker brokers[MQTT_MAX_BROKERS]; // Ordered by priority, the first one is the primary broker
     char username[40];
     char password[40];
     char topic[40] = "";
-    int port = 1883;
+    char groups[MQTT_GROUP_LIST_SIZE] = ""; // Comma separated groups whose <base>/group/<name>/set topics are subscribed
+};
+
+struct MQTT_PublishStats
+{
+    uint32_t sent = 0;       // Payloads published
+    uint32_t suppressed = 0; // Periodic publishes skipped because the payload did not change
+    uint32_t dropped = 0;    // Publishes lost because all scheduler slots were pending
+    uint32_t bytes = 0;      // Size of the sent PUBLISH packets including headers
+    uint32_t latency = 0;    // Time from the last published LED change to its publish in microseconds
+    uint32_t maxLatency = 0; // Highest latency since boot in microseconds
 };
 
 extern MQTT_Settings mqttSettings;
 
 bool getMqttEnabled();
 bool getMQTTConnected();
+const MQTT_PublishStats &getMqttPublishStats();
+size_t serializeDeviceStats(char *buff, size_t len);
 void handleMQTTConnection();
+void mqttHandleEvent(const Event &event);
 void mqttInit();
-void setMqttSettings(const char *server, const unsigned int port, const char *username, const char *password, const char *topic);
+void setMqttSettings(const char *server, const unsigned int port, const char *username, const char *password, const char *topic, const char *backupBrokers);
+void getMqttBackupBrokers(char *buff, size_t len);
+void setMqttGroups(const char *groups);
+const char *getMqttActiveBroker();
+#ifdef MQTT_TLS_ENABLED
+bool setMqttCaCert(const char *pem, size_t length);
+#endif
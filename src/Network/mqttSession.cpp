@@ -0,0 +1,154 @@
+#include "mqttSession.h"
+#include "fingerprint.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <cstdio>
+#include <cstring>
+
+static_assert(MQTT_COMMAND_MAX_AGE < TIME_SYNC_MAX_SCHEDULE_AHEAD, "Older start times are clamped to TIME_SYNC_MAX_SCHEDULE_AHEAD");
+
+static Preferences preferences;
+static const char *subscribedTopics[MQTT_SESSION_MAX_TOPICS];
+static uint8_t subscribedCount = 0;
+static bool online = false;
+static bool offlineKnown = false;  // False until the first connection was lost, the offline time before a reboot is unknown
+static unsigned long offlineTime = 0; // millis() when the last connection was lost
+static unsigned long onlineTime = 0;  // millis() when the current connection was established
+static bool replayStale = false;      // The session was offline longer than MQTT_COMMAND_MAX_AGE
+static uint32_t staleCount = 0;
+
+// Preference key of the session on a broker
+static void getSessionKey(const char *server, char *key, size_t len)
+{
+    snprintf(key, len, "%08lX", (unsigned long)fingerprint(server, strlen(server)));
+}
+
+static bool listContains(const char *list, const char *topic)
+{
+    size_t length = strlen(topic);
+    while (*list != '\0')
+    {
+        const char *end = strchr(list, '\n');
+        if (end - list == (ptrdiff_t)length && strncmp(list, topic, length) == 0)
+        {
+            return true;
+        }
+        list = end + 1;
+    }
+    return false;
+}
+
+static bool topicsContain(const char *const *topics, uint8_t count, const char *topic, size_t length)
+{
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (strlen(topics[i]) == length && strncmp(topics[i], topic, length) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool mqttSessionSubscribe(const char *server, const char *const *topics, uint8_t count, bool resubscribe, MqttSubscriptionChange change)
+{
+    char key[9];
+    getSessionKey(server, key, sizeof(key));
+    char stored[MQTT_SESSION_LIST_SIZE] = "";
+    preferences.begin("mqtt_session", true);
+    preferences.getString(key, stored, sizeof(stored));
+    preferences.end();
+
+    count = min(count, (uint8_t)MQTT_SESSION_MAX_TOPICS);
+    subscribedCount = 0;
+    char list[MQTT_SESSION_LIST_SIZE];
+    size_t used = 0;
+    list[0] = '\0';
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if ((resubscribe || !listContains(stored, topics[i])) && !change(topics[i], true))
+        {
+            LOG_WARNING("Failed to subscribe to %s\n", topics[i]);
+            return false; // The stored topics are kept, so the next connection cleans them up
+        }
+        subscribedTopics[subscribedCount++] = topics[i];
+        used += snprintf(list + used, sizeof(list) - used, "%s\n", topics[i]);
+    }
+
+    // New topics are subscribed first, so a command moving from an old to a new topic is not missed
+    const char *line = stored;
+    while (*line != '\0')
+    {
+        const char *end = strchr(line, '\n');
+        size_t length = end - line;
+        if (!topicsContain(topics, count, line, length))
+        {
+            char topic[MQTT_TOPIC_SIZE];
+            snprintf(topic, sizeof(topic), "%.*s", (int)length, line);
+            LOG_INFO("Unsubscribing from %s, it is no longer used\n", topic);
+            if (!change(topic, false) && used + length + 1 < sizeof(list))
+            {
+                used += snprintf(list + used, sizeof(list) - used, "%s\n", topic); // Retried with the next connection
+            }
+        }
+        line = end + 1;
+    }
+
+    if (strcmp(list, stored) != 0) // Avoid rewriting the same list to flash
+    {
+        preferences.begin("mqtt_session", false);
+        preferences.putString(key, list);
+        preferences.end();
+    }
+    return true;
+}
+
+bool mqttSessionIsSubscribed(const char *topic)
+{
+    return topicsContain(subscribedTopics, subscribedCount, topic, strlen(topic));
+}
+
+void mqttSessionOnline()
+{
+    // Commands the broker queued are delivered right after CONNACK, so the offline time bounds their age
+    replayStale = !offlineKnown || millis() - offlineTime > MQTT_COMMAND_MAX_AGE;
+    onlineTime = millis();
+    online = true;
+}
+
+void mqttSessionOffline()
+{
+    if (!online)
+    {
+        return; // Failed attempts do not move the time the connection was lost
+    }
+    online = false;
+    offlineKnown = true;
+    offlineTime = millis();
+}
+
+bool mqttSessionIsStale(const LightCommand &command)
+{
+    bool stale;
+    if (command.hasStartTime)
+    {
+        stale = (int32_t)(millis() - command.startTime) > MQTT_COMMAND_MAX_AGE; // The start time gives the exact age
+    }
+    else
+    {
+        stale = replayStale && millis() - onlineTime < MQTT_REPLAY_WINDOW;
+    }
+    if (stale)
+    {
+        staleCount++;
+        LOG_WARNING("Dropping light command older than %i ms\n", MQTT_COMMAND_MAX_AGE);
+    }
+    return stale;
+}
+
+uint32_t mqttSessionGetStaleCount()
+{
+    return staleCount;
+}
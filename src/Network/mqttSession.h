@@ -0,0 +1,28 @@
+#pragma once
+#include "config.h"
+#include "mqttTopics.h"
+#include "Output/ledControl.h"
+
+#include <cstdint>
+
+#define MQTT_SESSION_MAX_TOPICS (4 + MQTT_MAX_GROUPS)                            // Device, config, broadcast and homeassistant status topics plus the groups
+#define MQTT_SESSION_LIST_SIZE (MQTT_SESSION_MAX_TOPICS * MQTT_TOPIC_SIZE + 1) // Buffer size of the newline separated topic list
+
+// The persistent broker session outlives connections and reboots, so its subscriptions are kept in NVS per broker
+// and topics from earlier settings are unsubscribed, and commands it queued while the device was offline are checked for their age
+
+// Change a subscription on the open connection, returns false if it could not be sent
+typedef bool (*MqttSubscriptionChange)(const char *topic, bool subscribe);
+
+// Subscribe to topics on the session of server and unsubscribe the topics it still holds from earlier settings
+// Topics the session already has are only subscribed again with resubscribe, for a broker that may have lost the session
+bool mqttSessionSubscribe(const char *server, const char *const *topics, uint8_t count, bool resubscribe, MqttSubscriptionChange change);
+// Returns true if the topic is one of the topics last passed to mqttSessionSubscribe
+bool mqttSessionIsSubscribed(const char *topic);
+
+// Connection state, called when CONNACK arrived and when the connection was lost or closed
+void mqttSessionOnline();
+void mqttSessionOffline();
+// Returns true if the command is older than MQTT_COMMAND_MAX_AGE and must not be applied
+bool mqttSessionIsStale(const LightCommand &command);
+uint32_t mqttSessionGetStaleCount();
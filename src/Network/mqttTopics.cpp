@@ -0,0 +1,212 @@
+#include "mqttTopics.h"
+#include "ChipID/chipID.h"
+#include "Logging/logging.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef REMOTES_ENABLED
+#include "RF/remoteRegistry.h"
+#endif
+
+const char *const MQTT_HA_STATUS_TOPIC = "homeassistant/status";
+
+static MqttTopics topics;
+static char baseTopic[MQTT_TOPIC_SIZE] = "";
+static char groupNames[MQTT_GROUP_LIST_SIZE] = "";
+
+static void buildTopic(char *topic, const char *format, const char *a, const char *b = "")
+{
+    int len = snprintf(topic, MQTT_TOPIC_SIZE, format, a, b);
+    if (len >= MQTT_TOPIC_SIZE)
+    {
+        LOG_ERROR("MQTT topic truncated: %s\n", topic);
+    }
+}
+
+#ifdef REMOTES_ENABLED
+struct RemoteTopics
+{
+    bool used;
+    uint8_t uuid[4];
+    char state[MQTT_TOPIC_SIZE];
+    char discovery[MQTT_TOPIC_SIZE];
+};
+
+static RemoteTopics remoteTopics[REMOTE_REGISTRY_MAX];
+static size_t nextRemoteTopicSlot = 0; // Fallback slot if every slot belongs to a known remote
+static RemoteTopicsReleased releasedCallback = NULL;
+
+static void releaseSlot(RemoteTopics &slot)
+{
+    if (slot.used && releasedCallback != NULL)
+    {
+        releasedCallback(slot.uuid, slot.state, slot.discovery);
+    }
+    slot.used = false;
+}
+
+// Unused slot, otherwise the slot of a remote the radio evicted
+static RemoteTopics &getFreeSlot()
+{
+    for (auto &slot : remoteTopics)
+    {
+        if (!slot.used)
+        {
+            return slot;
+        }
+    }
+    for (auto &slot : remoteTopics)
+    {
+        uint32_t id;
+        Remote remote;
+        memcpy(&id, slot.uuid, sizeof(id));
+        if (!getRemote(id, remote))
+        {
+            return slot;
+        }
+    }
+    // The radio keeps at most REMOTE_REGISTRY_MAX remotes, so this is only reached while an eviction is in flight
+    RemoteTopics &slot = remoteTopics[nextRemoteTopicSlot];
+    nextRemoteTopicSlot = (nextRemoteTopicSlot + 1) % REMOTE_REGISTRY_MAX;
+    return slot;
+}
+
+static const RemoteTopics &getRemoteTopics(const uint8_t *uuid)
+{
+    for (auto &slot : remoteTopics)
+    {
+        if (slot.used && memcmp(slot.uuid, uuid, sizeof(slot.uuid)) == 0)
+        {
+            return slot;
+        }
+    }
+
+    RemoteTopics &slot = getFreeSlot();
+    releaseSlot(slot); // Pending publishes of the previous remote must not go out on the new topics
+    char remoteName[24];
+    snprintf(remoteName, sizeof(remoteName), "RF24-Remote-%02X%02X%02X%02X", uuid[0], uuid[1], uuid[2], uuid[3]);
+    buildTopic(slot.state, "%s/%s", baseTopic, remoteName);
+    buildTopic(slot.discovery, "homeassistant/device/%s/config", remoteName);
+    memcpy(slot.uuid, uuid, sizeof(slot.uuid));
+    slot.used = true;
+    return slot;
+}
+
+const char *getMqttRemoteTopic(const uint8_t *uuid)
+{
+    return getRemoteTopics(uuid).state;
+}
+
+const char *getMqttRemoteDiscoveryTopic(const uint8_t *uuid)
+{
+    return getRemoteTopics(uuid).discovery;
+}
+
+// Release the topics of a remote that was evicted, they are built again if the remote returns
+void mqttTopicsReleaseRemote(const uint8_t *uuid)
+{
+    for (auto &slot : remoteTopics)
+    {
+        if (slot.used && memcmp(slot.uuid, uuid, sizeof(slot.uuid)) == 0)
+        {
+            releaseSlot(slot);
+        }
+    }
+}
+
+void setMqttRemoteTopicsReleasedCallback(RemoteTopicsReleased callback)
+{
+    releasedCallback = callback;
+}
+#endif
+
+// Group names become a topic level, so they must not be empty or contain separators and wildcards
+static bool isValidGroupName(const char *name, size_t length)
+{
+    if (length == 0 || length >= MQTT_GROUP_NAME_SIZE)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if (name[i] == '/' || name[i] == '+' || name[i] == '#')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void buildGroupTopics()
+{
+    topics.groupCount = 0;
+    const char *name = groupNames;
+    while (*name != '\0' && topics.groupCount < MQTT_MAX_GROUPS)
+    {
+        const char *end = strchr(name, ',');
+        size_t length = end != NULL ? end - name : strlen(name);
+        while (length > 0 && *name == ' ')
+        {
+            name++;
+            length--;
+        }
+        while (length > 0 && name[length - 1] == ' ')
+        {
+            length--;
+        }
+        if (isValidGroupName(name, length))
+        {
+            char group[MQTT_GROUP_NAME_SIZE];
+            memcpy(group, name, length);
+            group[length] = '\0';
+            buildTopic(topics.groups[topics.groupCount++], "%s/group/%s/set", baseTopic, group);
+        }
+        else if (length > 0)
+        {
+            LOG_WARNING("Invalid MQTT group name: %.*s\n", (int)length, name);
+        }
+        if (end == NULL)
+        {
+            break;
+        }
+        name = end + 1;
+    }
+}
+
+// Parse the comma separated group names into group topics
+void mqttTopicsBuildGroups(const char *groupList)
+{
+    snprintf(groupNames, sizeof(groupNames), "%s", groupList);
+    buildGroupTopics();
+}
+
+void mqttTopicsBuild(const char *base)
+{
+    strncpy(baseTopic, base, sizeof(baseTopic) - 1);
+    const char *chipID = ChipID::getChipID();
+    buildTopic(topics.device, "%s/%s", baseTopic, chipID);
+    buildTopic(topics.light, "%s/%s", topics.device, "light");
+    buildTopic(topics.diagnostic, "%s/%s", topics.device, "diagnostic");
+    buildTopic(topics.stats, "%s/%s", topics.device, "stats");
+    buildTopic(topics.status, "%s/%s", topics.device, "status");
+    buildTopic(topics.set, "%s/%s", topics.device, "set");
+    buildTopic(topics.config, "%s/%s", topics.device, "config/set");
+    buildTopic(topics.all, "%s/%s", baseTopic, "all/set");
+    buildGroupTopics();
+    buildTopic(topics.discovery, "homeassistant/device/%s/config", chipID);
+#ifdef MQTT_FLEET_TELEMETRY_ENABLED
+    buildTopic(topics.fleet, "%s/%s", topics.device, "fleet");
+#endif
+#ifdef REMOTES_ENABLED
+    for (auto &slot : remoteTopics)
+    {
+        slot.used = false; // Remote topics depend on the base topic
+    }
+#endif
+}
+
+const MqttTopics &getMqttTopics()
+{
+    return topics;
+}
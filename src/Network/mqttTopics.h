@@ -0,0 +1,45 @@
+#pragma once
+#include "config.h"
+
+#include <cstdint>
+
+#define MQTT_TOPIC_SIZE 96                                            // Buffer size of a single MQTT topic
+#define MQTT_GROUP_NAME_SIZE 24                                       // Buffer size of a group name
+#define MQTT_GROUP_LIST_SIZE (MQTT_MAX_GROUPS * MQTT_GROUP_NAME_SIZE) // Buffer size of the comma separated group names
+
+// All topics of the device, built once when the MQTT settings are loaded
+struct MqttTopics
+{
+    char device[MQTT_TOPIC_SIZE];     // <base>/<chipID>
+    char light[MQTT_TOPIC_SIZE];      // <base>/<chipID>/light
+    char diagnostic[MQTT_TOPIC_SIZE]; // <base>/<chipID>/diagnostic
+    char stats[MQTT_TOPIC_SIZE];      // <base>/<chipID>/stats
+    char status[MQTT_TOPIC_SIZE];     // <base>/<chipID>/status
+    char set[MQTT_TOPIC_SIZE];        // <base>/<chipID>/set
+    char config[MQTT_TOPIC_SIZE];     // <base>/<chipID>/config/set
+    char all[MQTT_TOPIC_SIZE];        // <base>/all/set
+    char groups[MQTT_MAX_GROUPS][MQTT_TOPIC_SIZE]; // <base>/group/<name>/set
+    uint8_t groupCount;                            // Valid entries in groups
+    char discovery[MQTT_TOPIC_SIZE];  // homeassistant/device/<chipID>/config
+#ifdef MQTT_FLEET_TELEMETRY_ENABLED
+    char fleet[MQTT_TOPIC_SIZE]; // <base>/<chipID>/fleet
+#endif
+};
+
+extern const char *const MQTT_HA_STATUS_TOPIC; // homeassistant/status
+
+void mqttTopicsBuild(const char *baseTopic);
+void mqttTopicsBuildGroups(const char *groupList);
+const MqttTopics &getMqttTopics();
+
+#ifdef REMOTES_ENABLED
+// Called with the topics of a remote right before their buffers are released or reused for another remote
+typedef void (*RemoteTopicsReleased)(const uint8_t *uuid, const char *stateTopic, const char *discoveryTopic);
+
+// Topics of a remote, built on first use and kept until the remote is released or the base topic changes
+// A slot is only reused for another remote once its remote is no longer known to the radio
+const char *getMqttRemoteTopic(const uint8_t *uuid);          // <base>/RF24-Remote-<uuid>
+const char *getMqttRemoteDiscoveryTopic(const uint8_t *uuid); // homeassistant/device/RF24-Remote-<uuid>/config
+void mqttTopicsReleaseRemote(const uint8_t *uuid);
+void setMqttRemoteTopicsReleasedCallback(RemoteTopicsReleased callback);
+#endif
@@ -6,6 +6,14 @@
 #include "Logging/logging.h"
 #include "ChipID/chipID.h"
 #include "Output/ioControl.h"
+#include "Output/ledControl.h"
+#include "Events/eventBus.h"
+#include "localApi.h"
+#include "groupControl.h"
+#include "timeSync.h"
+#include "reconnectPolicy.h"
+#include "fastConnect.h"
+#include "Logging/bootTimeline.h"
 
 #include <Arduino.h>
 #include <WiFiManager.h>
@@ -14,19 +22,32 @@
 
 char chipIdStr[32];
 bool wifiStarted = false;
-static long wifiReconnectTimer = 0;
+static ReconnectPolicy wifiReconnectPolicy("WiFi", WIFI_RECONNECT_INITIAL_DELAY, WIFI_RECONNECT_MAX_DELAY);
+static bool wifiLinkUp = false;
+static bool fastConnectPending = false; // Waiting for the connection to the cached access point
+static bool bssidLocked = false;        // The WiFi config is locked to the cached access point
+static unsigned long fastConnectTimer = 0;
 
 static WiFiManager wifiManager;
 static WiFiManagerParameter custom_device_name("deviceName", "Device Name", getDeviceName(), 40);
-static WiFiManagerParameter custom_mqtt_server("mqttServer", "MQTT Server", mqttSettings.server, 40);
-static WiFiManagerParameter custom_mqtt_port("mqttPort", "MQTT Port", String(mqttSettings.port).c_str(), 6);
+static WiFiManagerParameter custom_mqtt_server("mqttServer", "MQTT Server", mqttSettings.brokers[0].server, 40);
+static WiFiManagerParameter custom_mqtt_port("mqttPort", "MQTT Port", String(mqttSettings.brokers[0].port).c_str(), 6);
+static WiFiManagerParameter custom_mqtt_backup_brokers("mqttBackupBrokers", "MQTT Backup Brokers (host:port,host:port)", "", MQTT_BROKER_LIST_SIZE);
 static WiFiManagerParameter custom_mqtt_username("mqttUsername", "MQTT Username", mqttSettings.username, 40);
 static WiFiManagerParameter custom_mqtt_password("mqttPassword", "MQTT Password", mqttSettings.password, 40);
 static WiFiManagerParameter custom_mqtt_topic("mqttTopic", "MQTT Base Topic", mqttSettings.topic, 40);
+static WiFiManagerParameter custom_mqtt_groups("mqttGroups", "MQTT Groups (name,name)", mqttSettings.groups, MQTT_GROUP_LIST_SIZE);
 #ifdef RF24RADIO_ENABLED
 static WiFiManagerParameter customRadioChannel("radioChannel", "Radio Channel (0 -> 125)", String(getRadioChannel()).c_str(), 3);
 static WiFiManagerParameter customRadioAddress("radioAddress", "Radio Address (00:00:00:00:00)", getRadioAddressString(), sizeof("00:00:00:00:00"));
 #endif
+static WiFiManagerParameter customStaticIp("staticIp", "Static IP (empty for DHCP)", "", STATIC_IP_SIZE);
+static WiFiManagerParameter customGateway("gateway", "Gateway", "", STATIC_IP_SIZE);
+static WiFiManagerParameter customSubnet("subnet", "Subnet", "", STATIC_IP_SIZE);
+static WiFiManagerParameter customDns("dns", "DNS (empty for gateway)", "", STATIC_IP_SIZE);
+#ifdef GROUP_CONTROL_ENABLED
+static WiFiManagerParameter customGroupId("groupId", "Light Group (0 = none)", "0", 5);
+#endif
 
 const String translateWiFiStatus(wl_status_t status)
 {
@@ -58,10 +79,15 @@ const String translateWiFiStatus(wl_status_t status)
 void saveParamsCallback()
 {
     setDeviceName(custom_device_name.getValue());
-    setMqttSettings(custom_mqtt_server.getValue(), atoi(custom_mqtt_port.getValue()), custom_mqtt_username.getValue(), custom_mqtt_password.getValue(), custom_mqtt_topic.getValue());
+    setMqttGroups(custom_mqtt_groups.getValue()); // Unsubscribes removed groups before the settings reconnect
+    setMqttSettings(custom_mqtt_server.getValue(), atoi(custom_mqtt_port.getValue()), custom_mqtt_username.getValue(), custom_mqtt_password.getValue(), custom_mqtt_topic.getValue(), custom_mqtt_backup_brokers.getValue());
 #ifdef RF24RADIO_ENABLED
     setRadioSettings(atoi(customRadioChannel.getValue()), customRadioAddress.getValue());
 #endif
+#ifdef GROUP_CONTROL_ENABLED
+    setGroupId(atoi(customGroupId.getValue()));
+#endif
+    setStaticIpSettings(customStaticIp.getValue(), customGateway.getValue(), customSubnet.getValue(), customDns.getValue());
     // wifiManager.setTitle(getDeviceName());
     delay(100);
     ESP.restart(); // Restart the device to apply the new settings
@@ -70,47 +96,90 @@ void saveParamsCallback()
 void networkInit()
 {
     const char *chipID = ChipID::getChipID();
+    bootTimelineMark("Network init");
     WiFi.hostname(chipID);
-    WiFi.begin();                       // Start WiFi connection
+    WiFi.mode(WIFI_STA);
     WiFi.setTxPower(WIFI_POWER_8_5dBm); // Reduce WIFI poweer for copmpatibility with some devices
     int txPower = WiFi.getTxPower();
+    fastConnectInit(); // Load the cached access point and apply a static IP
+    if (wifiManager.getWiFiIsSaved())
+    {
+        // Skip the scan if the access point of the last connection is known
+        fastConnectPending = fastConnectBegin(wifiManager.getWiFiSSID(true).c_str(), wifiManager.getWiFiPass(true).c_str());
+        bssidLocked = fastConnectPending;
+        fastConnectTimer = millis();
+    }
+    if (!fastConnectPending)
+    {
+        WiFi.begin(); // Start WiFi connection
+    }
+    bootTimelineMark("WiFi begin");
     mqttInit(); // Initialize MQTT settings and load settings from preferences
 
     // Load MQTT settings into WifiManager
     custom_device_name.setValue(getDeviceName(), 40);
-    custom_mqtt_server.setValue(mqttSettings.server, 40);
-    custom_mqtt_port.setValue(String(mqttSettings.port).c_str(), 6);
+    custom_mqtt_server.setValue(mqttSettings.brokers[0].server, 40);
+    custom_mqtt_port.setValue(String(mqttSettings.brokers[0].port).c_str(), 6);
+    char backupBrokers[MQTT_BROKER_LIST_SIZE];
+    getMqttBackupBrokers(backupBrokers, sizeof(backupBrokers));
+    custom_mqtt_backup_brokers.setValue(backupBrokers, MQTT_BROKER_LIST_SIZE);
     custom_mqtt_username.setValue(mqttSettings.username, 40);
     custom_mqtt_password.setValue(mqttSettings.password, 40);
     custom_mqtt_topic.setValue(mqttSettings.topic, 40);
+    custom_mqtt_groups.setValue(mqttSettings.groups, MQTT_GROUP_LIST_SIZE);
 #ifdef RF24RADIO_ENABLED
     customRadioChannel.setValue(String(getRadioChannel()).c_str(), 3);
     customRadioAddress.setValue(getRadioAddressString(), sizeof("00:00:00:00:00"));
 #endif
+#ifdef GROUP_CONTROL_ENABLED
+    groupControlInit(); // Load the group from preferences
+    customGroupId.setValue(String(getGroupId()).c_str(), 5);
+#endif
+    const StaticIpSettings &staticIp = getStaticIpSettings();
+    customStaticIp.setValue(staticIp.ip, STATIC_IP_SIZE);
+    customGateway.setValue(staticIp.gateway, STATIC_IP_SIZE);
+    customSubnet.setValue(staticIp.subnet, STATIC_IP_SIZE);
+    customDns.setValue(staticIp.dns, STATIC_IP_SIZE);
 
     wifiManager.setTitle(String(getDeviceName()) + " (" + SW_VERSION + ")");
     wifiManager.addParameter(&custom_device_name);
     wifiManager.addParameter(&custom_mqtt_server);
     wifiManager.addParameter(&custom_mqtt_port);
+    wifiManager.addParameter(&custom_mqtt_backup_brokers);
     wifiManager.addParameter(&custom_mqtt_username);
     wifiManager.addParameter(&custom_mqtt_password);
     wifiManager.addParameter(&custom_mqtt_topic);
+    wifiManager.addParameter(&custom_mqtt_groups);
 #ifdef RF24RADIO_ENABLED
     wifiManager.addParameter(&customRadioChannel);
     wifiManager.addParameter(&customRadioAddress);
 #endif
+#ifdef GROUP_CONTROL_ENABLED
+    wifiManager.addParameter(&customGroupId);
+#endif
+    wifiManager.addParameter(&customStaticIp);
+    wifiManager.addParameter(&customGateway);
+    wifiManager.addParameter(&customSubnet);
+    wifiManager.addParameter(&customDns);
     wifiManager.setConnectTimeout(10);
     wifiManager.setParamsPage(true);
     wifiManager.setConfigPortalBlocking(false);
     wifiManager.setSaveParamsCallback(saveParamsCallback);
+#ifdef LOCAL_API_ENABLED
+    wifiManager.setWebServerCallback([]()
+                                     { localApiRegister(*wifiManager.server); });
+#endif
     wifiManager.setEnableConfigPortal(false);
     const char *menu[] = {"wifi", "param", "info"};
     wifiManager.setMenu(menu, 3);
     wifiManager.setClass("invert");
-    delay(1000); // Wait for WiFi to initialize
 
     // Start WiFiManager if no WiFi credentials are saved
-    if (wifiManager.getWiFiIsSaved())
+    if (fastConnectPending)
+    {
+        LOG_INFO("Connecting to cached access point\n"); // Falls back to autoConnect in handleWiFiConnection
+    }
+    else if (wifiManager.getWiFiIsSaved())
     {
         LOG_INFO("Connecting to WiFi\n");
         wifiManager.setEnableConfigPortal(false); // Disable config portal so that it doesn't start when connection fails
@@ -129,12 +198,26 @@ void handleWiFiConnection()
     if (WiFi.status() == WL_CONNECTED)
     {
         // If WiFi is connected
+        if (!wifiLinkUp)
+        {
+            wifiLinkUp = true;
+            fastConnectPending = false;
+            fastConnectSave(); // Remember the access point for the next boot
+        }
         if (!wifiStarted)
         {
             // Initial setup when WiFi connects for the first time
             LOG_INFO("Connected to %s with IP %s\n", WiFi.SSID().c_str(), WiFi.localIP().toString().c_str());
+            bootTimelineMark("WiFi connected");
             ArduinoOTA.begin();           // Start OTA updates
             wifiManager.startWebPortal(); // Start the WiFi portal
+            timeSyncBegin();              // Shared clock for scheduled light commands
+#ifdef LOCAL_API_ENABLED
+            localApiBegin();              // Start the WebSocket state stream
+#endif
+#ifdef GROUP_CONTROL_ENABLED
+            groupControlBegin();          // Join the group command multicast
+#endif
             wifiStarted = true;           // Mark WiFi as started
         }
         else if (!wifiManager.getWebPortalActive())
@@ -143,18 +226,36 @@ void handleWiFiConnection()
             LOG_INFO("Starting web portal\n");
             wifiManager.startWebPortal();
         }
+        wifiReconnectPolicy.succeeded();
         ArduinoOTA.handle(); // Handle OTA updates
     }
     else
     {
         // If WiFi is not connected
-        if (millis() - wifiReconnectTimer > WIFI_RECONNECT_ATTEMPT_INTERVAL && wifiManager.getWiFiIsSaved())
+        wifiLinkUp = false;
+        if (fastConnectPending && millis() - fastConnectTimer > WIFI_FAST_CONNECT_TIMEOUT)
+        {
+            LOG_WARNING("Cached access point not reachable, scanning\n");
+            fastConnectPending = false;
+            fastConnectFailed();
+        }
+        if (!fastConnectPending && wifiReconnectPolicy.ready() && wifiManager.getWiFiIsSaved())
         {
             // Attempt to reconnect if the reconnection interval has passed
             LOG_INFO("Attempting to reconnect to WiFi\n");
+            if (bssidLocked)
+            {
+                // Replace the config of the fast connect so autoConnect scans for the best access point
+                WiFi.disconnect();
+                WiFi.begin(wifiManager.getWiFiSSID(true).c_str(), wifiManager.getWiFiPass(true).c_str(), 0, NULL, false);
+                bssidLocked = false;
+            }
             wifiManager.setEnableConfigPortal(false); // Disable the configuration portal
             wifiManager.autoConnect(getDeviceName()); // Attempt to reconnect to WiFi
-            wifiReconnectTimer = millis();            // Reset the reconnect timer
+            if (WiFi.status() != WL_CONNECTED)
+            {
+                wifiReconnectPolicy.failed(); // Back off so a fleet does not retry in lockstep
+            }
         }
     }
 
@@ -165,7 +266,7 @@ void handleWiFiConnection()
     {
         lastTime = millis();
         LOG_INFO("---------------------WIFI-STATUS------------------\n");
-        LOG_INFO("wifiStarted: %d, getConfigPortalActive: %d wifiReconnectTimer %d, wifiManager.getWiFiIsSaved: %d\n", wifiStarted, wifiManager.getConfigPortalActive(), wifiReconnectTimer, wifiManager.getWiFiIsSaved());
+        LOG_INFO("wifiStarted: %d, getConfigPortalActive: %d wifiReconnectFailures %d, wifiManager.getWiFiIsSaved: %d\n", wifiStarted, wifiManager.getConfigPortalActive(), wifiReconnectPolicy.getFailures(), wifiManager.getWiFiIsSaved());
         LOG_INFO("WiFi status: %s\n", translateWiFiStatus(WiFi.status()).c_str());
         LOG_INFO("WiFi SSID: %s\n", WiFi.SSID().c_str());
         LOG_INFO("WiFi IP: %s\n", WiFi.localIP().toString().c_str());
@@ -174,6 +275,12 @@ void handleWiFiConnection()
 #endif
 
     wifiManager.process(); // Process WiFiManager tasks
+#ifdef LOCAL_API_ENABLED
+    localApiLoop();
+#endif
+#ifdef GROUP_CONTROL_ENABLED
+    groupControlLoop();
+#endif
 }
 
 void networkLoop()
@@ -202,6 +309,43 @@ void networkLoop()
     }
 }
 
+// Subscribe the network task to the events it handles, called in setup before any task can publish
+QueueHandle_t networkSubscribeEvents()
+{
+    return eventBusSubscribe(EVENT_MASK(EventTypes::LED_STATE_CHANGED) | EVENT_MASK(EventTypes::REMOTE_SEEN) |
+                                 EVENT_MASK(EventTypes::REMOTE_EVENT) | EVENT_MASK(EventTypes::REMOTE_EVICTED) |
+                                 EVENT_MASK(EventTypes::CONFIG_CHANGED),
+                             NETWORK_EVENT_QUEUE_LENGTH);
+}
+
+// network task, wakes up for events and polls the connections at least every NETWORK_TASK_INTERVAL
+// pvParameters is the event queue of networkSubscribeEvents
+void networkTask(void *pvParameters)
+{
+    QueueHandle_t events = (QueueHandle_t)pvParameters;
+    networkInit(); // Initialize WiFi and MQTT settings
+    for (;;)
+    {
+        Event event;
+        if (events != NULL && xQueueReceive(events, &event, pdMS_TO_TICKS(NETWORK_TASK_INTERVAL)) == pdTRUE)
+        {
+            do
+            {
+                mqttHandleEvent(event);
+#ifdef LOCAL_API_ENABLED
+                localApiHandleEvent(event);
+#endif
+            } while (xQueueReceive(events, &event, 0) == pdTRUE);
+        }
+        else if (events == NULL)
+        {
+            vTaskDelay(pdMS_TO_TICKS(NETWORK_TASK_INTERVAL));
+        }
+        networkLoop();
+        ledSettingsSaveLoop(); // Lowest priority task, so NVS writes never delay fades or remote input
+    }
+}
+
 bool getNetworkConnected()
 {
     return (WiFi.status() == WL_CONNECTED);
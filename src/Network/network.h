@@ -1,5 +1,8 @@
 #pragma once
+#include <Arduino.h>
 
 void networkInit();
 void networkLoop();
+QueueHandle_t networkSubscribeEvents();
+void networkTask(void *pvParameters);
 bool getNetworkConnected();
\ No newline at end of file
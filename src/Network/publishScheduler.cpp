@@ -0,0 +1,232 @@
+#include "publishScheduler.h"
+#include "fingerprint.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+
+PublishScheduler::PublishScheduler(PublishSender sender, uint32_t rate, uint32_t burst)
+    : sender(sender), rate(rate), burst(burst), milliTokens(burst * 1000)
+{
+}
+
+PublishSlot *PublishScheduler::getSlot(const char *topic)
+{
+    PublishSlot *freeSlot = NULL;
+    for (auto &slot : slots)
+    {
+        if (slot.topic == topic)
+        {
+            return &slot;
+        }
+        // Prefer unused slots, then the idle slot that was published longest ago
+        if (!slot.pending && (freeSlot == NULL || slot.topic == NULL ||
+                              (freeSlot->topic != NULL && slot.lastPublishTime < freeSlot->lastPublishTime)))
+        {
+            freeSlot = &slot;
+        }
+    }
+    if (freeSlot != NULL)
+    {
+        *freeSlot = PublishSlot();
+        freeSlot->topic = topic;
+    }
+    return freeSlot;
+}
+
+void PublishScheduler::schedule(const char *topic, PublishPriorities priority, PublishBuilder builder, uint32_t context, bool force)
+{
+    PublishSlot *slot = getSlot(topic);
+    if (slot == NULL)
+    {
+        stats.dropped++;
+        LOG_WARNING("No publish slot left for topic %s\n", topic);
+        return;
+    }
+    if (!slot->pending)
+    {
+        slot->pending = true;
+        slot->pendingSince = millis();
+    }
+    slot->priority = priority;
+    slot->builder = builder;
+    slot->streamer = NULL;
+    slot->context = context;
+    slot->force = slot->force || force;
+}
+
+void PublishScheduler::scheduleStream(const char *topic, PublishPriorities priority, PublishStreamer streamer, uint32_t context)
+{
+    PublishSlot *slot = getSlot(topic);
+    if (slot == NULL)
+    {
+        stats.dropped++;
+        LOG_WARNING("No publish slot left for topic %s\n", topic);
+        return;
+    }
+    if (!slot->pending)
+    {
+        slot->pending = true;
+        slot->pendingSince = millis();
+    }
+    slot->priority = priority;
+    slot->builder = NULL;
+    slot->streamer = streamer;
+    slot->context = context;
+    slot->force = true; // Streamed payloads are not fingerprinted
+}
+
+// Highest priority pending slot, the longest waiting one within a priority class
+PublishSlot *PublishScheduler::getNextSlot()
+{
+    PublishSlot *next = NULL;
+    for (auto &slot : slots)
+    {
+        if (!slot.pending)
+        {
+            continue;
+        }
+        if (next == NULL || slot.priority < next->priority ||
+            (slot.priority == next->priority && (long)(slot.pendingSince - next->pendingSince) < 0))
+        {
+            next = &slot;
+        }
+    }
+    return next;
+}
+
+void PublishScheduler::refill(unsigned long now)
+{
+    unsigned long elapsed = now - lastRefill;
+    lastRefill = now;
+    uint64_t tokens = milliTokens + (uint64_t)elapsed * rate;
+    milliTokens = min(tokens, (uint64_t)burst * 1000);
+}
+
+// Size of a QoS 0 PUBLISH packet, fixed header with remaining length, topic and payload
+static uint32_t getPacketSize(const char *topic, size_t payloadSize)
+{
+    uint32_t remaining = 2 + strlen(topic) + payloadSize;
+    uint32_t lengthBytes = 1;
+    for (uint32_t n = remaining; n >= 128; n /= 128)
+    {
+        lengthBytes++;
+    }
+    return 1 + lengthBytes + remaining;
+}
+
+// Publish a slot, returns false if the publish failed and the slot stays pending
+bool PublishScheduler::publishSlot(PublishSlot &slot, unsigned long now)
+{
+    size_t size;
+    if (slot.streamer != NULL)
+    {
+        size = slot.streamer(slot.topic, slot.context);
+        if (size == 0)
+        {
+            return false;
+        }
+    }
+    else
+    {
+        char payload[PUBLISH_SCHEDULER_PAYLOAD_SIZE];
+        size = slot.builder != NULL ? slot.builder(payload, sizeof(payload), slot.context) : 0;
+        if (size == 0)
+        {
+            slot.pending = false; // Nothing to publish anymore
+            return true;
+        }
+        uint32_t payloadFingerprint = fingerprint(payload, size);
+        if (!slot.force && slot.lastPublishTime != 0 && slot.fingerprint == payloadFingerprint &&
+            now - slot.lastPublishTime < MQTT_KEEPALIVE_INTERVAL)
+        {
+            stats.suppressed++;
+            slot.pending = false;
+            return true; // Suppressed publishes cost no token
+        }
+        if (!sender(slot.topic, reinterpret_cast<const uint8_t *>(payload), size))
+        {
+            return false;
+        }
+        slot.fingerprint = payloadFingerprint;
+    }
+    milliTokens -= 1000;
+    stats.bytes += getPacketSize(slot.topic, size);
+    slot.pending = false;
+    slot.force = false;
+    slot.lastPublishTime = max(now, 1UL); // 0 marks a slot that was never published
+    stats.sent++;
+    return true;
+}
+
+// Publish pending slots while tokens are available, returns the number of handled slots
+size_t PublishScheduler::process()
+{
+    unsigned long now = millis();
+    refill(now);
+    size_t handled = 0;
+    while (milliTokens >= 1000)
+    {
+        PublishSlot *slot = getNextSlot();
+        if (slot == NULL)
+        {
+            break;
+        }
+        if (!publishSlot(*slot, now))
+        {
+            LOG_ERROR("MQTT publish failed for topic: %s\n", slot->topic);
+            break; // Retry on the next call, the connection is likely gone
+        }
+        handled++;
+    }
+    return handled;
+}
+
+// Forget the slot of a topic including a pending publish, used when the topic buffer is reused for another topic
+void PublishScheduler::remove(const char *topic)
+{
+    for (auto &slot : slots)
+    {
+        if (slot.topic == topic)
+        {
+            slot = PublishSlot();
+        }
+    }
+}
+
+// Forget all slots, used when the topics are rebuilt
+void PublishScheduler::clear()
+{
+    for (auto &slot : slots)
+    {
+        slot = PublishSlot();
+    }
+}
+
+size_t PublishScheduler::getPendingCount()
+{
+    size_t count = 0;
+    for (auto &slot : slots)
+    {
+        count += slot.pending ? 1 : 0;
+    }
+    return count;
+}
+
+const PublishSchedulerStats &PublishScheduler::getStats()
+{
+    return stats;
+}
+
+Deadband::Deadband(int32_t band) : band(band)
+{
+}
+
+int32_t Deadband::filter(int32_t value)
+{
+    if (!valid || abs(value - reported) > band)
+    {
+        reported = value;
+        valid = true;
+    }
+    return reported;
+}
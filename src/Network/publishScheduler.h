@@ -0,0 +1,93 @@
+#pragma once
+#include "config.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#ifdef REMOTES_ENABLED
+#include "RF/remoteRegistry.h"
+#define PUBLISH_SCHEDULER_SLOTS (4 + 2 * REMOTE_REGISTRY_MAX) // Light, diagnostic, stats and discovery plus state and discovery per remote
+#else
+#define PUBLISH_SCHEDULER_SLOTS 4 // Light, diagnostic, stats and discovery
+#endif
+#define PUBLISH_SCHEDULER_PAYLOAD_SIZE 384 // Buffer size of a built payload, fits the stats payload with every counter at its maximum
+
+// Priority classes, lower values are published first
+enum class PublishPriorities : uint8_t
+{
+    STATE,
+    REMOTE,
+    DIAGNOSTIC,
+    DISCOVERY,
+};
+
+// Build the newest payload of a topic at publish time, returns the payload size or 0 if there is nothing to publish
+typedef size_t (*PublishBuilder)(char *buff, size_t len, uint32_t context);
+// Publish a payload that was built into the shared buffer, payloads may be binary
+typedef bool (*PublishSender)(const char *topic, const uint8_t *payload, size_t size);
+// Publish a payload that is streamed instead of built, for large retained payloads like discovery
+// Returns the payload size or 0 if the publish failed
+typedef size_t (*PublishStreamer)(const char *topic, uint32_t context);
+
+struct PublishSchedulerStats
+{
+    uint32_t sent = 0;       // Payloads published
+    uint32_t suppressed = 0; // Publishes skipped because the payload did not change
+    uint32_t dropped = 0;    // Schedules rejected because all slots were pending
+    uint32_t bytes = 0;      // Size of the sent PUBLISH packets including headers
+};
+
+// One slot per topic, a pending slot is published once with the newest payload no matter how often it was scheduled
+struct PublishSlot
+{
+    const char *topic = NULL; // Interned topic from the topic table
+    PublishPriorities priority = PublishPriorities::STATE;
+    PublishBuilder builder = NULL;
+    PublishStreamer streamer = NULL;
+    uint32_t context = 0;
+    bool pending = false;
+    bool force = false;               // Publish even if the payload did not change
+    unsigned long pendingSince = 0;   // millis() when the slot became pending
+    unsigned long lastPublishTime = 0; // 0 if the slot was never published
+    uint32_t fingerprint = 0;
+};
+
+// Publishes scheduled topics by priority, rate limited by a token bucket
+class PublishScheduler
+{
+    PublishSlot slots[PUBLISH_SCHEDULER_SLOTS];
+    PublishSender sender;
+    uint32_t rate;  // Tokens per second
+    uint32_t burst; // Maximum tokens
+    uint32_t milliTokens;
+    unsigned long lastRefill = 0;
+    PublishSchedulerStats stats;
+
+    PublishSlot *getSlot(const char *topic);
+    PublishSlot *getNextSlot();
+    void refill(unsigned long now);
+    bool publishSlot(PublishSlot &slot, unsigned long now);
+
+public:
+    PublishScheduler(PublishSender sender, uint32_t rate, uint32_t burst);
+    void schedule(const char *topic, PublishPriorities priority, PublishBuilder builder, uint32_t context = 0, bool force = false);
+    void scheduleStream(const char *topic, PublishPriorities priority, PublishStreamer streamer, uint32_t context = 0);
+    size_t process();
+    void remove(const char *topic);
+    void clear();
+    size_t getPendingCount();
+    const PublishSchedulerStats &getStats();
+};
+
+// Keeps reporting the same value until a reading moved more than the band away from it,
+// so noise on a measurement like the RSSI does not defeat the suppression of unchanged payloads
+class Deadband
+{
+    int32_t band;
+    int32_t reported = 0;
+    bool valid = false;
+
+public:
+    Deadband(int32_t band);
+    int32_t filter(int32_t value);
+};
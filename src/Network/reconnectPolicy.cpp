@@ -0,0 +1,80 @@
+#include "reconnectPolicy.h"
+#include "fingerprint.h"
+#include "ChipID/chipID.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <cstring>
+
+// FNV-1a barely changes its high bits for IDs that differ only in the last characters,
+// which sequential MACs do, so mix them in before the seed is scaled to a range
+static uint32_t getJitterSeed(const char *id)
+{
+    uint32_t seed = fingerprint(id, strlen(id));
+    seed ^= seed >> 16;
+    seed *= 0x85EBCA6B;
+    seed ^= seed >> 13;
+    seed *= 0xC2B2AE35;
+    seed ^= seed >> 16;
+    return seed | 1;
+}
+
+uint32_t getIdJitter(const char *id, uint32_t range)
+{
+    return (uint64_t)getJitterSeed(id) * range / UINT32_MAX;
+}
+
+uint32_t getDeviceJitter(uint32_t range)
+{
+    static uint32_t seed = 0;
+    if (seed == 0)
+    {
+        seed = getJitterSeed(ChipID::getChipID());
+    }
+    return (uint64_t)seed * range / UINT32_MAX;
+}
+
+ReconnectPolicy::ReconnectPolicy(const char *name, uint32_t initialDelay, uint32_t maxDelay)
+    : name(name), initialDelay(initialDelay), maxDelay(maxDelay)
+{
+}
+
+// Delay before the next attempt, doubled after every failure and spread over its upper half by the device jitter
+uint32_t ReconnectPolicy::getDelay()
+{
+    if (failures == 0)
+    {
+        return 0;
+    }
+    uint32_t delay = maxDelay;
+    if (failures <= 16 && (initialDelay << (failures - 1)) < maxDelay)
+    {
+        delay = initialDelay << (failures - 1);
+    }
+    return delay / 2 + getDeviceJitter(delay / 2);
+}
+
+uint8_t ReconnectPolicy::getFailures()
+{
+    return failures;
+}
+
+bool ReconnectPolicy::ready()
+{
+    return failures == 0 || millis() - failedTime >= getDelay();
+}
+
+void ReconnectPolicy::failed()
+{
+    if (failures < UINT8_MAX)
+    {
+        failures++;
+    }
+    failedTime = millis();
+    LOG_INFO("%s attempt %i failed, next attempt in %lu ms\n", name, failures, (unsigned long)getDelay());
+}
+
+void ReconnectPolicy::succeeded()
+{
+    failures = 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "config.h"
+
+#include <cstdint>
+
+// Device specific value in [0, range], the same on every call so a fleet spreads out evenly
+uint32_t getDeviceJitter(uint32_t range);
+// Jitter of the device with the given chip ID
+uint32_t getIdJitter(const char *id, uint32_t range);
+
+// Capped exponential backoff between connection attempts with per device jitter
+class ReconnectPolicy
+{
+    const char *name;
+    uint32_t initialDelay;
+    uint32_t maxDelay;
+    uint8_t failures = 0;
+    unsigned long failedTime = 0; // millis() of the last failure
+
+public:
+    ReconnectPolicy(const char *name, uint32_t initialDelay, uint32_t maxDelay);
+    bool ready();
+    void failed();
+    void succeeded();
+    uint32_t getDelay();
+    uint8_t getFailures();
+};
@@ -0,0 +1,68 @@
+#include "timeSync.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+static bool timeSyncStarted = false;
+static bool timeSynced = false;
+
+static void timeSyncCallback(struct timeval *tv)
+{
+    if (!timeSynced)
+    {
+        LOG_INFO("Time synchronized with %s\n", TIME_SYNC_SERVER);
+    }
+    timeSynced = true;
+}
+
+// Start SNTP, called once the network is connected
+void timeSyncBegin()
+{
+    if (timeSyncStarted)
+    {
+        return;
+    }
+    sntp_set_time_sync_notification_cb(timeSyncCallback);
+    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH); // Slew small corrections so running fades do not jump
+    sntp_set_sync_interval(TIME_SYNC_INTERVAL);
+    configTime(0, 0, TIME_SYNC_SERVER);
+    timeSyncStarted = true;
+    LOG_INFO("Started time sync with %s\n", TIME_SYNC_SERVER);
+}
+
+bool getTimeSynced()
+{
+    return timeSynced;
+}
+
+uint64_t getEpochMillis()
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+// Convert a Unix time in milliseconds to the matching millis() value, fails without a synchronized clock
+bool epochToLocalMillis(uint64_t epochMs, uint32_t &localMs)
+{
+    if (!timeSynced)
+    {
+        LOG_WARNING("Time not synchronized, ignoring start time\n");
+        return false;
+    }
+    uint32_t now = millis();
+    int64_t offset = (int64_t)(epochMs - getEpochMillis());
+    if (offset > TIME_SYNC_MAX_SCHEDULE_AHEAD)
+    {
+        LOG_WARNING("Start time is %lld ms ahead, ignoring it\n", offset);
+        return false;
+    }
+    if (offset < -(int64_t)TIME_SYNC_MAX_SCHEDULE_AHEAD)
+    {
+        offset = -(int64_t)TIME_SYNC_MAX_SCHEDULE_AHEAD; // Long past, only the sign matters to the LED engine
+    }
+    localMs = now + (int32_t)offset;
+    return true;
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "config.h"
+
+#include <cstdint>
+
+void timeSyncBegin();
+bool getTimeSynced();
+uint64_t getEpochMillis();
+bool epochToLocalMillis(uint64_t epochMs, uint32_t &localMs);
@@ -0,0 +1,114 @@
+#include "tlsSessionClient.h"
+
+#ifdef MQTT_TLS_ENABLED
+#include "Logging/logging.h"
+
+#include <mbedtls/ssl.h>
+#include <cstring>
+
+extern "C" int __real_mbedtls_ssl_handshake(mbedtls_ssl_context *ssl);
+
+// Linked in place of mbedtls_ssl_handshake by -Wl,--wrap, WiFiClientSecure sets up the SSL context and runs
+// the handshake in one call, so this is the only point where a session can be set in between
+extern "C" int __wrap_mbedtls_ssl_handshake(mbedtls_ssl_context *ssl)
+{
+    TlsSessionClient *client = TlsSessionClient::getHandshakeClient(ssl);
+    if (client == NULL)
+    {
+        return __real_mbedtls_ssl_handshake(ssl);
+    }
+    return client->handshake(ssl);
+}
+
+static TlsSessionClient *handshakeClient = NULL; // Client whose connect is in progress, NULL if none
+
+TlsSessionClient::TlsSessionClient()
+{
+    mbedtls_ssl_session_init(&session);
+}
+
+TlsSessionClient::~TlsSessionClient()
+{
+    mbedtls_ssl_session_free(&session);
+}
+
+int TlsSessionClient::connect(const char *host, uint16_t port, int32_t timeout)
+{
+    if (sessionValid && strcmp(host, sessionHost) != 0)
+    {
+        clearSession(); // A session can only be resumed with the server that issued it
+    }
+    sessionPending = sessionValid;
+    serverCertificate = false;
+    handshakeClient = this;
+    int result = WiFiClientSecure::connect(host, port, timeout);
+    handshakeClient = NULL;
+    resumed = result && sessionValid && !sessionPending && !serverCertificate;
+    if (!result)
+    {
+        clearSession(); // The server may have dropped the session, the next attempt runs a full handshake
+        return result;
+    }
+
+    // Replace the stored session with the one of this connection, a ticket may have been renewed
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    sessionValid = mbedtls_ssl_get_session(&sslclient->ssl_ctx, &session) == 0;
+    if (!sessionValid)
+    {
+        LOG_WARNING("TLS session of %s can not be stored for resumption\n", host);
+        return result;
+    }
+    snprintf(sessionHost, sizeof(sessionHost), "%s", host);
+    return result;
+}
+
+bool TlsSessionClient::getResumed()
+{
+    return resumed;
+}
+
+void TlsSessionClient::clearSession()
+{
+    mbedtls_ssl_session_free(&session);
+    mbedtls_ssl_session_init(&session);
+    sessionValid = false;
+    sessionHost[0] = '\0';
+}
+
+TlsSessionClient *TlsSessionClient::getHandshakeClient(mbedtls_ssl_context *ssl)
+{
+    if (handshakeClient == NULL || ssl != &handshakeClient->sslclient->ssl_ctx)
+    {
+        return NULL;
+    }
+    return handshakeClient;
+}
+
+// Runs the steps of mbedtls_ssl_handshake one by one, so the state after the ServerHello tells a full handshake,
+// which continues with the server certificate, from a resumed one, which skips it for TLS 1.2 and 1.3 alike
+// Called again by WiFiClientSecure until the handshake is over or failed
+int TlsSessionClient::handshake(mbedtls_ssl_context *ssl)
+{
+    if (sessionPending)
+    {
+        sessionPending = false; // Only set before the first step
+        int error = mbedtls_ssl_set_session(ssl, &session);
+        if (error != 0)
+        {
+            LOG_WARNING("Failed to offer the stored TLS session: -0x%04X\n", -error);
+            serverCertificate = true; // Not offered, so not resumed
+        }
+    }
+    int result = 0;
+    while (result == 0 && !mbedtls_ssl_is_handshake_over(ssl))
+    {
+        result = mbedtls_ssl_handshake_step(ssl);
+        if (ssl->MBEDTLS_PRIVATE(state) == MBEDTLS_SSL_SERVER_CERTIFICATE)
+        {
+            serverCertificate = true;
+        }
+    }
+    return result;
+}
+#endif
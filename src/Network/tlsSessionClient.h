@@ -0,0 +1,34 @@
+#pragma once
+#include "config.h"
+
+#ifdef MQTT_TLS_ENABLED
+#include <WiFiClientSecure.h>
+#include <mbedtls/ssl.h>
+
+// WiFiClientSecure that keeps the TLS session of the last connection and offers it when connecting to the same host again,
+// so a reconnect resumes the session by ID or ticket instead of running a full handshake
+// Requires -Wl,--wrap=mbedtls_ssl_handshake, set by the TLS environments in platformio.ini
+class TlsSessionClient : public WiFiClientSecure
+{
+    mbedtls_ssl_session session;
+    bool sessionValid = false;
+    bool sessionPending = false;  // The stored session is offered on the next handshake step
+    bool serverCertificate = false; // The server sent its certificate, which it skips when resuming
+    bool resumed = false;         // The last handshake resumed the stored session
+    char sessionHost[40] = "";    // Server that issued the session
+
+public:
+    TlsSessionClient();
+    ~TlsSessionClient();
+
+    using WiFiClientSecure::connect;
+    int connect(const char *host, uint16_t port, int32_t timeout);
+    bool getResumed();
+    void clearSession();
+
+    // Client whose connect owns ssl, NULL for handshakes of other connections
+    static TlsSessionClient *getHandshakeClient(mbedtls_ssl_context *ssl);
+    // Continue the handshake of this client's connect, in place of mbedtls_ssl_handshake
+    int handshake(mbedtls_ssl_context *ssl);
+};
+#endif
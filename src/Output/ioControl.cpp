@@ -81,13 +81,13 @@ void statusLedSetCode(STATUS_LED_CODES code)
 
 void ioTask(void *pvParameters)
 {
-    ledInit(); // Initialize the LED pins
-    ioInit();
+    ioInit(); // The LEDs are restored in setup
     for (;;)
     {
         ioUpdate();
+        applyLightCommands();
         ledUpdate();
         statusLedUpdate();
-        vTaskDelay(10); // Delay to allow other tasks to run
+        vTaskDelay(pdMS_TO_TICKS(getLightCommandWaitTime(IO_TASK_INTERVAL))); // Wake up early for scheduled commands
     }
 }
\ No newline at end of file
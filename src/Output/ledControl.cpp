@@ -1,11 +1,28 @@
 #include "ledControl.h"
 #include "config.h"
 #include "Logging/logging.h"
+#include "Events/eventBus.h"
+#include "Network/fingerprint.h"
+#include "Logging/bootTimeline.h"
 
 #include <Arduino.h>
 #include <Preferences.h>
+#include <cstddef>
+#include <cstring>
+
+#define RETAINED_LED_SETTINGS_MAGIC 0x4C454431 // "LED1"
+
+// Copy of the LED settings that survives software resets, plain fields so it is not initialized at startup
+struct RetainedLedSettings
+{
+    uint32_t magic;
+    bool power;
+    uint16_t values[7]; // color, brightness, red, green, blue, ww, cw
+    uint32_t checksum;
+};
 
 static Preferences preferences;
+static Preferences settingsPreferences; // Used by ledSettingsSaveLoop outside the io task
 
 static const int pins[] = {LED1_PIN, LED2_PIN, LED3_PIN, LED4_PIN, LED5_PIN};
 static const size_t numLEDs = sizeof(pins) / sizeof(pins[0]);
@@ -13,11 +30,27 @@ static bool stateChanged = false;
 static uint32_t ledcTargetValues[numLEDs] = {0};
 static uint32_t ledcCurrentValues[numLEDs] = {0};
 
-// Callback function pointer for LED state change
-static void (*ledCallback)(void) = NULL;
-
 static LEDSettings ledSettings;
 static uint32_t remainingTransitionTime = 0;
+static uint8_t ledStateSeq = 0;        // Incremented on every LED state change
+static unsigned long lastUpdateTime = 0;
+static RTC_NOINIT_ATTR RetainedLedSettings retainedLedSettings;
+
+// Commands queued since the last apply, merged until a scene store, which must capture the state up to itself
+struct PendingLightCommand
+{
+    LightCommand command;     // Latest value of every field merged into this command
+    unsigned long queuedTime; // millis() of the first command merged into this command
+};
+static PendingLightCommand pendingCommands[LIGHT_COMMAND_QUEUE_LENGTH];
+static uint8_t pendingCount = 0;
+static LightCommandStats commandStats;
+static portMUX_TYPE commandMux = portMUX_INITIALIZER_UNLOCKED;
+
+static LEDSettings unsavedSettings;     // Copy of the last applied settings that was not written to NVS yet
+static bool settingsUnsaved = false;
+static unsigned long settingsChangedTime = 0;
+static portMUX_TYPE settingsMux = portMUX_INITIALIZER_UNLOCKED;
 
 // Helper function to validate and clamp value
 static uint16_t validateLedValue(uint16_t value, const char* name)
@@ -30,11 +63,6 @@ static uint16_t validateLedValue(uint16_t value, const char* name)
     return value;
 }
 
-IRAM_ATTR void setLedCallback(void (*callback)(void))
-{
-    ledCallback = callback;
-}
-
 static void loadLedSettings()
 {
     preferences.begin("led", true);
@@ -52,20 +80,62 @@ static void loadLedSettings()
              ledSettings.power, ledSettings.brightness, ledSettings.color, ledSettings.red, ledSettings.green, ledSettings.blue, ledSettings.ww, ledSettings.cw);
 }
 
-static void saveLedSettings()
+static void saveLedSettings(const LEDSettings &settings)
 {
-    preferences.begin("led", false);
-    preferences.putBool("ledPower", ledSettings.power);
-    preferences.putUShort("ledBrightness", ledSettings.brightness);
-    preferences.putUShort("ledColor", ledSettings.color);
-    preferences.putUShort("ledRed", ledSettings.red);
-    preferences.putUShort("ledGreen", ledSettings.green);
-    preferences.putUShort("ledBlue", ledSettings.blue);
-    preferences.putUShort("ledWw", ledSettings.ww);
-    preferences.putUShort("ledCw", ledSettings.cw);
-    preferences.end();
+    settingsPreferences.begin("led", false);
+    settingsPreferences.putBool("ledPower", settings.power);
+    settingsPreferences.putUShort("ledBrightness", settings.brightness);
+    settingsPreferences.putUShort("ledColor", settings.color);
+    settingsPreferences.putUShort("ledRed", settings.red);
+    settingsPreferences.putUShort("ledGreen", settings.green);
+    settingsPreferences.putUShort("ledBlue", settings.blue);
+    settingsPreferences.putUShort("ledWw", settings.ww);
+    settingsPreferences.putUShort("ledCw", settings.cw);
+    settingsPreferences.end();
+}
+
+static void retainLedSettings()
+{
+    memset(&retainedLedSettings, 0, sizeof(retainedLedSettings)); // The checksum also covers the padding
+    retainedLedSettings.magic = RETAINED_LED_SETTINGS_MAGIC;
+    retainedLedSettings.power = ledSettings.power;
+    retainedLedSettings.values[0] = ledSettings.color;
+    retainedLedSettings.values[1] = ledSettings.brightness;
+    retainedLedSettings.values[2] = ledSettings.red;
+    retainedLedSettings.values[3] = ledSettings.green;
+    retainedLedSettings.values[4] = ledSettings.blue;
+    retainedLedSettings.values[5] = ledSettings.ww;
+    retainedLedSettings.values[6] = ledSettings.cw;
+    retainedLedSettings.checksum = fingerprint(&retainedLedSettings, offsetof(RetainedLedSettings, checksum));
 }
 
+// Restore the LED settings from RTC memory after a warm reboot, returns false if they did not survive
+static bool restoreRetainedLedSettings()
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT)
+    {
+        return false; // RTC memory lost power
+    }
+    if (retainedLedSettings.magic != RETAINED_LED_SETTINGS_MAGIC ||
+        retainedLedSettings.checksum != fingerprint(&retainedLedSettings, offsetof(RetainedLedSettings, checksum)))
+    {
+        return false;
+    }
+    ledSettings.power = retainedLedSettings.power;
+    ledSettings.color = retainedLedSettings.values[0];
+    ledSettings.brightness = retainedLedSettings.values[1];
+    ledSettings.red = retainedLedSettings.values[2];
+    ledSettings.green = retainedLedSettings.values[3];
+    ledSettings.blue = retainedLedSettings.values[4];
+    ledSettings.ww = retainedLedSettings.values[5];
+    ledSettings.cw = retainedLedSettings.values[6];
+    return true;
+}
+
+static int calculateLedTargets();
+
+// Restore the light, called first in setup so the light is on before the network starts
 void ledInit()
 {
     for (int i = 0; i < numLEDs; ++i)
@@ -77,14 +147,55 @@ void ledInit()
             ledcWrite(pins[i], 0);
         }
     }
-    loadLedSettings();
-    ledSet();
+
+    uint32_t transitionTime = 0;
+    if (restoreRetainedLedSettings())
+    {
+        LOG_INFO("Restored LED settings after reboot\n");
+    }
+    else
+    {
+        loadLedSettings();
+        switch (LED_POWER_ON_BEHAVIOR)
+        {
+        case POWER_ON_BEHAVIOR::ON:
+            ledSettings.power = true;
+            break;
+        case POWER_ON_BEHAVIOR::OFF:
+            ledSettings.power = false;
+            break;
+        case POWER_ON_BEHAVIOR::FADE_IN:
+            ledSettings.power = true;
+            transitionTime = LED_POWER_ON_FADE_TIME;
+            break;
+        case POWER_ON_BEHAVIOR::LAST:
+        default:
+            break;
+        }
+        retainLedSettings();
+    }
+
+    // The restored state is not written back to preferences
+    calculateLedTargets();
+    ledStateSeq++;
+    remainingTransitionTime = transitionTime;
+    lastUpdateTime = millis();
+    if (transitionTime == 0)
+    {
+        for (int i = 0; i < numLEDs; ++i)
+        {
+            if (pins[i] != -1)
+            {
+                ledcCurrentValues[i] = ledcTargetValues[i];
+                ledcWrite(pins[i], ledcCurrentValues[i]);
+            }
+        }
+    }
+    bootTimelineMark("LED restored");
 }
 
 void ledUpdate()
 {
-    static unsigned long lastUpdateTime = 0;
-    
     unsigned long currentTime = millis();
     uint32_t elapsedTime = currentTime - lastUpdateTime;
     
@@ -149,14 +260,13 @@ void ledUpdate()
     }
 }
 
-int ledSet(uint32_t transitionTime)
+static int calculateLedTargets()
 {
     const uint16_t divider = 65535; // max for uint16_t
     uint16_t warmWhite, coldWhite;
     uint8_t channels[] = {0, 1, 2, 3, 4};
     uint16_t colors[] = {ledSettings.red, ledSettings.green, ledSettings.blue, ledSettings.ww, ledSettings.cw};
     uint8_t channelCount;
-    remainingTransitionTime = transitionTime;
 
     switch (LED_MODE)
     {
@@ -183,15 +293,59 @@ int ledSet(uint32_t transitionTime)
         LOG_ERROR("Invalid LED mode");
         return -1;
     }
-    // Call the callback function if set
-    if (ledCallback)
+    return 0;
+}
+
+int ledSet(uint32_t transitionTime)
+{
+    remainingTransitionTime = transitionTime;
+    if (calculateLedTargets() != 0)
     {
-        ledCallback();
+        return -1;
     }
-    saveLedSettings(); // Save LED settings to preferences for restoration after reboot
+    ledStateSeq++;
+    retainLedSettings(); // Restored without NVS after a warm reboot
+
+    eventBusPublish(EventTypes::LED_STATE_CHANGED);
+
+    // NVS writes can stall for tens of milliseconds, so they are left to ledSettingsSaveLoop in a lower priority task
+    portENTER_CRITICAL(&settingsMux);
+    unsavedSettings = ledSettings;
+    settingsUnsaved = true;
+    settingsChangedTime = millis();
+    portEXIT_CRITICAL(&settingsMux);
     return 0;
 }
 
+// Write the settings to preferences for restoration after a power cycle once they did not change for LED_SETTINGS_SAVE_DELAY
+// Warm reboots restore the retained copy, so only a power loss within the delay loses the last change
+void ledSettingsSaveLoop()
+{
+    LEDSettings settings;
+    portENTER_CRITICAL(&settingsMux);
+    bool save = settingsUnsaved && millis() - settingsChangedTime >= LED_SETTINGS_SAVE_DELAY;
+    if (save)
+    {
+        settings = unsavedSettings;
+        settingsUnsaved = false;
+    }
+    portEXIT_CRITICAL(&settingsMux);
+    if (save)
+    {
+        saveLedSettings(settings);
+    }
+}
+
+LEDSettings getLedSettings()
+{
+    return ledSettings;
+}
+
+uint8_t getLedStateSeq()
+{
+    return ledStateSeq;
+}
+
 void setLedPower(bool power, uint32_t transitionTimeMs)
 {
     ledSettings.power = power;
@@ -220,22 +374,23 @@ void setLedBrightness(uint16_t brightness, uint32_t transitionTimeMs)
     ledSet(transitionTimeMs);
 }
 
-void increaseLedBrightness()
+void changeLedBrightness(int16_t delta)
 {
     if (ledSettings.power == false)
     {
-        return; // Do not increase brightness if LED is off
+        return; // Do not change brightness if LED is off
     }
-    setLedBrightness(min(ledSettings.brightness + BRIGHTNESS_STEP_SIZE, LED_MAX_VAL));
+    setLedBrightness(constrain(ledSettings.brightness + delta, MIN_BRIGHTNESS, LED_MAX_VAL));
+}
+
+void increaseLedBrightness()
+{
+    changeLedBrightness(BRIGHTNESS_STEP_SIZE);
 }
 
 void decreaseLedBrightness()
 {
-    if (ledSettings.power == false)
-    {
-        return; // Do not decrease brightness if LED is off
-    }
-    setLedBrightness(max(ledSettings.brightness - BRIGHTNESS_STEP_SIZE, MIN_BRIGHTNESS));
+    changeLedBrightness(-(BRIGHTNESS_STEP_SIZE));
 }
 
 uint16_t getLedColor()
@@ -243,6 +398,11 @@ uint16_t getLedColor()
     return ledSettings.color;
 }
 
+static uint16_t miredsToColor(uint16_t mireds)
+{
+    return (uint16_t)(0.5 + (float)(mireds - MIN_MIREDS) * LED_MAX_VAL / (MAX_MIREDS - MIN_MIREDS));
+}
+
 uint16_t getLedColorTemperature()
 {
     // Calculate color temperature in mireds
@@ -251,7 +411,7 @@ uint16_t getLedColorTemperature()
 
 void setLedColorTemperature(uint16_t mireds, uint32_t transitionTimeMs)
 {
-    setLedColor((uint16_t)(0.5 + (float)(mireds - MIN_MIREDS) * LED_MAX_VAL / (MAX_MIREDS - MIN_MIREDS)), transitionTimeMs);
+    setLedColor(miredsToColor(mireds), transitionTimeMs);
 }
 
 void setLedColor(uint16_t color, uint32_t transitionTimeMs)
@@ -260,14 +420,19 @@ void setLedColor(uint16_t color, uint32_t transitionTimeMs)
     ledSet(transitionTimeMs);
 }
 
+void changeLedColor(int16_t delta)
+{
+    setLedColor(constrain(ledSettings.color + delta, 0, LED_MAX_VAL));
+}
+
 void increaseLedColor()
 {
-    setLedColor(min(ledSettings.color + COLOR_STEP_SIZE, LED_MAX_VAL));
+    changeLedColor(COLOR_STEP_SIZE);
 }
 
 void decreaseLedColor()
 {
-    setLedColor(max(ledSettings.color - COLOR_STEP_SIZE, 0));
+    changeLedColor(-(COLOR_STEP_SIZE));
 }
 
 uint16_t getLedRed()
@@ -401,3 +566,266 @@ void setLedRgbww(uint16_t red, uint16_t green, uint16_t blue, uint16_t ww, uint1
     ledSettings.cw = validateLedValue(cw, "CW");
     ledSet(transitionTimeMs);
 }
+
+bool saveLedScene(uint8_t id)
+{
+    if (id >= LED_MAX_SCENES)
+    {
+        LOG_WARNING("Scene id %i out of range\n", id);
+        return false;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "scene%u", id);
+    preferences.begin("led_scenes", false);
+    size_t written = preferences.putBytes(key, &ledSettings, sizeof(ledSettings));
+    preferences.end();
+    LOG_INFO("Saved LED scene %i\n", id);
+    return written == sizeof(ledSettings);
+}
+
+// Read a stored scene into settings, settings is left unchanged if the scene is not stored
+static bool loadLedScene(uint8_t id, LEDSettings &settings)
+{
+    if (id >= LED_MAX_SCENES)
+    {
+        return false;
+    }
+    char key[8];
+    snprintf(key, sizeof(key), "scene%u", id);
+    LEDSettings scene;
+    preferences.begin("led_scenes", true);
+    size_t read = preferences.getBytes(key, &scene, sizeof(scene));
+    preferences.end();
+    if (read != sizeof(scene))
+    {
+        return false;
+    }
+    settings = scene;
+    return true;
+}
+
+bool recallLedScene(uint8_t id, uint32_t transitionTimeMs)
+{
+    if (id >= LED_MAX_SCENES)
+    {
+        LOG_WARNING("Scene id %i out of range\n", id);
+        return false;
+    }
+    if (!loadLedScene(id, ledSettings))
+    {
+        LOG_WARNING("LED scene %i not stored\n", id);
+        return false;
+    }
+    ledSet(transitionTimeMs);
+    return true;
+}
+
+static int16_t addDelta(int16_t a, int16_t b)
+{
+    return constrain((int32_t)a + b, INT16_MIN, INT16_MAX);
+}
+
+// Merge a command into the last pending one, later fields and the last transition win
+// Relative changes add up and are dropped by a later absolute value of the same field
+// A pending scene store is never merged into, so the scene gets the state of the commands before it
+void queueLightCommand(const LightCommand &command)
+{
+    portENTER_CRITICAL(&commandMux);
+    if (pendingCount == 0 || pendingCommands[pendingCount - 1].command.hasStoreScene)
+    {
+        if (pendingCount == LIGHT_COMMAND_QUEUE_LENGTH)
+        {
+            portEXIT_CRITICAL(&commandMux);
+            LOG_WARNING("Light command queue full, dropping command\n");
+            return;
+        }
+        pendingCommands[pendingCount].command = LightCommand();
+        pendingCommands[pendingCount].queuedTime = millis();
+        pendingCount++;
+    }
+    LightCommand &pendingCommand = pendingCommands[pendingCount - 1].command;
+    if (command.hasScene)
+    {
+        pendingCommand = LightCommand(); // The scene replaces everything merged so far
+        pendingCommand.hasScene = true;
+        pendingCommand.scene = command.scene;
+    }
+    if (command.hasPower)
+    {
+        pendingCommand.hasPower = true;
+        pendingCommand.power = command.power;
+        pendingCommand.toggle = false;
+    }
+    if (command.toggle)
+    {
+        if (pendingCommand.hasPower)
+        {
+            pendingCommand.power = !pendingCommand.power;
+        }
+        else
+        {
+            pendingCommand.toggle = !pendingCommand.toggle;
+        }
+    }
+    if (command.hasBrightness)
+    {
+        pendingCommand.hasBrightness = true;
+        pendingCommand.brightness = command.brightness;
+        pendingCommand.brightnessDelta = 0;
+    }
+    pendingCommand.brightnessDelta = addDelta(pendingCommand.brightnessDelta, command.brightnessDelta);
+    if (command.hasColorTemperature)
+    {
+        pendingCommand.hasColorTemperature = true;
+        pendingCommand.mireds = command.mireds;
+        pendingCommand.colorDelta = 0;
+    }
+    pendingCommand.colorDelta = addDelta(pendingCommand.colorDelta, command.colorDelta);
+    if (command.hasRgb)
+    {
+        pendingCommand.hasRgb = true;
+        pendingCommand.red = command.red;
+        pendingCommand.green = command.green;
+        pendingCommand.blue = command.blue;
+    }
+    if (command.hasWW)
+    {
+        pendingCommand.hasWW = true;
+        pendingCommand.ww = command.ww;
+    }
+    if (command.hasCW)
+    {
+        pendingCommand.hasCW = true;
+        pendingCommand.cw = command.cw;
+    }
+    if (command.hasStoreScene)
+    {
+        pendingCommand.hasStoreScene = true; // Later commands start a new pending command
+        pendingCommand.storeScene = command.storeScene;
+    }
+    pendingCommand.transitionTimeMs = command.transitionTimeMs;
+    pendingCommand.hasStartTime = command.hasStartTime; // The latest command decides when the merged state starts
+    pendingCommand.startTime = command.startTime;
+    commandStats.received++;
+    portEXIT_CRITICAL(&commandMux);
+}
+
+// Whether the oldest pending command is due
+static bool lightCommandReady(unsigned long now)
+{
+    if (pendingCount == 0)
+    {
+        return false;
+    }
+    const PendingLightCommand &pending = pendingCommands[0];
+    if (pending.command.hasStartTime)
+    {
+        return (int32_t)(now - pending.command.startTime) >= 0;
+    }
+    return now - pending.queuedTime >= LIGHT_COMMAND_COALESCE_TIME;
+}
+
+// Time the io task may sleep before a scheduled command has to start
+uint32_t getLightCommandWaitTime(uint32_t maxWait)
+{
+    uint32_t wait = maxWait;
+    portENTER_CRITICAL(&commandMux);
+    if (pendingCount > 0 && pendingCommands[0].command.hasStartTime)
+    {
+        int32_t remaining = (int32_t)(pendingCommands[0].command.startTime - millis());
+        wait = constrain(remaining, 1, (int32_t)maxWait);
+    }
+    portEXIT_CRITICAL(&commandMux);
+    return wait;
+}
+
+// Apply a merged command with a single ledSet and store its scene
+static void applyLightCommand(LightCommand &command, unsigned long now)
+{
+    if (command.hasScene && !loadLedScene(command.scene, ledSettings))
+    {
+        LOG_WARNING("LED scene %i not stored\n", command.scene);
+    }
+    if (command.hasPower)
+    {
+        ledSettings.power = command.power;
+    }
+    if (command.toggle)
+    {
+        ledSettings.power = !ledSettings.power;
+    }
+    if (command.hasBrightness)
+    {
+        ledSettings.brightness = validateLedValue(command.brightness, "Brightness");
+    }
+    if (command.hasColorTemperature)
+    {
+        ledSettings.color = validateLedValue(miredsToColor(constrain(command.mireds, MIN_MIREDS, MAX_MIREDS)), "Color");
+    }
+    if (command.hasRgb)
+    {
+        ledSettings.red = validateLedValue(command.red, "Red");
+        ledSettings.green = validateLedValue(command.green, "Green");
+        ledSettings.blue = validateLedValue(command.blue, "Blue");
+    }
+    if (command.hasWW)
+    {
+        ledSettings.ww = validateLedValue(command.ww, "WW");
+    }
+    if (command.hasCW)
+    {
+        ledSettings.cw = validateLedValue(command.cw, "CW");
+    }
+    if (command.brightnessDelta != 0 && ledSettings.power)
+    {
+        ledSettings.brightness = constrain(ledSettings.brightness + command.brightnessDelta, MIN_BRIGHTNESS, LED_MAX_VAL);
+    }
+    if (command.colorDelta != 0)
+    {
+        ledSettings.color = constrain(ledSettings.color + command.colorDelta, 0, LED_MAX_VAL);
+    }
+    if (command.hasStartTime)
+    {
+        // Finish at the same time as lamps that started on time
+        uint32_t late = now - command.startTime;
+        command.transitionTimeMs = late < command.transitionTimeMs ? command.transitionTimeMs - late : 0;
+    }
+    ledSet(command.transitionTimeMs);
+    if (command.hasStoreScene)
+    {
+        saveLedScene(command.storeScene);
+    }
+    commandStats.applied++;
+}
+
+// Apply the pending commands in order once their coalescing window passed or their start time is reached, called from the io task
+void applyLightCommands()
+{
+    unsigned long now = millis();
+    for (;;)
+    {
+        LightCommand command;
+        portENTER_CRITICAL(&commandMux);
+        bool ready = lightCommandReady(now);
+        if (ready)
+        {
+            command = pendingCommands[0].command;
+            pendingCount--;
+            memmove(pendingCommands, pendingCommands + 1, pendingCount * sizeof(pendingCommands[0]));
+        }
+        portEXIT_CRITICAL(&commandMux);
+        if (!ready)
+        {
+            return;
+        }
+        applyLightCommand(command, now);
+    }
+}
+
+LightCommandStats getLightCommandStats()
+{
+    portENTER_CRITICAL(&commandMux);
+    LightCommandStats stats = commandStats;
+    portEXIT_CRITICAL(&commandMux);
+    return stats;
+}
@@ -17,8 +17,50 @@ struct LEDSettings
     uint16_t cw = 0;
 };
 
+// Light command from the network or a remote, fields without their has flag are left unchanged
+// A recalled scene is applied first, then the absolute fields, then the relative changes
+struct LightCommand
+{
+    bool hasScene = false;
+    uint8_t scene = 0; // Scene recalled before the other fields are applied
+    bool hasPower = false;
+    bool power = false;
+    bool hasBrightness = false;
+    uint16_t brightness = 0;
+    bool hasColorTemperature = false;
+    uint16_t mireds = 0;
+    bool hasRgb = false;
+    uint16_t red = 0;
+    uint16_t green = 0;
+    uint16_t blue = 0;
+    bool hasWW = false;
+    uint16_t ww = 0;
+    bool hasCW = false;
+    uint16_t cw = 0;
+    uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME;
+    bool toggle = false;         // Invert the power after power was applied
+    int16_t brightnessDelta = 0; // Relative brightness change, ignored while the light is off
+    int16_t colorDelta = 0;      // Relative color change
+    bool hasStoreScene = false;
+    uint8_t storeScene = 0; // Scene the resulting state is stored in
+    bool hasStartTime = false;
+    uint32_t startTime = 0; // millis() at which the transition starts, a late start shortens the transition
+};
+
+struct LightCommandStats
+{
+    uint32_t received = 0; // Commands queued
+    uint32_t applied = 0;  // Coalesced commands handed to the LED engine
+};
+
 void ledUpdate();
-void setLedCallback(void (*callback)(void));
+void ledSettingsSaveLoop();
+void queueLightCommand(const LightCommand &command);
+void applyLightCommands();
+uint32_t getLightCommandWaitTime(uint32_t maxWait);
+LightCommandStats getLightCommandStats();
+LEDSettings getLedSettings();
+uint8_t getLedStateSeq();
 bool getLedPower();
 bool toggleLedPower();
 void setLedPower(bool power, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
@@ -26,12 +68,14 @@ void setLedPower(bool power, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME
 // Brightness
 uint16_t getLedBrightness();
 void setLedBrightness(uint16_t brightness, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
+void changeLedBrightness(int16_t delta);
 void increaseLedBrightness();
 void decreaseLedBrightness();
 
 // Color
 uint16_t getLedColor();
 void setLedColor(uint16_t color, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
+void changeLedColor(int16_t delta);
 void increaseLedColor();
 void decreaseLedColor();
 uint16_t getLedColorTemperature();
@@ -65,3 +109,8 @@ void decreaseLedCW();
 void setLedRgb(uint16_t red, uint16_t green, uint16_t blue, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
 void setLedRgbw(uint16_t red, uint16_t green, uint16_t blue, uint16_t ww, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
 void setLedRgbww(uint16_t red, uint16_t green, uint16_t blue, uint16_t ww, uint16_t cw, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
+
+// Scenes
+#define LED_MAX_SCENES 16 // Number of scenes that can be stored
+bool saveLedScene(uint8_t id);
+bool recallLedScene(uint8_t id, uint32_t transitionTimeMs = DEFAULT_TRANSITION_TIME);
\ No newline at end of file
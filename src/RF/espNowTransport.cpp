@@ -0,0 +1,140 @@
+#include "config.h"
+
+#ifdef ESPNOW_REMOTES_ENABLED
+#include "espNowTransport.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <esp_now.h>
+
+#define ESPNOW_RX_QUEUE_LENGTH 8 // Number of received frames buffered between the WiFi task and the radio task
+
+struct EspNowFrame
+{
+    uint8_t mac[ESP_NOW_ETH_ALEN];
+    int8_t rssi;
+    uint8_t size;
+    uint8_t data[REMOTE_MAX_FRAME_SIZE];
+};
+
+static const int8_t ESPNOW_STRONG_SIGNAL_RSSI = -64; // Matches the RF24 received power detector threshold
+
+static QueueHandle_t rxQueue = NULL;
+static bool espNowInitialized = false;
+static int8_t lastRssi = 0;
+static bool replyPending = false; // Set when a frame was received and the sender waits for feedback
+static uint8_t lastSender[ESP_NOW_ETH_ALEN] = {0};
+
+// Called from the WiFi task, only copies the frame into the queue
+static void espNowReceiveCallback(const esp_now_recv_info_t *info, const uint8_t *data, int len)
+{
+    if (len <= 0 || len > REMOTE_MAX_FRAME_SIZE)
+    {
+        return; // Not a remote frame
+    }
+    EspNowFrame frame;
+    memcpy(frame.mac, info->src_addr, ESP_NOW_ETH_ALEN);
+    frame.rssi = info->rx_ctrl->rssi;
+    frame.size = len;
+    memcpy(frame.data, data, len);
+    xQueueSend(rxQueue, &frame, 0);
+}
+
+#ifdef ESPNOW_REMOTES_FEEDBACK_ENABLED
+static bool addPeer(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac))
+    {
+        return true;
+    }
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, ESP_NOW_ETH_ALEN);
+    peer.channel = 0; // Use the current channel
+    peer.ifidx = WIFI_IF_STA;
+    peer.encrypt = false;
+    return esp_now_add_peer(&peer) == ESP_OK;
+}
+#endif
+
+const char *EspNowTransport::getName()
+{
+    return "ESP-NOW";
+}
+
+RemoteTransportTypes EspNowTransport::getType()
+{
+    return RemoteTransportTypes::ESPNOW;
+}
+
+bool EspNowTransport::begin()
+{
+    if (espNowInitialized)
+    {
+        return true;
+    }
+    if (WiFi.getMode() == WIFI_MODE_NULL)
+    {
+        return false; // ESP-NOW needs the WiFi driver, retried after WiFi was started
+    }
+    if (rxQueue == NULL)
+    {
+        rxQueue = xQueueCreate(ESPNOW_RX_QUEUE_LENGTH, sizeof(EspNowFrame));
+    }
+    if (esp_now_init() != ESP_OK)
+    {
+        LOG_ERROR("ESP-NOW initialization failed\n");
+        return false;
+    }
+    esp_now_register_recv_cb(espNowReceiveCallback);
+    LOG_INFO("ESP-NOW initialized!\n");
+    espNowInitialized = true;
+    return true;
+}
+
+bool EspNowTransport::receive(uint8_t *buf, uint8_t &size)
+{
+    if (!espNowInitialized)
+    {
+        return false;
+    }
+    EspNowFrame frame;
+    if (xQueueReceive(rxQueue, &frame, 0) != pdTRUE)
+    {
+        return false;
+    }
+    memcpy(lastSender, frame.mac, ESP_NOW_ETH_ALEN);
+    lastRssi = frame.rssi;
+    replyPending = true;
+    size = frame.size;
+    memcpy(buf, frame.data, size);
+    return true;
+}
+
+bool EspNowTransport::getSignalSample(bool &strong)
+{
+    strong = lastRssi >= ESPNOW_STRONG_SIGNAL_RSSI;
+    return true;
+}
+
+void EspNowTransport::setFeedback(const uint8_t *data, uint8_t size)
+{
+#ifdef ESPNOW_REMOTES_FEEDBACK_ENABLED
+    if (!replyPending)
+    {
+        return; // Only reply to remotes, never send unsolicited frames
+    }
+    replyPending = false;
+    if (!addPeer(lastSender))
+    {
+        LOG_WARNING("ESP-NOW: failed to add peer for feedback\n");
+        return;
+    }
+    if (esp_now_send(lastSender, data, size) != ESP_OK)
+    {
+        LOG_WARNING("ESP-NOW: failed to send feedback\n");
+    }
+#endif
+}
+
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+#include "config.h"
+#ifdef ESPNOW_REMOTES_ENABLED
+
+#include "remoteTransport.h"
+
+// ESP-NOW transport on the built-in WiFi radio
+// Remotes have to send on the channel of the access point the lamp is connected to.
+// State feedback is sent back to the remote as a reply to every received frame.
+class EspNowTransport : public RemoteTransport
+{
+public:
+    const char *getName() override;
+    RemoteTransportTypes getType() override;
+    bool begin() override;
+    bool receive(uint8_t *buf, uint8_t &size) override;
+    bool getSignalSample(bool &strong) override;
+    void setFeedback(const uint8_t *data, uint8_t size) override;
+};
+
+#endif
@@ -0,0 +1,46 @@
+#include "config.h"
+
+#ifdef REMOTES_ENABLED
+#include "radioMessage.h"
+
+static const uint8_t LAMP_STATE_PROTOCOL_VERSION = 0;
+static const uint8_t LAMP_STATE_FLAG_POWER = 1 << 0;
+
+static void putUint16(uint8_t *buf, uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+LampStateRadioMessage::LampStateRadioMessage(uint8_t seq, const LEDSettings &settings)
+{
+    DATA[0] = LAMP_STATE_PROTOCOL_VERSION;
+    DATA[1] = static_cast<uint8_t>(MessageTypes::LAMP_STATE);
+    DATA[2] = seq;
+    DATA[3] = settings.power ? LAMP_STATE_FLAG_POWER : 0;
+    DATA[4] = static_cast<uint8_t>(LED_MODE);
+    putUint16(DATA + 5, settings.brightness);
+    putUint16(DATA + 7, settings.color);
+    putUint16(DATA + 9, settings.red);
+    putUint16(DATA + 11, settings.green);
+    putUint16(DATA + 13, settings.blue);
+
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < SIZE - 2; i++)
+    {
+        checksum += DATA[i];
+    }
+    putUint16(DATA + SIZE - 2, checksum);
+}
+
+const uint8_t *LampStateRadioMessage::getData()
+{
+    return DATA;
+}
+
+size_t LampStateRadioMessage::getSize()
+{
+    return SIZE;
+}
+
+#endif
@@ -0,0 +1,92 @@
+#include "config.h"
+
+#ifdef REMOTES_ENABLED
+#include "linkQuality.h"
+
+void LinkQualityEstimator::addSample(bool delivered)
+{
+    int32_t sample = delivered ? 10000 : 0;
+    quality += (sample - quality) / LINK_QUALITY_SMOOTHING;
+}
+
+void LinkQualityEstimator::frameReceived(uint8_t msgNum)
+{
+    received++;
+    if (!initialized)
+    {
+        initialized = true;
+        lastMsgNum = msgNum;
+        addSample(true);
+        return;
+    }
+
+    uint8_t gap = msgNum - lastMsgNum; // Wraps around with MSG_NUM
+    lastMsgNum = msgNum;
+    if (gap == 0)
+    {
+        // The remote repeated a frame because it did not receive our ACK
+        duplicates++;
+        addSample(false);
+        return;
+    }
+    if (gap <= LINK_QUALITY_MAX_GAP)
+    {
+        for (uint8_t i = 1; i < gap; i++)
+        {
+            lost++;
+            addSample(false);
+        }
+    }
+    addSample(true);
+}
+
+void LinkQualityEstimator::checksumFailed()
+{
+    checksumFailures++;
+    addSample(false);
+}
+
+void LinkQualityEstimator::signalSampled(bool strong)
+{
+    signalSamples++;
+    if (strong)
+    {
+        strongSignalSamples++;
+    }
+}
+
+uint8_t LinkQualityEstimator::getQuality()
+{
+    return (quality + 50) / 100;
+}
+
+uint8_t LinkQualityEstimator::getStrongSignalPercentage()
+{
+    if (signalSamples == 0)
+    {
+        return 0;
+    }
+    return (strongSignalSamples * 100) / signalSamples;
+}
+
+uint32_t LinkQualityEstimator::getReceived()
+{
+    return received;
+}
+
+uint32_t LinkQualityEstimator::getLost()
+{
+    return lost;
+}
+
+uint32_t LinkQualityEstimator::getDuplicates()
+{
+    return duplicates;
+}
+
+uint32_t LinkQualityEstimator::getChecksumFailures()
+{
+    return checksumFailures;
+}
+
+#endif
@@ -0,0 +1,42 @@
+#pragma once
+#include "config.h"
+#ifdef REMOTES_ENABLED
+
+#include <cstdint>
+
+#define LINK_QUALITY_MAX_GAP 16 // Larger MSG_NUM gaps are treated as a remote restart instead of lost frames
+#define LINK_QUALITY_SMOOTHING 8 // Smoothing divisor of the link quality moving average
+
+// Link quality estimation of a single remote
+// Every expected frame is a sample: received frames count as delivered, frames missing in the
+// MSG_NUM sequence, repeated MSG_NUMs (the remote missed our ACK) and checksum failures count as lost.
+// Does not depend on the radio so it can be fed with synthetic sequences.
+class LinkQualityEstimator
+{
+private:
+    bool initialized = false;
+    uint8_t lastMsgNum = 0;
+    int32_t quality = 10000; // Moving average of delivered samples in 0.01 %
+    uint32_t received = 0;
+    uint32_t lost = 0;
+    uint32_t duplicates = 0;
+    uint32_t checksumFailures = 0;
+    uint32_t signalSamples = 0;
+    uint32_t strongSignalSamples = 0;
+
+    void addSample(bool delivered);
+
+public:
+    void frameReceived(uint8_t msgNum);
+    void checksumFailed();
+    void signalSampled(bool strong);
+
+    uint8_t getQuality();
+    uint8_t getStrongSignalPercentage();
+    uint32_t getReceived();
+    uint32_t getLost();
+    uint32_t getDuplicates();
+    uint32_t getChecksumFailures();
+};
+
+#endif
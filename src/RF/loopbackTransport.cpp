@@ -0,0 +1,65 @@
+#include "config.h"
+
+#ifdef REMOTE_LOOPBACK_ENABLED
+#include "loopbackTransport.h"
+#include "Logging/logging.h"
+
+#include <cstring>
+
+const char *LoopbackTransport::getName()
+{
+    return "Loopback";
+}
+
+RemoteTransportTypes LoopbackTransport::getType()
+{
+    return RemoteTransportTypes::LOOPBACK;
+}
+
+bool LoopbackTransport::begin()
+{
+    head = 0;
+    count = 0;
+    return true;
+}
+
+bool LoopbackTransport::inject(const uint8_t *data, uint8_t size)
+{
+    if (size > REMOTE_MAX_FRAME_SIZE || count >= LOOPBACK_QUEUE_LENGTH)
+    {
+        LOG_WARNING("Loopback transport: dropping frame of size %i\n", size);
+        return false;
+    }
+    size_t index = (head + count) % LOOPBACK_QUEUE_LENGTH;
+    memcpy(frames[index], data, size);
+    frameSizes[index] = size;
+    count++;
+    return true;
+}
+
+bool LoopbackTransport::receive(uint8_t *buf, uint8_t &size)
+{
+    if (count == 0)
+    {
+        return false;
+    }
+    size = frameSizes[head];
+    memcpy(buf, frames[head], size);
+    head = (head + 1) % LOOPBACK_QUEUE_LENGTH;
+    count--;
+    return true;
+}
+
+void LoopbackTransport::setFeedback(const uint8_t *data, uint8_t size)
+{
+    feedbackSize = size > REMOTE_MAX_FRAME_SIZE ? REMOTE_MAX_FRAME_SIZE : size;
+    memcpy(feedback, data, feedbackSize);
+}
+
+const uint8_t *LoopbackTransport::getFeedback(uint8_t &size)
+{
+    size = feedbackSize;
+    return feedback;
+}
+
+#endif
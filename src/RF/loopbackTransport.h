@@ -0,0 +1,32 @@
+#pragma once
+#include "config.h"
+#ifdef REMOTE_LOOPBACK_ENABLED
+
+#include "remoteTransport.h"
+
+#define LOOPBACK_QUEUE_LENGTH 8 // Number of frames the loopback transport can hold
+
+// In memory transport, frames injected with inject() are received like frames from a remote
+// Only built for the native unit tests, which exercise and benchmark the dispatch path without radio hardware
+class LoopbackTransport : public RemoteTransport
+{
+private:
+    uint8_t frames[LOOPBACK_QUEUE_LENGTH][REMOTE_MAX_FRAME_SIZE] = {{0}};
+    uint8_t frameSizes[LOOPBACK_QUEUE_LENGTH] = {0};
+    size_t head = 0;
+    size_t count = 0;
+    uint8_t feedback[REMOTE_MAX_FRAME_SIZE] = {0};
+    uint8_t feedbackSize = 0;
+
+public:
+    const char *getName() override;
+    RemoteTransportTypes getType() override;
+    bool begin() override;
+    bool receive(uint8_t *buf, uint8_t &size) override;
+    void setFeedback(const uint8_t *data, uint8_t size) override;
+
+    bool inject(const uint8_t *data, uint8_t size);
+    const uint8_t *getFeedback(uint8_t &size);
+};
+
+#endif
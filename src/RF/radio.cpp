@@ -1,107 +1,61 @@
 #include "config.h"
 
-#ifdef RF24RADIO_ENABLED
+#ifdef REMOTES_ENABLED
 #include "radio.h"
 #include "radioMessage.h"
+#include "remoteTransport.h"
+#include "rf24Transport.h"
+#include "espNowTransport.h"
+#include "loopbackTransport.h"
+#include "remoteRegistry.h"
 #include "Output/ledControl.h"
-#include "ChipID/chipID.h"
 #include "Logging/logging.h"
+#include "Events/eventBus.h"
 
 #include <Arduino.h>
-#include <Preferences.h>
-#include <RF24.h>
-#include <WiFi.h>
-
-static RF24 radio(PIN_RADIO_CE, PIN_RADIO_CSN);
-static Preferences preferences;
-std::unordered_map<uint32_t, Remote> seenRemotes;
-
-static bool radioInitialized = false;
-static volatile bool _radioMsgReceived = false;
-static const auto RADIO_DATARATE = RF24_250KBPS;
-static char radioAddressStr[] = "00:00:00:00:00";
-
-// Callback function pointer for New Remote Event
-static void (*radioCallback)(void) = NULL;
+#include <mutex>
 
-IRAM_ATTR void setRadioCallback(void (*callback)(void))
-{
-    radioCallback = callback;
-}
+#ifdef RF24RADIO_ENABLED
+static RF24Transport rf24Transport;
+#endif
+#ifdef ESPNOW_REMOTES_ENABLED
+static EspNowTransport espNowTransport;
+#endif
+#ifdef REMOTE_LOOPBACK_ENABLED
+static LoopbackTransport loopbackTransport;
+#endif
 
-struct RadioSettings
-{
-    uint8_t channel;
-    uint8_t radioAddress[5];
+static RemoteTransport *transports[] = {
+#ifdef RF24RADIO_ENABLED
+    &rf24Transport,
+#endif
+#ifdef ESPNOW_REMOTES_ENABLED
+    &espNowTransport,
+#endif
+#ifdef REMOTE_LOOPBACK_ENABLED
+    &loopbackTransport,
+#endif
 };
-RadioSettings radioSettings;
-
-IRAM_ATTR static void radioInterrupt()
-{
-    bool tx_ds, dx_df, rx_dr; // tx_ds = data sent, dx_df = data failed, rx_dr = data ready
-    _radioMsgReceived = true;
-}
-
-static void loadRadioSettings()
-{
-    uint8_t mac[6];
-    WiFi.macAddress(mac);
-    preferences.begin("radio_config", false);
-    radioSettings.channel = preferences.getInt("channel", 100);
-    radioSettings.radioAddress[0] = preferences.getUChar("radioAddress0", mac[1]);
-    radioSettings.radioAddress[1] = preferences.getUChar("radioAddress1", mac[2]);
-    radioSettings.radioAddress[2] = preferences.getUChar("radioAddress2", mac[3]);
-    radioSettings.radioAddress[3] = preferences.getUChar("radioAddress3", mac[4]);
-    radioSettings.radioAddress[4] = preferences.getUChar("radioAddress4", mac[5]);
-    preferences.end();
-    LOG_INFO("Loaded Radio settings: Channel: %i, Radio Address: %02X:%02X:%02X:%02X:%02X\n",
-             radioSettings.channel, radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
-}
-
-void radioInit()
-{
-    loadRadioSettings(); // Load the radio settings
-    if (!radio.begin())
-    {
-        LOG_ERROR("RF24Radio Connection Error!\n");
-        return;
-    }
-
-    pinMode(PIN_RADIO_IRQ, INPUT);
-    // let IRQ pin only trigger on "data_ready" event
-    radio.maskIRQ(true, true, false); // args = "data_sent", "data_fail", "data_ready"
-    attachInterrupt(digitalPinToInterrupt(PIN_RADIO_IRQ), radioInterrupt, FALLING);
-
-    radio.setChannel(radioSettings.channel);              // Set the channel
-    radio.setPALevel(RF24_PA_LOW);                        // Adjust power level
-    radio.setAddressWidth(5);                             // Set address width
-    radio.setCRCLength(RF24_CRC_16);                      // Set CRC length
-    radio.setRetries(5, 15);                              // Set the number of retries and delay between retries
-    radio.enableDynamicPayloads();                        // Enable dynamic payloads
-    radio.setDataRate(RADIO_DATARATE);                    // Set data rate
-    radio.openReadingPipe(1, radioSettings.radioAddress); // Open a reading pipe on address, using pipe 1 as an example
-    radio.startListening();                               // Start listening
-
-    LOG_INFO("RF24Radio initialized!\n");
-    radioInitialized = true;
-}
-
-bool radioIsInitialized()
-{
-    return radioInitialized;
-}
-
-bool nrfListen(uint8_t *buf, uint8_t &packetSize)
-{
-    if (radio.available())
-    {
-        packetSize = radio.getDynamicPayloadSize();
-        radio.read(buf, packetSize); // Read the data into the buffer
-        return true;
-    }
+static const size_t numTransports = sizeof(transports) / sizeof(transports[0]);
+static bool transportStarted[numTransports] = {false};
+static const unsigned long TRANSPORT_RETRY_INTERVAL = 1000; // Interval between attempts to start a transport in milliseconds
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_WATCHDOG_ENABLED)
+static const unsigned long RADIO_WATCHDOG_INTERVAL = 30000;        // Interval between RF24 register checks in milliseconds
+static const unsigned long RADIO_WATCHDOG_SILENCE_TIMEOUT = 600000; // Time without RF24 frames after which the radio is restarted in milliseconds
+static unsigned long lastRf24Frame = 0;                             // millis() of the last frame received over RF24
+#endif
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_ACK_PAYLOAD_ENABLED)
+static const unsigned long LINK_ADAPTION_INTERVAL = 30000; // Interval between radio power adaptions in milliseconds
+static const uint32_t LINK_ADAPTION_MIN_FRAMES = 8;        // Frames a remote needs before its link quality is considered
+static const uint8_t LINK_QUALITY_LOW = 80;                // Increase the power level below this link quality
+static const uint8_t LINK_QUALITY_HIGH = 95;               // Decrease the power level above this link quality
+#endif
 
-    return false; // No data available
-}
+// Only the radio task writes seenRemotes, other tasks read copies through getRemote and getRemoteIds
+static RemoteMap seenRemotes;
+static std::mutex seenRemotesMutex; // Held by the radio task while it changes seenRemotes and by readers in other tasks
+static uint32_t seenCounter = 0;    // Frames of known remotes, source of Remote::seenOrder
+static int feedbackSeq = -1; // LED state sequence of the current feedback frame, -1 if none was built
 
 static void logRadioPacket(uint8_t *buf, uint8_t &packetSize)
 {
@@ -113,64 +67,42 @@ static void logRadioPacket(uint8_t *buf, uint8_t &packetSize)
     LOG_DEBUG("Received packet: %s\n", packetStr);
 }
 
-static void handleRemoteRadioMessage(RadioMessageReceived &msg)
+// Remote input is queued like network commands, so only the io task changes the LED settings
+static void handleRemoteEvent(RemoteEvents event)
 {
-    RemoteRadioMessageData remoteData(msg.getData(), msg.getDataSize());
-    if (!remoteData.getValid())
-    {
-        LOG_WARNING("Skipping invalid remote message\n");
-        return;
-    }
-    remoteData.print();
-
-    // Store the remote data
-    Remote remote;
-    memcpy(remote.uuid, msg.getUUID(), sizeof(remote.uuid));
-    remote.batteryPercentage = remoteData.getBatteryPercentage();
-    remote.batteryVoltage = remoteData.getBatteryVoltage();
-    const uint32_t uuid = *((const uint32_t *)(remote.uuid));
-
-    // Check if the remote is new
-    if (seenRemotes.find(uuid) == seenRemotes.end())
-    {
-        if (radioCallback)
-        {
-            radioCallback();
-        }
-    }
-    seenRemotes[uuid] = remote;
-
-    // Handle the remote event
-    switch (remoteData.getEvent())
+    LightCommand light;
+    switch (event)
     {
     case RemoteEvents::ON:
     {
         LOG_DEBUG("Remote ON event\n");
-        setLedPower(true);
+        light.hasPower = true;
+        light.power = true;
         break;
     }
     case RemoteEvents::OFF:
     {
         LOG_DEBUG("Remote OFF event\n");
-        setLedPower(false);
+        light.hasPower = true;
+        light.power = false;
         break;
     }
     case RemoteEvents::TOGGLE:
     {
         LOG_DEBUG("Remote TOGGLE event\n");
-        toggleLedPower();
+        light.toggle = true;
         break;
     }
     case RemoteEvents::UP1:
     {
         LOG_DEBUG("Remote UP1 event\n");
-        increaseLedBrightness();
+        light.brightnessDelta = BRIGHTNESS_STEP_SIZE;
         break;
     }
     case RemoteEvents::DOWN1:
     {
         LOG_DEBUG("Remote DOWN1 event\n");
-        decreaseLedBrightness();
+        light.brightnessDelta = -(BRIGHTNESS_STEP_SIZE);
         break;
     }
     case RemoteEvents::UP2:
@@ -180,11 +112,11 @@ static void handleRemoteRadioMessage(RadioMessageReceived &msg)
         {
         case LED_MODES::CCT:
         {
-            increaseLedColor();
+            light.colorDelta = COLOR_STEP_SIZE;
             break;
         }
         default:
-            increaseLedBrightness();
+            light.brightnessDelta = BRIGHTNESS_STEP_SIZE;
         }
         break;
     }
@@ -195,31 +127,254 @@ static void handleRemoteRadioMessage(RadioMessageReceived &msg)
         {
         case LED_MODES::CCT:
         {
-            decreaseLedColor();
+            light.colorDelta = -(COLOR_STEP_SIZE);
             break;
         }
         default:
         {
-            decreaseLedBrightness();
+            light.brightnessDelta = -(BRIGHTNESS_STEP_SIZE);
         }
         }
         break;
     }
+    default:
+        return;
     }
+    queueLightCommand(light);
 }
 
-static void handleRadioPacket(uint8_t *buf, uint8_t &packetSize)
+static void handleRemoteCommand(const RemoteCommand &command)
+{
+    LightCommand light;
+    switch (command.type)
+    {
+    case RemoteCommandTypes::EVENT:
+    {
+        handleRemoteEvent(command.event);
+        return;
+    }
+    case RemoteCommandTypes::BRIGHTNESS:
+    {
+        LOG_DEBUG("Remote BRIGHTNESS command: %i\n", command.value[0]);
+        light.hasBrightness = true;
+        light.brightness = max(command.value[0], (uint16_t)MIN_BRIGHTNESS);
+        light.hasPower = true;
+        light.power = true;
+        break;
+    }
+    case RemoteCommandTypes::MIREDS:
+    {
+        LOG_DEBUG("Remote MIREDS command: %i\n", command.value[0]);
+        if (LED_MODE != LED_MODES::CCT)
+        {
+            LOG_WARNING("Remote MIREDS command not supported in LED mode %s\n", getLEDModeStr(LED_MODE));
+            return;
+        }
+        light.hasColorTemperature = true;
+        light.mireds = constrain(command.value[0], MIN_MIREDS, MAX_MIREDS);
+        break;
+    }
+    case RemoteCommandTypes::RGB:
+    {
+        LOG_DEBUG("Remote RGB command: %i %i %i\n", command.value[0], command.value[1], command.value[2]);
+        if (LED_MODE != LED_MODES::RGB && LED_MODE != LED_MODES::RGBW && LED_MODE != LED_MODES::RGBWW)
+        {
+            LOG_WARNING("Remote RGB command not supported in LED mode %s\n", getLEDModeStr(LED_MODE));
+            return;
+        }
+        light.hasRgb = true;
+        light.red = command.value[0];
+        light.green = command.value[1];
+        light.blue = command.value[2];
+        break;
+    }
+    case RemoteCommandTypes::SCENE_RECALL:
+    {
+        LOG_DEBUG("Remote SCENE_RECALL command: %i\n", command.id);
+        light.hasScene = true;
+        light.scene = command.id;
+        break;
+    }
+    case RemoteCommandTypes::SCENE_STORE:
+    {
+        LOG_DEBUG("Remote SCENE_STORE command: %i\n", command.id);
+        light.hasStoreScene = true;
+        light.storeScene = command.id;
+        break;
+    }
+    case RemoteCommandTypes::DELTA:
+    {
+        LOG_DEBUG("Remote DELTA command: target %i delta %i\n", (uint8_t)command.target, command.delta);
+        switch (command.target)
+        {
+        case RemoteDeltaTargets::BRIGHTNESS:
+            light.brightnessDelta = command.delta;
+            break;
+        case RemoteDeltaTargets::COLOR:
+            light.colorDelta = command.delta;
+            break;
+        default:
+            LOG_WARNING("Remote DELTA command with unknown target %i\n", (uint8_t)command.target);
+            return;
+        }
+        break;
+    }
+    default:
+        return;
+    }
+    queueLightCommand(light);
+}
+
+// Unix time in seconds for the remote registry, 0 while the time is not known
+static uint32_t getRemoteTimestamp()
+{
+    const time_t minValidTime = 1577836800; // 2020-01-01, earlier times mean the clock was never set
+    time_t now = time(NULL);
+    return now >= minValidTime ? now : 0;
+}
+
+// Order the restored remotes by their stored last seen time, older than every remote seen after the boot
+static void orderRestoredRemotes()
+{
+    for (auto &r : seenRemotes)
+    {
+        r.second.seenOrder = 1;
+        for (auto &other : seenRemotes)
+        {
+            if (other.second.lastSeen < r.second.lastSeen || (other.second.lastSeen == r.second.lastSeen && other.first < r.first))
+            {
+                r.second.seenOrder++;
+            }
+        }
+    }
+    seenCounter = seenRemotes.size();
+}
+
+// Remove the least recently seen remote to make room for a new one, called with seenRemotesMutex held
+// Ordered by frames instead of lastSeen, which is 0 for every remote until the time was synchronized
+// Returns false if there was no remote to remove
+static bool evictRemote(uint32_t &evicted)
+{
+    auto oldest = seenRemotes.end();
+    for (auto it = seenRemotes.begin(); it != seenRemotes.end(); ++it)
+    {
+        if (oldest == seenRemotes.end() || it->second.seenOrder < oldest->second.seenOrder)
+        {
+            oldest = it;
+        }
+    }
+    if (oldest == seenRemotes.end())
+    {
+        return false;
+    }
+    evicted = oldest->first;
+    seenRemotes.erase(oldest);
+    remoteRegistryMarkDirty();
+    LOG_INFO("Remote %08X evicted to make room for a new remote\n", evicted);
+    return true;
+}
+
+static void handleRemoteRadioMessage(RadioMessageReceived &msg, RemoteTransportTypes transport, const bool *strongSignal)
+{
+    RemoteRadioMessageData remoteData(msg.getProtocolVersion(), msg.getData(), msg.getDataSize());
+    if (!remoteData.getValid())
+    {
+        LOG_WARNING("Skipping invalid remote message\n");
+        return;
+    }
+    remoteData.print();
+
+    // Store the remote data
+    uint32_t uuid;
+    memcpy(&uuid, msg.getUUID(), sizeof(uuid)); // The UUID is not aligned within the frame
+    bool isNew;
+    bool hasEvicted = false;
+    uint32_t evicted = 0;
+    {
+        std::lock_guard<std::mutex> lock(seenRemotesMutex);
+        isNew = seenRemotes.find(uuid) == seenRemotes.end();
+        if (isNew && seenRemotes.size() >= REMOTE_REGISTRY_MAX)
+        {
+            hasEvicted = evictRemote(evicted); // The MQTT topics and the registry record are sized for REMOTE_REGISTRY_MAX remotes
+        }
+        Remote &remote = seenRemotes[uuid];
+        bool changed = isNew || remote.batteryPercentage != remoteData.getBatteryPercentage() || remote.transport != transport;
+        memcpy(remote.uuid, msg.getUUID(), sizeof(remote.uuid));
+        remote.batteryPercentage = remoteData.getBatteryPercentage();
+        remote.batteryVoltage = remoteData.getBatteryVoltage();
+        remote.transport = transport;
+        remote.lastSeen = getRemoteTimestamp();
+        remote.seenOrder = ++seenCounter;
+        if (isNew)
+        {
+            remote.firstSeen = remote.lastSeen;
+        }
+        if (changed)
+        {
+            remoteRegistryMarkDirty(); // Last seen alone is only stored together with other changes
+        }
+        remote.link.frameReceived(msg.getMsgNum());
+        if (strongSignal)
+        {
+            remote.link.signalSampled(*strongSignal);
+        }
+    }
+
+    Event event = {};
+    event.timestamp = micros();
+    if (hasEvicted)
+    {
+        event.type = EventTypes::REMOTE_EVICTED;
+        memcpy(event.remote.uuid, &evicted, sizeof(event.remote.uuid));
+        eventBusPublish(event);
+    }
+    memcpy(event.remote.uuid, msg.getUUID(), sizeof(event.remote.uuid));
+    if (isNew)
+    {
+        event.type = EventTypes::REMOTE_SEEN;
+        eventBusPublish(event);
+    }
+
+    // Handle the remote commands in order
+    for (size_t i = 0; i < remoteData.getCommandCount(); i++)
+    {
+        const RemoteCommand &command = remoteData.getCommand(i);
+        handleRemoteCommand(command);
+        if (command.type == RemoteCommandTypes::EVENT)
+        {
+            event.type = EventTypes::REMOTE_EVENT;
+            event.remote.event = (uint8_t)command.event;
+            eventBusPublish(event);
+        }
+    }
+}
+
+static void handleRadioPacket(uint8_t *buf, uint8_t &packetSize, RemoteTransportTypes transport, const bool *strongSignal)
 {
     // Handle the received packet
     // logRadioPacket(buf, packetSize);
     RadioMessageReceived radioMessage(buf, packetSize);
     // radioMessage.print();
+    if (!radioMessage.getValid())
+    {
+        // Account the failure to the remote if the UUID still matches a known one
+        uint32_t uuid;
+        memcpy(&uuid, radioMessage.getUUID(), sizeof(uuid));
+        std::lock_guard<std::mutex> lock(seenRemotesMutex);
+        auto remote = seenRemotes.find(uuid);
+        if (remote != seenRemotes.end())
+        {
+            remote->second.link.checksumFailed();
+        }
+        LOG_WARNING("Skipping radio packet with invalid checksum\n");
+        return;
+    }
     MessageTypes msgType = radioMessage.getMsgType();
     switch (msgType)
     {
     case MessageTypes::REMOTE:
     {
-        handleRemoteRadioMessage(radioMessage);
+        handleRemoteRadioMessage(radioMessage, transport, strongSignal);
         break;
     }
     default:
@@ -230,82 +385,197 @@ static void handleRadioPacket(uint8_t *buf, uint8_t &packetSize)
     }
 }
 
-void radioLoop()
+static void updateFeedback(RemoteTransport *transport)
 {
-    uint8_t buf[32];
-    uint8_t packetSize = 0;
-    if (radioInitialized)
+    uint8_t seq = getLedStateSeq();
+    LampStateRadioMessage stateMessage(seq, getLedSettings());
+    transport->setFeedback(stateMessage.getData(), stateMessage.getSize());
+}
+
+static void startTransports()
+{
+    static unsigned long lastAttempt = 0;
+    if (lastAttempt != 0 && millis() - lastAttempt < TRANSPORT_RETRY_INTERVAL)
     {
-        if (_radioMsgReceived)
+        return;
+    }
+    lastAttempt = millis();
+    for (size_t i = 0; i < numTransports; i++)
+    {
+        if (!transportStarted[i])
         {
-            _radioMsgReceived = false;
-            while (nrfListen(buf, packetSize))
+            transportStarted[i] = transports[i]->begin();
+            if (transportStarted[i])
             {
-                handleRadioPacket(buf, packetSize);
+                updateFeedback(transports[i]);
             }
         }
     }
 }
 
-char *getRadioAddressString()
+void radioLoop()
+{
+    uint8_t buf[REMOTE_MAX_FRAME_SIZE];
+    uint8_t packetSize = 0;
+    startTransports();
+
+    uint8_t seq = getLedStateSeq();
+    bool stateChanged = feedbackSeq != seq;
+    feedbackSeq = seq;
+    for (size_t i = 0; i < numTransports; i++)
+    {
+        if (!transportStarted[i])
+        {
+            continue;
+        }
+        bool received = false;
+        while (transports[i]->receive(buf, packetSize))
+        {
+            bool strongSignal;
+            bool hasSignalSample = transports[i]->getSignalSample(strongSignal);
+            handleRadioPacket(buf, packetSize, transports[i]->getType(), hasSignalSample ? &strongSignal : NULL);
+            received = true;
+        }
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_WATCHDOG_ENABLED)
+        if (received && transports[i] == &rf24Transport)
+        {
+            lastRf24Frame = millis();
+        }
+#endif
+
+        // Received frames consume the feedback, so it is refreshed after every reception
+        if (received || stateChanged)
+        {
+            updateFeedback(transports[i]);
+        }
+    }
+}
+
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_ACK_PAYLOAD_ENABLED)
+// Adapt the PA level used for ACK payloads to the weakest remote
+static void adaptRadioPowerLevel()
+{
+    static unsigned long lastAdaption = 0;
+    if (millis() - lastAdaption < LINK_ADAPTION_INTERVAL)
+    {
+        return;
+    }
+    lastAdaption = millis();
+
+    int weakestQuality = -1;
+    for (auto &r : seenRemotes) // Read by the writing task, no lock needed
+    {
+        if (r.second.link.getReceived() < LINK_ADAPTION_MIN_FRAMES)
+        {
+            continue; // Not enough samples for a reliable estimate
+        }
+        if (weakestQuality < 0 || r.second.link.getQuality() < weakestQuality)
+        {
+            weakestQuality = r.second.link.getQuality();
+        }
+    }
+    if (weakestQuality < 0)
+    {
+        return;
+    }
+
+    if (weakestQuality < LINK_QUALITY_LOW && changeRadioPowerLevel(1))
+    {
+        LOG_INFO("Weakest remote link quality %i%%, increased radio power level\n", weakestQuality);
+    }
+    else if (weakestQuality > LINK_QUALITY_HIGH && changeRadioPowerLevel(-1))
+    {
+        LOG_INFO("Weakest remote link quality %i%%, decreased radio power level\n", weakestQuality);
+    }
+}
+#endif
+
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_WATCHDOG_ENABLED)
+// RF24 Radio can become unresponsive after a while, so it is restarted if its registers no longer
+// read back as configured or no frame was received for a long time
+static void radioWatchdog()
 {
-    // return radio address in format "XX:XX:XX:XX:XX"
-    sprintf(radioAddressStr, "%02X:%02X:%02X:%02X:%02X", radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
-    return radioAddressStr;
+    static unsigned long lastCheck = 0;
+    if (millis() - lastCheck < RADIO_WATCHDOG_INTERVAL)
+    {
+        return;
+    }
+    lastCheck = millis();
+
+    if (!rf24Transport.isResponsive())
+    {
+        LOG_WARNING("Radio watchdog: register readback failed, restarting radio\n");
+    }
+    else if (millis() - lastRf24Frame > RADIO_WATCHDOG_SILENCE_TIMEOUT)
+    {
+        LOG_INFO("Radio watchdog: no frames for %lu s, restarting radio\n", RADIO_WATCHDOG_SILENCE_TIMEOUT / 1000);
+    }
+    else
+    {
+        return;
+    }
+    rf24Transport.begin();
+    lastRf24Frame = millis();
 }
+#endif
 
-uint8_t getRadioChannel()
+bool getRemote(uint32_t id, Remote &remote)
 {
-    return radioSettings.channel;
+    std::lock_guard<std::mutex> lock(seenRemotesMutex);
+    auto it = seenRemotes.find(id);
+    if (it == seenRemotes.end())
+    {
+        return false;
+    }
+    remote = it->second;
+    return true;
 }
 
-void setRadioSettings(uint8_t channel, const char *radioAddress)
+#ifdef REMOTE_LOOPBACK_ENABLED
+LoopbackTransport &getLoopbackTransport()
 {
-    radioSettings.channel = channel;
-    sscanf(radioAddress, "%02X:%02X:%02X:%02X:%02X", &radioSettings.radioAddress[0], &radioSettings.radioAddress[1], &radioSettings.radioAddress[2], &radioSettings.radioAddress[3], &radioSettings.radioAddress[4]);
-    LOG_INFO("Radio settings updated: Channel: %i, Radio Address: %02X:%02X:%02X:%02X:%02X\n",
-             radioSettings.channel, radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
-
-    // Save the radio settings
-    preferences.begin("radio_config", false);
-    preferences.putInt("channel", radioSettings.channel);
-    preferences.putUChar("radioAddress0", radioSettings.radioAddress[0]);
-    preferences.putUChar("radioAddress1", radioSettings.radioAddress[1]);
-    preferences.putUChar("radioAddress2", radioSettings.radioAddress[2]);
-    preferences.putUChar("radioAddress3", radioSettings.radioAddress[3]);
-    preferences.putUChar("radioAddress4", radioSettings.radioAddress[4]);
-    preferences.end();
-
-    // Restart the radio
-    radio.stopListening();
-    delay(100);
-    radioInit();
+    return loopbackTransport;
 }
+#endif
 
-RemoteMap &getRemoteMap()
+size_t getRemoteIds(uint32_t *ids, size_t maxIds)
 {
-    return seenRemotes;
+    std::lock_guard<std::mutex> lock(seenRemotesMutex);
+    size_t count = 0;
+    for (auto &r : seenRemotes)
+    {
+        if (count >= maxIds)
+        {
+            break;
+        }
+        ids[count++] = r.first;
+    }
+    return count;
 }
 
 // radio task
 void radioTask(void *pvParameters)
 {
-    radioInit(); // Initialize the RF radio
-    unsigned long radioWatchdogTimer = millis();
+    {
+        std::lock_guard<std::mutex> lock(seenRemotesMutex);
+        remoteRegistryLoad(seenRemotes); // Restore known remotes before any frame is received
+        orderRestoredRemotes();
+    }
+    startTransports();               // Initialize the remote transports
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_WATCHDOG_ENABLED)
+    lastRf24Frame = millis();
+#endif
     for (;;)
     {
         radioLoop();
+        remoteRegistryLoop(seenRemotes);
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_ACK_PAYLOAD_ENABLED)
+        adaptRadioPowerLevel();
+#endif
 
-        #ifdef RF24RADIO_WATCHDOG_ENABLED
-        // RF24 Radio can become unresponsive after a while, so we need to reset it
-        // Watchdog triggers every 30 seconds after the last received message
-        if (millis() - radioWatchdogTimer > 30000)
-        {
-            LOG_INFO("Radio watchdog\n");
-            radioInit();
-            radioWatchdogTimer = millis();
-        }
-        #endif
+#if defined(RF24RADIO_ENABLED) && defined(RF24RADIO_WATCHDOG_ENABLED)
+        radioWatchdog();
+#endif
 
         vTaskDelay(10); // Delay to allow other tasks to run
     }
@@ -1,7 +1,12 @@
 #pragma once
 #include "config.h"
-#ifdef RF24RADIO_ENABLED
+#ifdef REMOTES_ENABLED
+
+#include "linkQuality.h"
+#include "loopbackTransport.h"
+#include "remoteTransport.h"
 
+#include <cstddef>
 #include <cstdint>
 #include <unordered_map>
 
@@ -10,15 +15,32 @@ struct Remote
     uint8_t uuid[4];
     uint8_t batteryPercentage;
     uint16_t batteryVoltage;
+    RemoteTransportTypes transport;
+    uint32_t firstSeen; // Unix time in seconds, 0 if the time was unknown
+    uint32_t lastSeen;  // Unix time in seconds, 0 if the time was unknown
+    uint32_t seenOrder; // Frame counter of the radio task at the last frame, orders eviction without a valid clock
+    LinkQualityEstimator link;
 };
 
 using RemoteMap = std::unordered_map<uint32_t, Remote>;
 
+// Copy a known remote into remote, returns false if the remote was never seen. Safe to call from any task
+bool getRemote(uint32_t id, Remote &remote);
+// Copy the IDs of up to maxIds known remotes into ids, returns their number. Safe to call from any task
+size_t getRemoteIds(uint32_t *ids, size_t maxIds);
+// Receive and dispatch the pending frames of all transports, called by radioTask
+void radioLoop();
+void radioTask(void *pvParameters);
+
+#ifdef REMOTE_LOOPBACK_ENABLED
+// Loopback transport of the radio task, tests inject frames into it and read the feedback
+LoopbackTransport &getLoopbackTransport();
+#endif
+
+#ifdef RF24RADIO_ENABLED
 void setRadioSettings(uint8_t channel, const char *radioAddress);
 bool radioIsInitialized();
 char* getRadioAddressString();
 uint8_t getRadioChannel(); 
-RemoteMap& getRemoteMap();
-void setRadioCallback(void (*callback)(void));
-void radioTask(void *pvParameters);
+#endif
 #endif
\ No newline at end of file
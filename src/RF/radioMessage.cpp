@@ -1,5 +1,5 @@
 #include "config.h"
-#ifdef RF24RADIO_ENABLED
+#ifdef REMOTES_ENABLED
 
 #include "radioMessage.h"
 #include "Logging/logging.h"
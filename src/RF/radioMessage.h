@@ -1,6 +1,8 @@
 #pragma once
 #include "config.h"
-#ifdef RF24RADIO_ENABLED
+#ifdef REMOTES_ENABLED
+
+#include "Output/ledControl.h"
 
 #include <Arduino.h>
 
@@ -8,6 +10,7 @@ enum class MessageTypes : uint8_t
 {
     EMPTY,
     REMOTE,
+    LAMP_STATE,
 };
 
 enum class RemoteEvents : uint8_t
@@ -22,6 +25,56 @@ enum class RemoteEvents : uint8_t
     DOWN2,
 };
 
+// Remote protocol versions, selected by the PROTOCOL_VERSION byte of a frame
+//
+// v0: REMOTE data is exactly 4 bytes carrying one relative event
+//     Byte 0      EVENT (RemoteEvents)
+//     Byte 1      BATTERY_PERCENTAGE (0 -> 255)
+//     Byte 2-3    BATTERY_VOLTAGE_MV
+//
+// v1: REMOTE data carries multiple TLV encoded commands
+//     Byte 0      BATTERY_PERCENTAGE (0 -> 255)
+//     Byte 1-2    BATTERY_VOLTAGE_MV
+//     Byte 3-n    Commands, each TYPE (RemoteCommandTypes), LEN, VALUE[LEN]
+//
+// All multi byte values are little endian. Unknown command types are skipped
+// using their LEN so older lamps keep working with newer remotes.
+enum class RemoteProtocolVersions : uint8_t
+{
+    V0,
+    V1,
+};
+
+enum class RemoteCommandTypes : uint8_t
+{
+    EMPTY,
+    EVENT,        // LEN 1: RemoteEvents
+    BRIGHTNESS,   // LEN 2: absolute brightness 0 -> LED_MAX_VAL, turns the lamp on
+    MIREDS,       // LEN 2: absolute color temperature MIN_MIREDS -> MAX_MIREDS
+    RGB,          // LEN 6: absolute red, green, blue 0 -> LED_MAX_VAL
+    SCENE_RECALL, // LEN 1: scene id
+    SCENE_STORE,  // LEN 1: scene id
+    DELTA,        // LEN 3: RemoteDeltaTargets, signed delta
+};
+
+enum class RemoteDeltaTargets : uint8_t
+{
+    BRIGHTNESS,
+    COLOR,
+};
+
+#define REMOTE_MAX_COMMANDS 8 // Maximum number of commands in one remote frame
+
+struct RemoteCommand
+{
+    RemoteCommandTypes type = RemoteCommandTypes::EMPTY;
+    RemoteEvents event = RemoteEvents::EMPTY;                   // EVENT
+    uint16_t value[3] = {0};                                    // BRIGHTNESS, MIREDS, RGB
+    uint8_t id = 0;                                             // SCENE_RECALL, SCENE_STORE
+    RemoteDeltaTargets target = RemoteDeltaTargets::BRIGHTNESS; // DELTA
+    int16_t delta = 0;                                          // DELTA
+};
+
 class RadioMessageReceived
 {
 protected:
@@ -50,18 +103,57 @@ public:
 class RemoteRadioMessageData
 {
 private:
-    RemoteEvents EVENT = RemoteEvents::EMPTY;
+    RemoteCommand COMMANDS[REMOTE_MAX_COMMANDS];
+    size_t commandCount = 0;
     uint8_t BATTERY_PERCENTAGE = 0;
     uint16_t BATTERY_VOLTAGE_MV = 0;
     bool valid = false;
 
+    void decodeV0(const uint8_t *data, size_t size);
+    void decodeV1(const uint8_t *data, size_t size);
+
 public:
-    RemoteRadioMessageData(uint8_t *data, size_t size);
-    RemoteEvents getEvent();
+    RemoteRadioMessageData(uint8_t protocolVersion, const uint8_t *data, size_t size);
+    size_t getCommandCount();
+    const RemoteCommand &getCommand(size_t index);
     uint8_t getBatteryPercentage();
     uint16_t getBatteryVoltage();
     bool getValid();
     void print();
 };
 
+// Encode v1 REMOTE data, returns the number of bytes written or 0 if the commands do not fit
+size_t encodeRemoteRadioMessageData(uint8_t *buf, size_t size, uint8_t batteryPercentage, uint16_t batteryVoltage,
+                                    const RemoteCommand *commands, size_t count);
+
+// Lamp state frame, preloaded as ACK payload on the remote pipe.
+// Every frame a remote sends is acknowledged with the current frame, so the
+// state reflects the lamp before the acknowledged frame was applied.
+// All multi byte values are little endian.
+//
+// Byte  0      PROTOCOL_VERSION
+// Byte  1      MSG_TYPE    (MessageTypes::LAMP_STATE)
+// Byte  2      SEQ         Incremented on every LED state change
+// Byte  3      FLAGS       Bit 0: power
+// Byte  4      LED_MODE    LED_MODES value of the lamp
+// Byte  5-6    BRIGHTNESS  0 -> LED_MAX_VAL
+// Byte  7-8    COLOR       0 -> LED_MAX_VAL (CCT: 0 = MIN_MIREDS, LED_MAX_VAL = MAX_MIREDS)
+// Byte  9-10   RED         0 -> LED_MAX_VAL
+// Byte 11-12   GREEN       0 -> LED_MAX_VAL
+// Byte 13-14   BLUE        0 -> LED_MAX_VAL
+// Byte 15-16   CHECKSUM    Sum of bytes 0 -> 14
+class LampStateRadioMessage
+{
+public:
+    static const size_t SIZE = 17;
+
+private:
+    uint8_t DATA[SIZE] = {0};
+
+public:
+    LampStateRadioMessage(uint8_t seq, const LEDSettings &settings);
+    const uint8_t *getData();
+    size_t getSize();
+};
+
 #endif
\ No newline at end of file
@@ -1,10 +1,60 @@
 #include "config.h"
 
-#ifdef RF24RADIO_ENABLED
+#ifdef REMOTES_ENABLED
 #include "radioMessage.h"
 #include "Logging/logging.h"
 
-RemoteRadioMessageData::RemoteRadioMessageData(uint8_t *data, size_t size)
+static const size_t REMOTE_V1_HEADER_SIZE = 3; // Battery percentage and voltage
+
+static uint16_t getUint16(const uint8_t *buf)
+{
+    return (buf[1] << 8) | buf[0];
+}
+
+static void putUint16(uint8_t *buf, uint16_t value)
+{
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+// Value length of a command type, 0 for unknown types
+static uint8_t getRemoteCommandLength(RemoteCommandTypes type)
+{
+    switch (type)
+    {
+    case RemoteCommandTypes::EVENT:
+    case RemoteCommandTypes::SCENE_RECALL:
+    case RemoteCommandTypes::SCENE_STORE:
+        return 1;
+    case RemoteCommandTypes::BRIGHTNESS:
+    case RemoteCommandTypes::MIREDS:
+        return 2;
+    case RemoteCommandTypes::DELTA:
+        return 3;
+    case RemoteCommandTypes::RGB:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+RemoteRadioMessageData::RemoteRadioMessageData(uint8_t protocolVersion, const uint8_t *data, size_t size)
+{
+    switch (static_cast<RemoteProtocolVersions>(protocolVersion))
+    {
+    case RemoteProtocolVersions::V0:
+        decodeV0(data, size);
+        break;
+    case RemoteProtocolVersions::V1:
+        decodeV1(data, size);
+        break;
+    default:
+        LOG_WARNING("RemoteRadioMessageData: unsupported protocol version: %i\n", protocolVersion);
+        break;
+    }
+}
+
+void RemoteRadioMessageData::decodeV0(const uint8_t *data, size_t size)
 {
     if (size != 4)
     {
@@ -12,14 +62,149 @@ RemoteRadioMessageData::RemoteRadioMessageData(uint8_t *data, size_t size)
         return;
     }
     valid = true;
-    EVENT = static_cast<RemoteEvents>(data[0]);
+    COMMANDS[0].type = RemoteCommandTypes::EVENT;
+    COMMANDS[0].event = static_cast<RemoteEvents>(data[0]);
+    commandCount = 1;
     BATTERY_PERCENTAGE = data[1];
-    BATTERY_VOLTAGE_MV = (data[3] << 8) | data[2];
+    BATTERY_VOLTAGE_MV = getUint16(data + 2);
+}
+
+void RemoteRadioMessageData::decodeV1(const uint8_t *data, size_t size)
+{
+    if (size < REMOTE_V1_HEADER_SIZE)
+    {
+        LOG_WARNING("RemoteRadioMessageData: size too small: %i\n", size);
+        return;
+    }
+    BATTERY_PERCENTAGE = data[0];
+    BATTERY_VOLTAGE_MV = getUint16(data + 1);
+
+    size_t offset = REMOTE_V1_HEADER_SIZE;
+    while (offset < size)
+    {
+        if (size - offset < 2)
+        {
+            LOG_WARNING("RemoteRadioMessageData: truncated command header at %i\n", offset);
+            return;
+        }
+        RemoteCommandTypes type = static_cast<RemoteCommandTypes>(data[offset]);
+        uint8_t length = data[offset + 1];
+        const uint8_t *value = data + offset + 2;
+        offset += 2 + length;
+        if (offset > size)
+        {
+            LOG_WARNING("RemoteRadioMessageData: truncated command value for type %i\n", (uint8_t)type);
+            return;
+        }
+
+        uint8_t expectedLength = getRemoteCommandLength(type);
+        if (expectedLength == 0)
+        {
+            LOG_DEBUG("RemoteRadioMessageData: skipping unknown command type %i\n", (uint8_t)type);
+            continue;
+        }
+        if (length != expectedLength)
+        {
+            LOG_WARNING("RemoteRadioMessageData: length %i invalid for command type %i\n", length, (uint8_t)type);
+            return;
+        }
+        if (commandCount >= REMOTE_MAX_COMMANDS)
+        {
+            LOG_WARNING("RemoteRadioMessageData: too many commands, ignoring the rest\n");
+            break;
+        }
+
+        RemoteCommand &command = COMMANDS[commandCount++];
+        command.type = type;
+        switch (type)
+        {
+        case RemoteCommandTypes::EVENT:
+            command.event = static_cast<RemoteEvents>(value[0]);
+            break;
+        case RemoteCommandTypes::BRIGHTNESS:
+        case RemoteCommandTypes::MIREDS:
+            command.value[0] = getUint16(value);
+            break;
+        case RemoteCommandTypes::RGB:
+            command.value[0] = getUint16(value);
+            command.value[1] = getUint16(value + 2);
+            command.value[2] = getUint16(value + 4);
+            break;
+        case RemoteCommandTypes::SCENE_RECALL:
+        case RemoteCommandTypes::SCENE_STORE:
+            command.id = value[0];
+            break;
+        case RemoteCommandTypes::DELTA:
+            command.target = static_cast<RemoteDeltaTargets>(value[0]);
+            command.delta = static_cast<int16_t>(getUint16(value + 1));
+            break;
+        default:
+            break;
+        }
+    }
+    valid = true;
+}
+
+size_t encodeRemoteRadioMessageData(uint8_t *buf, size_t size, uint8_t batteryPercentage, uint16_t batteryVoltage,
+                                    const RemoteCommand *commands, size_t count)
+{
+    if (size < REMOTE_V1_HEADER_SIZE)
+    {
+        return 0;
+    }
+    buf[0] = batteryPercentage;
+    putUint16(buf + 1, batteryVoltage);
+
+    size_t offset = REMOTE_V1_HEADER_SIZE;
+    for (size_t i = 0; i < count; i++)
+    {
+        const RemoteCommand &command = commands[i];
+        uint8_t length = getRemoteCommandLength(command.type);
+        if (length == 0 || offset + 2 + length > size)
+        {
+            return 0;
+        }
+        buf[offset] = static_cast<uint8_t>(command.type);
+        buf[offset + 1] = length;
+        uint8_t *value = buf + offset + 2;
+        switch (command.type)
+        {
+        case RemoteCommandTypes::EVENT:
+            value[0] = static_cast<uint8_t>(command.event);
+            break;
+        case RemoteCommandTypes::BRIGHTNESS:
+        case RemoteCommandTypes::MIREDS:
+            putUint16(value, command.value[0]);
+            break;
+        case RemoteCommandTypes::RGB:
+            putUint16(value, command.value[0]);
+            putUint16(value + 2, command.value[1]);
+            putUint16(value + 4, command.value[2]);
+            break;
+        case RemoteCommandTypes::SCENE_RECALL:
+        case RemoteCommandTypes::SCENE_STORE:
+            value[0] = command.id;
+            break;
+        case RemoteCommandTypes::DELTA:
+            value[0] = static_cast<uint8_t>(command.target);
+            putUint16(value + 1, static_cast<uint16_t>(command.delta));
+            break;
+        default:
+            break;
+        }
+        offset += 2 + length;
+    }
+    return offset;
+}
+
+size_t RemoteRadioMessageData::getCommandCount()
+{
+    return commandCount;
 }
 
-RemoteEvents RemoteRadioMessageData::getEvent()
+const RemoteCommand &RemoteRadioMessageData::getCommand(size_t index)
 {
-    return EVENT;
+    return COMMANDS[index];
 }
 
 uint8_t RemoteRadioMessageData::getBatteryPercentage()
@@ -42,9 +227,9 @@ void RemoteRadioMessageData::print()
     char output[LOG_BUFFER_SIZE];
     int offset = 0; // Offset to keep track of the current position in the output buffer.
     offset += snprintf(output + offset, sizeof(output) - offset,
-                       "RemoteRadioMessageData: Valid: %s Event: %X Battery: %d %dmV\n",
-                       (valid ? "true" : "false"), (uint8_t)getEvent(), getBatteryPercentage(), getBatteryVoltage());
+                       "RemoteRadioMessageData: Valid: %s Commands: %u Battery: %d %dmV\n",
+                       (valid ? "true" : "false"), (unsigned)commandCount, getBatteryPercentage(), getBatteryVoltage());
     LOG_INFO(output);
 }
 
-#endif
\ No newline at end of file
+#endif
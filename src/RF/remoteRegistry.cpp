@@ -0,0 +1,131 @@
+#include "config.h"
+
+#ifdef REMOTES_ENABLED
+#include "remoteRegistry.h"
+#include "Logging/logging.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+
+static const uint8_t REMOTE_REGISTRY_VERSION = 1;
+
+// Compact binary record of a remote as stored in NVS
+struct RemoteRecord
+{
+    uint8_t uuid[4];
+    uint8_t batteryPercentage;
+    uint8_t transport;
+    uint16_t batteryVoltage;
+    uint32_t firstSeen;
+    uint32_t lastSeen;
+};
+
+struct RemoteRegistryRecord
+{
+    uint8_t version;
+    uint8_t count;
+    uint8_t reserved[2];
+    RemoteRecord remotes[REMOTE_REGISTRY_MAX];
+};
+
+static Preferences preferences;
+static bool registryDirty = false;
+static unsigned long registryDirtyTime = 0;
+
+void remoteRegistryLoad(RemoteMap &remoteMap)
+{
+    RemoteRegistryRecord record;
+    preferences.begin("remotes", true);
+    size_t size = preferences.getBytes("registry", &record, sizeof(record));
+    preferences.end();
+
+    const size_t headerSize = sizeof(record) - sizeof(record.remotes);
+    if (size < headerSize || record.version != REMOTE_REGISTRY_VERSION || record.count > REMOTE_REGISTRY_MAX ||
+        size != headerSize + record.count * sizeof(RemoteRecord))
+    {
+        LOG_INFO("No stored remotes found\n");
+        return;
+    }
+
+    for (size_t i = 0; i < record.count; i++)
+    {
+        const RemoteRecord &stored = record.remotes[i];
+        Remote remote;
+        memcpy(remote.uuid, stored.uuid, sizeof(remote.uuid));
+        remote.batteryPercentage = stored.batteryPercentage;
+        remote.batteryVoltage = stored.batteryVoltage;
+        remote.transport = static_cast<RemoteTransportTypes>(stored.transport);
+        remote.firstSeen = stored.firstSeen;
+        remote.lastSeen = stored.lastSeen;
+        uint32_t uuid;
+        memcpy(&uuid, stored.uuid, sizeof(uuid));
+        remoteMap[uuid] = remote;
+    }
+    LOG_INFO("Restored %i remotes\n", record.count);
+}
+
+void remoteRegistryMarkDirty()
+{
+    if (!registryDirty)
+    {
+        registryDirty = true;
+        registryDirtyTime = millis();
+    }
+}
+
+void remoteRegistryLoop(const RemoteMap &remoteMap)
+{
+    if (!registryDirty || millis() - registryDirtyTime < REMOTE_REGISTRY_SAVE_DELAY)
+    {
+        return;
+    }
+    registryDirty = false;
+
+    // Keep the most recently seen remotes if there are more than fit into the record
+    RemoteRegistryRecord record = {};
+    record.version = REMOTE_REGISTRY_VERSION;
+    for (auto &r : remoteMap)
+    {
+        size_t index = record.count;
+        if (record.count == REMOTE_REGISTRY_MAX)
+        {
+            index = 0;
+            for (size_t i = 1; i < REMOTE_REGISTRY_MAX; i++)
+            {
+                if (record.remotes[i].lastSeen < record.remotes[index].lastSeen)
+                {
+                    index = i;
+                }
+            }
+            if (record.remotes[index].lastSeen >= r.second.lastSeen)
+            {
+                continue;
+            }
+        }
+        else
+        {
+            record.count++;
+        }
+
+        RemoteRecord &stored = record.remotes[index];
+        memcpy(stored.uuid, r.second.uuid, sizeof(stored.uuid));
+        stored.batteryPercentage = r.second.batteryPercentage;
+        stored.transport = static_cast<uint8_t>(r.second.transport);
+        stored.batteryVoltage = r.second.batteryVoltage;
+        stored.firstSeen = r.second.firstSeen;
+        stored.lastSeen = r.second.lastSeen;
+    }
+
+    const size_t size = sizeof(record) - sizeof(record.remotes) + record.count * sizeof(RemoteRecord);
+    preferences.begin("remotes", false);
+    size_t written = preferences.putBytes("registry", &record, size);
+    preferences.end();
+    if (written != size)
+    {
+        LOG_ERROR("Failed to store remotes\n");
+        return;
+    }
+    LOG_INFO("Stored %i remotes\n", record.count);
+}
+
+#endif
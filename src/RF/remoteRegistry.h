@@ -0,0 +1,19 @@
+#pragma once
+#include "config.h"
+#ifdef REMOTES_ENABLED
+
+#include "radio.h"
+
+#define REMOTE_REGISTRY_MAX 16            // Maximum number of remotes stored in NVS
+#define REMOTE_REGISTRY_SAVE_DELAY 10000 // Delay between a registry change and writing it to NVS in milliseconds
+
+// Restore the remotes stored in NVS into remoteMap
+void remoteRegistryLoad(RemoteMap &remoteMap);
+
+// Mark the registry as changed, it is written by remoteRegistryLoop after REMOTE_REGISTRY_SAVE_DELAY
+void remoteRegistryMarkDirty();
+
+// Write the registry to NVS if it changed and the save delay expired
+void remoteRegistryLoop(const RemoteMap &remoteMap);
+
+#endif
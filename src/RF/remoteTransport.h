@@ -0,0 +1,45 @@
+#pragma once
+#include "config.h"
+#ifdef REMOTES_ENABLED
+
+#include <cstddef>
+#include <cstdint>
+
+#define REMOTE_MAX_FRAME_SIZE 32 // Maximum size of a remote frame on any transport
+
+enum class RemoteTransportTypes : uint8_t
+{
+    RF24,
+    ESPNOW,
+    LOOPBACK,
+};
+
+// Transport carrying remote frames to the lamp
+// All transports deliver the same frame format, decoding and dispatch are transport independent
+class RemoteTransport
+{
+public:
+    virtual ~RemoteTransport() = default;
+
+    // Name of the transport used for logging
+    virtual const char *getName() = 0;
+
+    // Type of the transport stored with the remotes seen on it
+    virtual RemoteTransportTypes getType() = 0;
+
+    // Start the transport, returns false if it can not be started (yet)
+    virtual bool begin() = 0;
+
+    // Read the next received frame into buf (REMOTE_MAX_FRAME_SIZE bytes), returns false if none is pending
+    virtual bool receive(uint8_t *buf, uint8_t &size) = 0;
+
+    // Signal strength of the last received frame, strong is set if it was received above about -64 dBm
+    // Returns false if the transport can not measure it
+    virtual bool getSignalSample(bool &strong) { return false; }
+
+    // Update the state feedback frame returned to remotes, called after received frames were handled
+    // and whenever the lamp state changed
+    virtual void setFeedback(const uint8_t *data, uint8_t size) {}
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "config.h"
+
+#ifdef RF24RADIO_ENABLED
+#include "rf24Transport.h"
+#include "radio.h"
+#include "Logging/logging.h"
+#include "Events/eventBus.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <RF24.h>
+#include <WiFi.h>
+
+static RF24 radio(PIN_RADIO_CE, PIN_RADIO_CSN);
+static Preferences preferences;
+
+static bool radioInitialized = false;
+static volatile bool _radioMsgReceived = false;
+static bool radioDraining = false; // Set while frames signaled by the last interrupt are read
+static bool lastFrameRpd = false;  // Received power detector when the last frame was read
+static const auto RADIO_DATARATE = RF24_250KBPS;
+static char radioAddressStr[] = "00:00:00:00:00";
+static const uint8_t RADIO_REMOTE_PIPE = 1;
+static uint8_t radioPowerLevel = RF24_PA_LOW;
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+static uint8_t ackPayload[REMOTE_MAX_FRAME_SIZE];
+static uint8_t ackPayloadSize = 0;
+static uint32_t ackPayloadFailures = 0;     // Failed preloads since the last successful one
+static bool ackPayloadRetryWaiting = false; // The last preload failed, the next is tried after a received frame
+#endif
+
+struct RadioSettings
+{
+    uint8_t channel;
+    uint8_t radioAddress[5];
+};
+RadioSettings radioSettings;
+
+IRAM_ATTR static void radioInterrupt()
+{
+    _radioMsgReceived = true;
+}
+
+static void loadRadioSettings()
+{
+    uint8_t mac[6];
+    WiFi.macAddress(mac);
+    preferences.begin("radio_config", false);
+    radioSettings.channel = preferences.getInt("channel", 100);
+    radioSettings.radioAddress[0] = preferences.getUChar("radioAddress0", mac[1]);
+    radioSettings.radioAddress[1] = preferences.getUChar("radioAddress1", mac[2]);
+    radioSettings.radioAddress[2] = preferences.getUChar("radioAddress2", mac[3]);
+    radioSettings.radioAddress[3] = preferences.getUChar("radioAddress3", mac[4]);
+    radioSettings.radioAddress[4] = preferences.getUChar("radioAddress4", mac[5]);
+    preferences.end();
+    LOG_INFO("Loaded Radio settings: Channel: %i, Radio Address: %02X:%02X:%02X:%02X:%02X\n",
+             radioSettings.channel, radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
+}
+
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+static void preloadAckPayload()
+{
+    // Replace any queued payload so the next ACK never carries a stale state
+    radio.flush_tx();
+    if (ackPayloadSize == 0)
+    {
+        return;
+    }
+    if (!radio.writeAckPayload(RADIO_REMOTE_PIPE, ackPayload, ackPayloadSize))
+    {
+        // Logged once per failure streak, a failing radio would otherwise log on every state change
+        if (ackPayloadFailures++ == 0)
+        {
+            LOG_WARNING("Failed to preload radio ACK payload, retrying after the next received frame\n");
+        }
+        ackPayloadRetryWaiting = true;
+        return;
+    }
+    if (ackPayloadFailures > 0)
+    {
+        LOG_INFO("Radio ACK payload preloaded after %u failed attempts\n", (unsigned)ackPayloadFailures);
+        ackPayloadFailures = 0;
+    }
+    ackPayloadRetryWaiting = false;
+}
+#endif
+
+static bool rf24Begin()
+{
+    radioInitialized = false;
+    loadRadioSettings(); // Load the radio settings
+    if (!radio.begin())
+    {
+        LOG_ERROR("RF24Radio Connection Error!\n");
+        return false;
+    }
+
+    pinMode(PIN_RADIO_IRQ, INPUT);
+    // let IRQ pin only trigger on "data_ready" event
+    radio.maskIRQ(true, true, false); // args = "data_sent", "data_fail", "data_ready"
+    attachInterrupt(digitalPinToInterrupt(PIN_RADIO_IRQ), radioInterrupt, FALLING);
+
+    radio.setChannel(radioSettings.channel);              // Set the channel
+    radio.setPALevel(radioPowerLevel);                    // Adjust power level
+    radio.setAddressWidth(5);                             // Set address width
+    radio.setCRCLength(RF24_CRC_16);                      // Set CRC length
+    radio.setRetries(5, 15);                              // Set the number of retries and delay between retries
+    radio.enableDynamicPayloads();                        // Enable dynamic payloads
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+    radio.enableAckPayload(); // Enable ACK payloads for state feedback to remotes
+#endif
+    radio.setDataRate(RADIO_DATARATE);                                    // Set data rate
+    radio.openReadingPipe(RADIO_REMOTE_PIPE, radioSettings.radioAddress); // Open a reading pipe on the remote address
+    radio.startListening();                                               // Start listening
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+    preloadAckPayload(); // Restore the ACK payload flushed by the reinitialization
+#endif
+
+    LOG_INFO("RF24Radio initialized!\n");
+    radioDraining = false;
+    radioInitialized = true;
+    return true;
+}
+
+const char *RF24Transport::getName()
+{
+    return "RF24";
+}
+
+RemoteTransportTypes RF24Transport::getType()
+{
+    return RemoteTransportTypes::RF24;
+}
+
+bool RF24Transport::begin()
+{
+    return rf24Begin();
+}
+
+bool RF24Transport::receive(uint8_t *buf, uint8_t &size)
+{
+    if (!radioInitialized)
+    {
+        return false;
+    }
+
+    // Only poll the radio after the IRQ signaled new data, then read until the RX FIFO is empty
+    if (!radioDraining)
+    {
+        if (!_radioMsgReceived)
+        {
+            return false;
+        }
+        _radioMsgReceived = false;
+        radioDraining = true;
+    }
+
+    if (radio.available())
+    {
+        // RPD is latched by the carrier of the frame that was just received, sample it before the read can change the
+        // radio state. With several frames in the RX FIFO it belongs to the newest one, a close enough estimate
+        lastFrameRpd = radio.testRPD();
+        size = min(radio.getDynamicPayloadSize(), (uint8_t)REMOTE_MAX_FRAME_SIZE);
+        radio.read(buf, size); // Read the data into the buffer
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+        ackPayloadRetryWaiting = false; // Retry a failed preload with the feedback refreshed for this frame
+#endif
+        return true;
+    }
+
+    radioDraining = false;
+    return false; // No data available
+}
+
+bool RF24Transport::getSignalSample(bool &strong)
+{
+    // RPD is a single threshold at -64 dBm, not a per frame RSSI, so only tells strong from weak frames
+    strong = lastFrameRpd;
+    return true;
+}
+
+void RF24Transport::setFeedback(const uint8_t *data, uint8_t size)
+{
+#ifdef RF24RADIO_ACK_PAYLOAD_ENABLED
+    ackPayloadSize = min(size, (uint8_t)REMOTE_MAX_FRAME_SIZE);
+    memcpy(ackPayload, data, ackPayloadSize);
+    if (radioInitialized && !ackPayloadRetryWaiting) // After a failure the payload is kept for the retry
+    {
+        preloadAckPayload();
+    }
+#endif
+}
+
+bool RF24Transport::isResponsive()
+{
+    return radioInitialized && radio.isChipConnected() && radio.getChannel() == radioSettings.channel;
+}
+
+uint8_t getRadioPowerLevel()
+{
+    return radioPowerLevel;
+}
+
+bool changeRadioPowerLevel(int8_t delta)
+{
+    int level = constrain(radioPowerLevel + delta, RF24_PA_MIN, RF24_PA_MAX);
+    if (level == radioPowerLevel)
+    {
+        return false;
+    }
+    radioPowerLevel = level;
+    if (radioInitialized)
+    {
+        radio.setPALevel(radioPowerLevel);
+    }
+    LOG_INFO("Radio power level set to %i\n", radioPowerLevel);
+    return true;
+}
+
+bool radioIsInitialized()
+{
+    return radioInitialized;
+}
+
+char *getRadioAddressString()
+{
+    // return radio address in format "XX:XX:XX:XX:XX"
+    sprintf(radioAddressStr, "%02X:%02X:%02X:%02X:%02X", radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
+    return radioAddressStr;
+}
+
+uint8_t getRadioChannel()
+{
+    return radioSettings.channel;
+}
+
+void setRadioSettings(uint8_t channel, const char *radioAddress)
+{
+    radioSettings.channel = channel;
+    sscanf(radioAddress, "%02X:%02X:%02X:%02X:%02X", &radioSettings.radioAddress[0], &radioSettings.radioAddress[1], &radioSettings.radioAddress[2], &radioSettings.radioAddress[3], &radioSettings.radioAddress[4]);
+    LOG_INFO("Radio settings updated: Channel: %i, Radio Address: %02X:%02X:%02X:%02X:%02X\n",
+             radioSettings.channel, radioSettings.radioAddress[0], radioSettings.radioAddress[1], radioSettings.radioAddress[2], radioSettings.radioAddress[3], radioSettings.radioAddress[4]);
+
+    // Save the radio settings
+    preferences.begin("radio_config", false);
+    preferences.putInt("channel", radioSettings.channel);
+    preferences.putUChar("radioAddress0", radioSettings.radioAddress[0]);
+    preferences.putUChar("radioAddress1", radioSettings.radioAddress[1]);
+    preferences.putUChar("radioAddress2", radioSettings.radioAddress[2]);
+    preferences.putUChar("radioAddress3", radioSettings.radioAddress[3]);
+    preferences.putUChar("radioAddress4", radioSettings.radioAddress[4]);
+    preferences.end();
+
+    // Restart the radio
+    radio.stopListening();
+    delay(100);
+    rf24Begin();
+    eventBusPublish(EventTypes::CONFIG_CHANGED); // Channel and address are reported in the diagnostics
+}
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+#include "config.h"
+#ifdef RF24RADIO_ENABLED
+
+#include "remoteTransport.h"
+
+// nRF24L01 transport, state feedback is sent in ACK payloads
+class RF24Transport : public RemoteTransport
+{
+public:
+    const char *getName() override;
+    RemoteTransportTypes getType() override;
+    bool begin() override;
+    bool receive(uint8_t *buf, uint8_t &size) override;
+    bool getSignalSample(bool &strong) override;
+    void setFeedback(const uint8_t *data, uint8_t size) override;
+
+    // Read back the configuration registers, returns false if the radio does not respond as configured
+    bool isResponsive();
+};
+
+uint8_t getRadioPowerLevel();
+bool changeRadioPowerLevel(int8_t delta);
+
+#endif
@@ -2,8 +2,10 @@
 
 #include "Network/network.h"
 #include "Output/ioControl.h"
+#include "Output/ledControl.h"
 #include "ChipID/chipID.h"
-#ifdef RF24RADIO_ENABLED
+#include "Logging/bootTimeline.h"
+#ifdef REMOTES_ENABLED
 #include "RF/radio.h"
 #endif
 
@@ -36,22 +38,24 @@ void printSpiPins()
 
 void setup()
 {
+  ledInit(); // Restore the light first, before serial, NVS heavy setup and WiFi
   Serial.begin(115200);
   delay(100); // Wait for the serial connection to be established
   printMemoryInfo();
   Serial.print("\n\ncompile time: ");
   Serial.println(__DATE__ " " __TIME__);
   Serial.println(ChipID::getChipID());
+  bootTimelineMark("Setup");
 
-  xTaskCreate(ioTask, "ioTask", 4096, NULL, 1, NULL); // Create the io task
-#ifdef RF24RADIO_ENABLED
-  xTaskCreate(radioTask, "radioTask", 4096, NULL, 1, NULL); // Create the radio task
+  QueueHandle_t networkEvents = networkSubscribeEvents(); // Before any task exists, so no event is published unseen
+  xTaskCreate(networkTask, "networkTask", NETWORK_TASK_STACK_SIZE, networkEvents, NETWORK_TASK_PRIORITY, NULL);
+  xTaskCreate(ioTask, "ioTask", IO_TASK_STACK_SIZE, NULL, IO_TASK_PRIORITY, NULL); // Create the io task
+#ifdef REMOTES_ENABLED
+  xTaskCreate(radioTask, "radioTask", RADIO_TASK_STACK_SIZE, NULL, RADIO_TASK_PRIORITY, NULL); // Create the radio task
 #endif
-
-  networkInit(); // Initialize WiFi and MQTT settings
 }
 
 void loop()
 {
-  networkLoop();
+  vTaskDelete(NULL); // All work is done in the tasks created in setup
 }
@@ -0,0 +1,158 @@
+#pragma once
+// Host replacement of the Arduino core for [env:native]
+// Only covers what the modules built for the unit tests use. Time does not pass on its own,
+// tests move it forward with delay() or by setting nativeMillis.
+
+#include <algorithm>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+template <class T, class L, class H>
+T constrain(T x, L low, H high)
+{
+    return x < (T)low ? (T)low : (x > (T)high ? (T)high : x);
+}
+
+// Time
+inline unsigned long nativeMillis = 0; // Current value of millis()
+
+inline unsigned long millis() { return nativeMillis; }
+inline unsigned long micros() { return nativeMillis * 1000; }
+inline void delay(unsigned long ms) { nativeMillis += ms; }
+inline int64_t esp_timer_get_time() { return (int64_t)nativeMillis * 1000; }
+
+// GPIO and PWM
+inline void pinMode(int pin, int mode) {}
+inline bool ledcAttach(int pin, uint32_t frequency, uint8_t resolution) { return true; }
+inline bool ledcWrite(int pin, uint32_t duty) { return true; }
+
+// System
+typedef enum
+{
+    ESP_RST_UNKNOWN,
+    ESP_RST_POWERON,
+    ESP_RST_SW,
+    ESP_RST_PANIC,
+    ESP_RST_BROWNOUT,
+} esp_reset_reason_t;
+
+inline esp_reset_reason_t esp_reset_reason() { return ESP_RST_POWERON; }
+
+inline uint32_t nativeFreeHeap = 200000;    // Reported by ESP.getFreeHeap()
+inline uint32_t nativeMinFreeHeap = 180000; // Reported by ESP.getMinFreeHeap()
+
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return nativeFreeHeap; }
+    uint32_t getMinFreeHeap() { return nativeMinFreeHeap; }
+};
+
+inline EspClass ESP;
+
+// Arduino String, only what the firmware uses besides the std::string interface
+class String : public std::string
+{
+public:
+    String() {}
+    String(const char *str) : std::string(str) {}
+    String(const std::string &str) : std::string(str) {}
+};
+
+// Output stream used to write payloads without buffering them
+class Print
+{
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t written = 0;
+        for (size_t i = 0; i < size; i++)
+        {
+            written += write(buffer[i]);
+        }
+        return written;
+    }
+    size_t print(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+};
+
+// FreeRTOS, tests run single threaded so critical sections are no-ops
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef void *TaskHandle_t;
+
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdMS_TO_TICKS(ms) (ms)
+#define portMAX_DELAY 0xffffffff
+
+typedef struct
+{
+    int owner;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) (void)(mux)
+#define portEXIT_CRITICAL(mux) (void)(mux)
+
+inline void vTaskDelay(TickType_t ticks) { nativeMillis += ticks; }
+
+struct NativeQueue
+{
+    UBaseType_t length;
+    UBaseType_t itemSize;
+    std::deque<std::vector<uint8_t>> items;
+};
+typedef NativeQueue *QueueHandle_t;
+
+inline QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t itemSize)
+{
+    return new NativeQueue{length, itemSize, {}};
+}
+
+inline BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t wait)
+{
+    if (queue->items.size() >= queue->length)
+    {
+        return pdFALSE;
+    }
+    const uint8_t *bytes = (const uint8_t *)item;
+    queue->items.emplace_back(bytes, bytes + queue->itemSize);
+    return pdTRUE;
+}
+
+inline BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t wait)
+{
+    if (queue->items.empty())
+    {
+        return pdFALSE;
+    }
+    memcpy(item, queue->items.front().data(), queue->itemSize);
+    queue->items.pop_front();
+    return pdTRUE;
+}
+
+inline UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue) { return queue->items.size(); }
@@ -0,0 +1,102 @@
+#pragma once
+// In memory replacement of the NVS Preferences for [env:native]
+// Values survive end() and new Preferences objects until nativePreferencesClear() is called
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+inline std::map<std::string, std::vector<uint8_t>> nativePreferences; // Stored values keyed by "<namespace>/<key>"
+
+inline void nativePreferencesClear() { nativePreferences.clear(); }
+
+class Preferences
+{
+private:
+    std::string name;
+    bool opened = false;
+
+    std::string path(const char *key) { return name + "/" + key; }
+
+    size_t put(const char *key, const void *value, size_t size)
+    {
+        if (!opened)
+        {
+            return 0;
+        }
+        const uint8_t *bytes = (const uint8_t *)value;
+        nativePreferences[path(key)].assign(bytes, bytes + size);
+        return size;
+    }
+
+    template <class T>
+    T get(const char *key, T defaultValue)
+    {
+        T value = defaultValue;
+        getBytes(key, &value, sizeof(value));
+        return value;
+    }
+
+public:
+    bool begin(const char *ns, bool readOnly = false, const char *partition = nullptr)
+    {
+        name = ns;
+        opened = true;
+        return true;
+    }
+    void end() { opened = false; }
+
+    bool clear()
+    {
+        std::string prefix = name + "/";
+        for (auto it = nativePreferences.begin(); it != nativePreferences.end();)
+        {
+            it = it->first.compare(0, prefix.size(), prefix) == 0 ? nativePreferences.erase(it) : std::next(it);
+        }
+        return opened;
+    }
+    bool remove(const char *key) { return nativePreferences.erase(path(key)) > 0; }
+    bool isKey(const char *key) { return nativePreferences.count(path(key)) > 0; }
+
+    size_t putBool(const char *key, bool value) { return put(key, &value, sizeof(value)); }
+    size_t putUChar(const char *key, uint8_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUShort(const char *key, uint16_t value) { return put(key, &value, sizeof(value)); }
+    size_t putInt(const char *key, int32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putUInt(const char *key, uint32_t value) { return put(key, &value, sizeof(value)); }
+    size_t putULong64(const char *key, uint64_t value) { return put(key, &value, sizeof(value)); }
+    size_t putBytes(const char *key, const void *value, size_t size) { return put(key, value, size); }
+    size_t putString(const char *key, const char *value) { return put(key, value, strlen(value) + 1); }
+
+    bool getBool(const char *key, bool defaultValue = false) { return get(key, defaultValue); }
+    uint8_t getUChar(const char *key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    uint16_t getUShort(const char *key, uint16_t defaultValue = 0) { return get(key, defaultValue); }
+    int32_t getInt(const char *key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint32_t getUInt(const char *key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    uint64_t getULong64(const char *key, uint64_t defaultValue = 0) { return get(key, defaultValue); }
+
+    size_t getBytesLength(const char *key)
+    {
+        auto it = nativePreferences.find(path(key));
+        return it == nativePreferences.end() ? 0 : it->second.size();
+    }
+
+    // Like NVS, values that do not fit the buffer are not read
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        auto it = nativePreferences.find(path(key));
+        if (it == nativePreferences.end() || it->second.size() > maxLen)
+        {
+            return 0;
+        }
+        memcpy(buf, it->second.data(), it->second.size());
+        return it->second.size();
+    }
+
+    size_t getString(const char *key, char *value, size_t maxLen) { return getBytes(key, value, maxLen); }
+    String getString(const char *key, const String defaultValue = String())
+    {
+        auto it = nativePreferences.find(path(key));
+        return it == nativePreferences.end() ? defaultValue : String((const char *)it->second.data());
+    }
+};
@@ -0,0 +1,217 @@
+#pragma once
+// Host replacement of PubSubClient 2.8 for [env:native], connected to the brokers of nativeNetwork.h
+// Blocks where the library blocks: a CONNECT that gets no CONNACK moves the clock by the socket timeout
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <nativeNetwork.h>
+#include <functional>
+#include <memory>
+
+#define MQTT_CONNECTION_TIMEOUT -4
+#define MQTT_CONNECTION_LOST -3
+#define MQTT_CONNECT_FAILED -2
+#define MQTT_DISCONNECTED -1
+#define MQTT_CONNECTED 0
+#define MQTT_MAX_HEADER_SIZE 5
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+class PubSubClient : public Print
+{
+    Client *client;
+    MQTT_CALLBACK_SIGNATURE;
+    IPAddress ip;
+    uint16_t port = 0;
+    uint16_t bufferSize = 256;
+    std::unique_ptr<uint8_t[]> buffer{new uint8_t[256]}; // Allocated like the library buffer, so heap measurements see it
+    uint16_t socketTimeout = 15;
+    std::string clientId;
+    int lastState = MQTT_DISCONNECTED;
+    bool streaming = false;
+    std::string streamTopic;
+    std::string streamPayload;
+    bool streamRetained = false;
+
+    int socket()
+    {
+        WiFiClient *wifiClient = dynamic_cast<WiFiClient *>(client);
+        return wifiClient != nullptr ? wifiClient->fd() : -1;
+    }
+
+    NativeBroker *broker() { return nativeSocketBroker(socket()); }
+
+public:
+    PubSubClient(Client &client) : client(&client) {}
+
+    PubSubClient &setServer(IPAddress ip, uint16_t port)
+    {
+        this->ip = ip;
+        this->port = port;
+        return *this;
+    }
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE)
+    {
+        this->callback = callback;
+        return *this;
+    }
+    bool setBufferSize(uint16_t size)
+    {
+        if (size == 0)
+        {
+            return false;
+        }
+        buffer.reset(new uint8_t[size]);
+        bufferSize = size;
+        return true;
+    }
+    uint16_t getBufferSize() { return bufferSize; }
+    PubSubClient &setSocketTimeout(uint16_t timeout)
+    {
+        socketTimeout = timeout;
+        return *this;
+    }
+    PubSubClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+
+    bool connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos, bool willRetain,
+                 const char *willMessage, bool cleanSession = true)
+    {
+        if (!client->connected() && !client->connect(ip, port))
+        {
+            lastState = MQTT_CONNECT_FAILED;
+            return false;
+        }
+        NativeBroker *server = broker();
+        if (server == nullptr || !server->answersConnect)
+        {
+            delay(socketTimeout * 1000UL);
+            client->stop();
+            lastState = MQTT_CONNECTION_TIMEOUT;
+            return false;
+        }
+        NativeMessage will;
+        if (willTopic != nullptr)
+        {
+            will = {willTopic, willMessage, willRetain};
+        }
+        clientId = id;
+        server->connect(clientId, cleanSession, socket(), will);
+        lastState = MQTT_CONNECTED;
+        return true;
+    }
+
+    void disconnect()
+    {
+        NativeBroker *server = broker();
+        if (server != nullptr)
+        {
+            server->disconnect(clientId);
+        }
+        lastState = MQTT_DISCONNECTED;
+        client->stop();
+    }
+
+    bool connected()
+    {
+        NativeBroker *server = broker();
+        bool connected = server != nullptr && server->isConnected(clientId, socket());
+        if (!connected && lastState == MQTT_CONNECTED)
+        {
+            lastState = MQTT_CONNECTION_LOST;
+            client->stop();
+        }
+        return connected;
+    }
+
+    int state() { return lastState; }
+
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+    {
+        if (!connected() || MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + length > bufferSize)
+        {
+            return false;
+        }
+        broker()->publish(topic, std::string((const char *)payload, length), retained);
+        return true;
+    }
+    bool publish(const char *topic, const char *payload, bool retained) { return publish(topic, (const uint8_t *)payload, strlen(payload), retained); }
+    bool publish(const char *topic, const char *payload) { return publish(topic, payload, false); }
+
+    // Streamed publishes bypass the buffer like in the library
+    bool beginPublish(const char *topic, unsigned int length, bool retained)
+    {
+        if (!connected())
+        {
+            return false;
+        }
+        streaming = true;
+        streamTopic = topic;
+        streamPayload.clear();
+        streamPayload.reserve(length); // One copy on the simulated wire, like the buffered publish
+        streamRetained = retained;
+        return true;
+    }
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size) override
+    {
+        if (!streaming)
+        {
+            return 0;
+        }
+        streamPayload.append((const char *)buffer, size);
+        return size;
+    }
+    int endPublish()
+    {
+        if (!streaming || !connected())
+        {
+            streaming = false;
+            return 0;
+        }
+        streaming = false;
+        broker()->publish(streamTopic, streamPayload, streamRetained);
+        std::string().swap(streamTopic); // The library sends the message as it is written and keeps none of it
+        std::string().swap(streamPayload);
+        return 1;
+    }
+
+    bool subscribe(const char *topic, uint8_t qos = 0)
+    {
+        if (!connected() || MQTT_MAX_HEADER_SIZE + 2 + 2 + strlen(topic) + 1 > bufferSize)
+        {
+            return false;
+        }
+        return broker()->subscribe(clientId, topic, qos);
+    }
+
+    bool unsubscribe(const char *topic)
+    {
+        if (!connected())
+        {
+            return false;
+        }
+        broker()->unsubscribe(clientId, topic);
+        return true;
+    }
+
+    // Hands the delivered messages to the callback, messages larger than the buffer are dropped like in the library
+    bool loop()
+    {
+        if (!connected())
+        {
+            return false;
+        }
+        for (const NativeMessage &message : broker()->deliver(clientId))
+        {
+            if (!callback || MQTT_MAX_HEADER_SIZE + 2 + message.topic.size() + message.payload.size() > bufferSize)
+            {
+                continue;
+            }
+            std::vector<char> topic(message.topic.begin(), message.topic.end());
+            topic.push_back('\0');
+            std::vector<uint8_t> payload(message.payload.begin(), message.payload.end());
+            payload.push_back('\0'); // The library buffer has room for the terminator the firmware writes
+            callback(topic.data(), payload.data(), message.payload.size());
+        }
+        return true;
+    }
+};
@@ -0,0 +1,71 @@
+#pragma once
+// Host replacement of the ESP32 WebServer for [env:native]: routes are registered like on the device,
+// requests are handed to them directly by the test instead of arriving over TCP
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum HTTPMethod
+{
+    HTTP_ANY,
+    HTTP_GET,
+    HTTP_POST,
+    HTTP_PUT,
+    HTTP_DELETE,
+};
+
+class WebServer
+{
+    struct Route
+    {
+        std::string path;
+        HTTPMethod method;
+        std::function<void()> handler;
+    };
+
+    std::vector<Route> routes;
+    String body; // Body of the request being handled, the "plain" argument
+
+public:
+    int responseCode = 0;
+    String responseType;
+    String response;
+
+    WebServer(uint16_t port = 80) {}
+
+    void on(const char *path, HTTPMethod method, std::function<void()> handler) { routes.push_back({path, method, handler}); }
+
+    String arg(const char *name) { return strcmp(name, "plain") == 0 ? body : String(); }
+
+    void send(int code, const char *type, const String &content)
+    {
+        responseCode = code;
+        responseType = type;
+        response = content;
+    }
+    void send_P(int code, const char *type, const char *content, size_t size)
+    {
+        responseCode = code;
+        responseType = type;
+        response.assign(content, size);
+    }
+
+    // Handles one request like handleClient would, returns the status code, 404 without a route
+    int request(HTTPMethod method, const char *path, const char *requestBody = "")
+    {
+        body = requestBody;
+        responseCode = 404;
+        response.clear();
+        for (Route &route : routes)
+        {
+            if (route.path == path && (route.method == method || route.method == HTTP_ANY))
+            {
+                route.handler();
+                break;
+            }
+        }
+        return responseCode;
+    }
+};
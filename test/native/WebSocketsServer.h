@@ -0,0 +1,102 @@
+#pragma once
+// Host replacement of the WebSockets server for [env:native]: clients are simulated by the test,
+// every frame sent to a client is counted and the last one kept
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+
+#ifndef WEBSOCKETS_SERVER_CLIENT_MAX
+#define WEBSOCKETS_SERVER_CLIENT_MAX 4
+#endif
+
+enum WStype_t
+{
+    WStype_ERROR,
+    WStype_DISCONNECTED,
+    WStype_CONNECTED,
+    WStype_TEXT,
+    WStype_BIN,
+};
+
+class WebSocketsServer;
+inline WebSocketsServer *nativeWebSocketsServer = nullptr; // Last server created, the firmware keeps its server private
+
+struct NativeWebSocketClient
+{
+    bool connected = false;
+    size_t frames = 0; // Text frames sent to the client
+    std::string last;  // Last text frame sent to the client
+};
+
+class WebSocketsServer
+{
+public:
+    typedef std::function<void(uint8_t client, WStype_t type, uint8_t *payload, size_t length)> WebSocketServerEvent;
+
+    NativeWebSocketClient clients[WEBSOCKETS_SERVER_CLIENT_MAX];
+    size_t broadcasts = 0;
+
+    WebSocketsServer(uint16_t port) { nativeWebSocketsServer = this; }
+
+    void begin() {}
+    void loop() {}
+    void onEvent(WebSocketServerEvent handler) { event = handler; }
+
+    uint8_t connectedClients()
+    {
+        uint8_t count = 0;
+        for (NativeWebSocketClient &client : clients)
+        {
+            count += client.connected;
+        }
+        return count;
+    }
+
+    bool sendTXT(uint8_t num, const char *payload, size_t length = 0)
+    {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || !clients[num].connected)
+        {
+            return false;
+        }
+        clients[num].frames++;
+        clients[num].last.assign(payload, length ? length : strlen(payload));
+        return true;
+    }
+
+    bool broadcastTXT(const char *payload, size_t length = 0)
+    {
+        broadcasts++;
+        for (uint8_t num = 0; num < WEBSOCKETS_SERVER_CLIENT_MAX; num++)
+        {
+            sendTXT(num, payload, length);
+        }
+        return true;
+    }
+
+    // Simulated client side, returns false if every client slot is taken
+    bool nativeConnect(uint8_t num)
+    {
+        if (num >= WEBSOCKETS_SERVER_CLIENT_MAX || clients[num].connected)
+        {
+            return false;
+        }
+        clients[num] = NativeWebSocketClient();
+        clients[num].connected = true;
+        event(num, WStype_CONNECTED, nullptr, 0);
+        return true;
+    }
+    void nativeDisconnect(uint8_t num)
+    {
+        clients[num].connected = false;
+        event(num, WStype_DISCONNECTED, nullptr, 0);
+    }
+    void nativeText(uint8_t num, const char *payload)
+    {
+        std::string frame(payload);
+        event(num, WStype_TEXT, (uint8_t *)frame.data(), frame.size());
+    }
+
+private:
+    WebSocketServerEvent event;
+};
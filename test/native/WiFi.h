@@ -0,0 +1,106 @@
+#pragma once
+// Host replacement of the WiFi library for [env:native]: the station, IPv4 addresses and TCP clients
+// on the in memory network of nativeNetwork.h
+
+#include <Arduino.h>
+#include <nativeNetwork.h>
+#include <arpa/inet.h>
+
+inline uint8_t nativeMacAddress[6] = {0x24, 0x58, 0x7C, 0xA1, 0xB2, 0xC3}; // Station MAC address
+inline uint32_t nativeLocalIP = 0x6400A8C0;                                 // 192.168.0.100 in network byte order
+inline int8_t nativeRssi = -60;
+
+// IPv4 address stored in network byte order like the Arduino core
+class IPAddress
+{
+    uint32_t address = 0;
+
+public:
+    IPAddress() {}
+    IPAddress(uint32_t address) : address(address) {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : address(a | b << 8 | c << 16 | (uint32_t)d << 24) {}
+
+    bool fromString(const char *str)
+    {
+        struct in_addr in;
+        if (inet_pton(AF_INET, str, &in) != 1)
+        {
+            return false;
+        }
+        address = in.s_addr;
+        return true;
+    }
+
+    String toString() const
+    {
+        char str[INET_ADDRSTRLEN];
+        struct in_addr in = {address};
+        inet_ntop(AF_INET, &in, str, sizeof(str));
+        return String(str);
+    }
+
+    operator uint32_t() const { return address; }
+};
+
+class WiFiClass
+{
+public:
+    void macAddress(uint8_t *mac) { memcpy(mac, nativeMacAddress, sizeof(nativeMacAddress)); }
+    IPAddress localIP() { return IPAddress(nativeLocalIP); }
+    int8_t RSSI() { return nativeRssi; }
+};
+
+class Client : public Print
+{
+public:
+    virtual int connect(IPAddress ip, uint16_t port) = 0;
+    virtual uint8_t connected() = 0;
+    virtual void stop() = 0;
+};
+
+// TCP client on a socket of the in memory network, copies share the socket like in the Arduino core
+class WiFiClient : public Client
+{
+    int socket = -1;
+
+public:
+    WiFiClient() {}
+    WiFiClient(int fd) : socket(fd) {}
+
+    // Blocks until the broker accepted the connection or the timeout passed
+    int connect(IPAddress ip, uint16_t port, int32_t timeout)
+    {
+        stop();
+        socket = nativeSocketOpen();
+        nativeSocketConnect(socket, (uint32_t)ip, port);
+        unsigned long start = millis();
+        while (nativeSocketPoll(socket) == NativeSocketStates::CONNECTING && millis() - start < (unsigned long)timeout)
+        {
+            delay(1);
+        }
+        if (nativeSocketPoll(socket) != NativeSocketStates::CONNECTED)
+        {
+            stop();
+            return 0;
+        }
+        return 1;
+    }
+    int connect(IPAddress ip, uint16_t port) override { return connect(ip, port, 3000); }
+
+    uint8_t connected() override { return socket >= 0 && nativeSocketExists(socket) && nativeSocketPoll(socket) == NativeSocketStates::CONNECTED; }
+
+    void stop() override
+    {
+        if (socket >= 0)
+        {
+            nativeSocketClose(socket);
+            socket = -1;
+        }
+    }
+
+    int fd() const { return socket; }
+
+    size_t write(uint8_t c) override { return connected(); }
+};
+
+inline WiFiClass WiFi;
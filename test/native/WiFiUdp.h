@@ -0,0 +1,119 @@
+#pragma once
+// Host replacement of WiFiUDP for [env:native] on real UDP sockets
+// Multicast groups are joined on the loopback interface with loopback enabled, so firmware instances
+// in several processes on the same host receive each other's packets like lamps on one network
+
+#include <WiFi.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class WiFiUDP
+{
+    int fd = -1;
+    uint8_t packet[1500];
+    size_t packetSize = 0;
+    size_t position = 0;
+    std::vector<uint8_t> out;
+    struct sockaddr_in destination = {};
+
+    bool open()
+    {
+        if (fd >= 0)
+        {
+            return true;
+        }
+        fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        int enable = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable));
+        struct in_addr loopback = {htonl(INADDR_LOOPBACK)};
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+        uint8_t loop = 1;
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+        return true;
+    }
+
+public:
+    ~WiFiUDP() { stop(); }
+
+    uint8_t beginMulticast(IPAddress address, uint16_t port)
+    {
+        if (!open())
+        {
+            return 0;
+        }
+        struct sockaddr_in local = {};
+        local.sin_family = AF_INET;
+        local.sin_port = htons(port);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+        struct ip_mreq membership;
+        membership.imr_multiaddr.s_addr = (uint32_t)address;
+        membership.imr_interface.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd, (struct sockaddr *)&local, sizeof(local)) < 0 ||
+            setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0)
+        {
+            stop();
+            return 0;
+        }
+        return 1;
+    }
+
+    // Size of the next datagram or 0 if none arrived, the rest of the previous one is discarded
+    int parsePacket()
+    {
+        packetSize = 0;
+        position = 0;
+        if (fd < 0)
+        {
+            return 0;
+        }
+        ssize_t size = recv(fd, packet, sizeof(packet), 0);
+        packetSize = size > 0 ? size : 0;
+        return packetSize;
+    }
+
+    int read(uint8_t *buffer, size_t len)
+    {
+        size_t n = std::min(len, packetSize - position);
+        memcpy(buffer, packet + position, n);
+        position += n;
+        return n;
+    }
+
+    int beginPacket(IPAddress address, uint16_t port)
+    {
+        out.clear();
+        destination.sin_family = AF_INET;
+        destination.sin_port = htons(port);
+        destination.sin_addr.s_addr = (uint32_t)address;
+        return open() ? 1 : 0;
+    }
+
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        out.insert(out.end(), buffer, buffer + size);
+        return size;
+    }
+
+    int endPacket()
+    {
+        return sendto(fd, out.data(), out.size(), 0, (struct sockaddr *)&destination, sizeof(destination)) == (ssize_t)out.size();
+    }
+
+    void stop()
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+};
@@ -0,0 +1,30 @@
+#pragma once
+// Host replacement of the ESP-IDF SNTP client for [env:native]
+// Nothing is synchronized, tests call nativeSntpSync() to report a completed synchronization
+
+#include <sys/time.h>
+
+typedef enum
+{
+    SNTP_SYNC_MODE_IMMED,
+    SNTP_SYNC_MODE_SMOOTH,
+} sntp_sync_mode_t;
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+inline sntp_sync_time_cb_t nativeSntpCallback = nullptr;
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback) { nativeSntpCallback = callback; }
+inline void sntp_set_sync_mode(sntp_sync_mode_t mode) {}
+inline void sntp_set_sync_interval(uint32_t interval) {}
+inline void configTime(long gmtOffset, int daylightOffset, const char *server) {}
+
+inline void nativeSntpSync()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (nativeSntpCallback != nullptr)
+    {
+        nativeSntpCallback(&tv);
+    }
+}
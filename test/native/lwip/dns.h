@@ -0,0 +1,17 @@
+#pragma once
+// Host replacement of the lwIP DNS client for [env:native], answered by the DNS server of nativeNetwork.h
+
+#include <lwip/ip_addr.h>
+#include <nativeNetwork.h>
+
+typedef int8_t err_t;
+
+#define ERR_OK 0
+#define ERR_INPROGRESS -5
+
+typedef void (*dns_found_callback)(const char *name, const ip_addr_t *ipaddr, void *callback_arg);
+
+inline err_t dns_gethostbyname(const char *hostname, ip_addr_t *addr, dns_found_callback found, void *callback_arg)
+{
+    return nativeDnsLookup(hostname, addr, found, callback_arg) ? ERR_OK : ERR_INPROGRESS;
+}
@@ -0,0 +1,13 @@
+#pragma once
+// Host replacement of the lwIP address types for [env:native], IPv4 only
+
+#include <cstdint>
+
+typedef struct ip4_addr
+{
+    uint32_t addr; // Network byte order
+} ip4_addr_t;
+
+typedef ip4_addr_t ip_addr_t;
+
+#define ip_2_ip4(ipaddr) (ipaddr)
@@ -0,0 +1,69 @@
+#pragma once
+// Host replacement of the lwIP socket API for [env:native] on the sockets of nativeNetwork.h
+// Like lwIP with LWIP_POSIX_SOCKETS_IO_NAMES, select and fcntl are mapped to the stack's own functions,
+// descriptors that are not in the in memory network are passed on to the host
+
+#include <nativeNetwork.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+
+inline int lwip_socket(int domain, int type, int protocol) { return nativeSocketOpen(); }
+
+inline int lwip_connect(int s, const struct sockaddr *name, socklen_t namelen)
+{
+    const struct sockaddr_in *addr = (const struct sockaddr_in *)name;
+    nativeSocketConnect(s, addr->sin_addr.s_addr, ntohs(addr->sin_port));
+    errno = EINPROGRESS;
+    return -1;
+}
+
+inline int lwip_getsockopt(int s, int level, int optname, void *optval, socklen_t *optlen)
+{
+    if (level == SOL_SOCKET && optname == SO_ERROR)
+    {
+        *(int *)optval = nativeSocketPoll(s) == NativeSocketStates::REFUSED ? ECONNREFUSED : 0;
+    }
+    return 0;
+}
+
+inline int lwip_setsockopt(int s, int level, int optname, const void *optval, socklen_t optlen) { return 0; }
+
+inline int lwip_close(int s)
+{
+    nativeSocketClose(s);
+    return 0;
+}
+
+inline int nativeFcntl(int s, int cmd, int val = 0)
+{
+    return nativeSocketExists(s) ? 0 : fcntl(s, cmd, val);
+}
+
+// Writable once the connect completed or failed, never waits
+inline int nativeSelect(int maxfdp1, fd_set *readset, fd_set *writeset, fd_set *exceptset, struct timeval *timeout)
+{
+    int ready = 0;
+    for (int fd = 0; fd < maxfdp1; fd++)
+    {
+        if (writeset == NULL || !FD_ISSET(fd, writeset))
+        {
+            continue;
+        }
+        if (nativeSocketExists(fd) && nativeSocketPoll(fd) != NativeSocketStates::CONNECTING)
+        {
+            ready++;
+        }
+        else
+        {
+            FD_CLR(fd, writeset);
+        }
+    }
+    return ready;
+}
+
+#define fcntl(s, cmd, ...) nativeFcntl(s, cmd, ##__VA_ARGS__)
+#define select(maxfdp1, readset, writeset, exceptset, timeout) nativeSelect(maxfdp1, readset, writeset, exceptset, timeout)
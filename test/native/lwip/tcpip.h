@@ -0,0 +1,5 @@
+#pragma once
+// Host replacement of the lwIP core lock for [env:native], tests run the network in the calling thread
+
+#define LOCK_TCPIP_CORE()
+#define UNLOCK_TCPIP_CORE()
@@ -0,0 +1,53 @@
+#pragma once
+// Heap accounting for [env:native]: replaces the global operator new and delete of the test binary,
+// so include it from the test only, never from a header of the firmware
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+inline size_t nativeHeapAllocations = 0; // Allocations since the start
+inline size_t nativeHeapInUse = 0;       // Bytes allocated and not yet freed
+inline size_t nativeHeapPeak = 0;        // Highest nativeHeapInUse since the last nativeHeapResetPeak
+
+// Start a new peak measurement at the current use
+inline void nativeHeapResetPeak()
+{
+    nativeHeapPeak = nativeHeapInUse;
+}
+
+// Every block is prefixed with its size, kept at the alignment of max_align_t
+static constexpr size_t NATIVE_HEAP_HEADER = alignof(std::max_align_t);
+
+void *operator new(size_t size)
+{
+    unsigned char *block = (unsigned char *)malloc(NATIVE_HEAP_HEADER + size);
+    if (block == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    *(size_t *)block = size;
+    nativeHeapAllocations++;
+    nativeHeapInUse += size;
+    if (nativeHeapInUse > nativeHeapPeak)
+    {
+        nativeHeapPeak = nativeHeapInUse;
+    }
+    return block + NATIVE_HEAP_HEADER;
+}
+
+void operator delete(void *p) noexcept
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    unsigned char *block = (unsigned char *)p - NATIVE_HEAP_HEADER;
+    nativeHeapInUse -= *(size_t *)block;
+    free(block);
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
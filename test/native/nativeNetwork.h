@@ -0,0 +1,452 @@
+#pragma once
+// In memory network of [env:native] with a DNS server, TCP endpoints and MQTT 3.1.1 brokers
+// The lwIP, WiFiClient and PubSubClient replacements run on it, so the firmware connects to brokers that tests
+// start, stop and cut off. Nothing happens in the background: nativeNetworkLoop() does the work of the lwIP
+// thread, DNS answers and TCP connects arrive nativeNetworkLatency milliseconds after they were sent.
+
+#include <Arduino.h>
+#include <lwip/ip_addr.h>
+#include <arpa/inet.h>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+inline unsigned long nativeNetworkLatency = 5; // Round trip time of DNS queries and TCP handshakes in milliseconds
+
+class NativeBroker;
+
+// DNS server, names that are not registered are answered with "not found"
+struct NativeDnsEntry
+{
+    uint32_t address;
+    bool answers; // A server that does not answer lets the lookup time out
+    bool cached;  // lwIP answers cached names without a query
+};
+
+typedef void (*NativeDnsCallback)(const char *name, const ip_addr_t *ipaddr, void *arg);
+
+struct NativeDnsQuery
+{
+    std::string name;
+    NativeDnsCallback callback;
+    void *arg;
+    unsigned long answerTime;
+};
+
+inline std::map<std::string, NativeDnsEntry> nativeDns;
+inline std::deque<NativeDnsQuery> nativeDnsQueries;
+inline size_t nativeDnsQueryCount = 0;
+
+inline void nativeDnsAdd(const char *name, const char *address)
+{
+    NativeDnsEntry entry = {inet_addr(address), true, false};
+    nativeDns[name] = entry;
+}
+
+inline void nativeDnsSetAnswers(const char *name, bool answers)
+{
+    nativeDns[name].answers = answers;
+    nativeDns[name].cached = false;
+}
+
+// Returns true with addr set if the name is cached, otherwise the answer is passed to callback later
+inline bool nativeDnsLookup(const char *name, ip_addr_t *addr, NativeDnsCallback callback, void *arg)
+{
+    auto it = nativeDns.find(name);
+    if (it != nativeDns.end() && it->second.cached)
+    {
+        ip_2_ip4(addr)->addr = it->second.address;
+        return true;
+    }
+    nativeDnsQueryCount++;
+    nativeDnsQueries.push_back({name, callback, arg, millis() + nativeNetworkLatency});
+    return false;
+}
+
+// TCP sockets of the firmware, a connect completes after the latency if a broker listens on the address
+enum class NativeSocketStates
+{
+    CONNECTING,
+    CONNECTED,
+    REFUSED,
+    CLOSED,
+};
+
+struct NativeSocket
+{
+    uint32_t address = 0;
+    uint16_t port = 0;
+    NativeSocketStates state = NativeSocketStates::CLOSED;
+    unsigned long connectTime = 0;
+    NativeBroker *broker = nullptr;
+};
+
+inline std::map<int, NativeSocket> nativeSockets;
+inline std::map<std::pair<uint32_t, uint16_t>, NativeBroker *> nativeEndpoints;
+#define NATIVE_SOCKET_FIRST 512 // Above the descriptors of real sockets in the same process and below FD_SETSIZE
+inline size_t nativeConnectCount = 0;
+
+inline bool nativeSocketExists(int fd) { return nativeSockets.count(fd) > 0; }
+
+struct NativeMessage
+{
+    std::string topic;
+    std::string payload;
+    bool retained = false;
+};
+
+// Bytes of a PUBLISH frame: fixed header, remaining length, topic length, topic, packet ID for QoS > 0 and payload
+inline size_t nativePublishFrameSize(size_t topicLength, size_t payloadLength, uint8_t qos)
+{
+    size_t remaining = 2 + topicLength + (qos > 0 ? 2 : 0) + payloadLength;
+    size_t lengthBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : remaining < 2097152 ? 3 : 4;
+    return 1 + lengthBytes + remaining;
+}
+
+// MQTT 3.1.1 broker with persistent sessions, retained messages and wills
+// QoS 1 messages to a subscribed session are queued while its client is offline
+class NativeBroker
+{
+    struct Session
+    {
+        std::map<std::string, uint8_t> subscriptions; // Topic and granted QoS
+        std::deque<NativeMessage> queue;
+        bool connected = false;
+        int socket = -1;
+        NativeMessage will;
+    };
+    std::map<std::string, Session> sessions;
+    uint32_t address = 0;
+    uint16_t port = 0;
+
+    void closeSocket(Session &session)
+    {
+        if (nativeSocketExists(session.socket))
+        {
+            nativeSockets[session.socket].state = NativeSocketStates::CLOSED;
+        }
+        session.socket = -1;
+    }
+
+    // Connection ended without DISCONNECT, the will is published and the session kept
+    void dropSession(Session &session)
+    {
+        if (!session.connected)
+        {
+            return;
+        }
+        session.connected = false;
+        closeSocket(session);
+        if (!session.will.topic.empty())
+        {
+            publish(session.will.topic, session.will.payload, session.will.retained);
+        }
+    }
+
+public:
+    bool listening = true;      // Refuses connections if false
+    bool blackhole = false;     // Drops TCP handshakes so connects time out
+    bool answersConnect = true; // Accepts TCP connections but never sends CONNACK
+    bool failSubscribe = false;
+    size_t connects = 0;
+    size_t subscribes = 0;
+    size_t unsubscribes = 0;
+    size_t publishesIn = 0;  // PUBLISH frames received from clients
+    size_t publishesOut = 0; // PUBLISH frames delivered to clients
+    size_t bytesIn = 0;
+    size_t bytesOut = 0;
+    std::map<std::string, std::string> retained;
+    std::map<std::string, size_t> published; // PUBLISH frames received per topic
+
+    NativeBroker() {}
+
+    // Broker reachable as host on address:port of the in memory network
+    NativeBroker(const char *host, const char *address, uint16_t port) : address(inet_addr(address)), port(port)
+    {
+        nativeDnsAdd(host, address);
+        nativeEndpoints[{this->address, port}] = this;
+    }
+
+    ~NativeBroker()
+    {
+        if (nativeEndpoints[{address, port}] == this)
+        {
+            nativeEndpoints.erase({address, port});
+        }
+    }
+
+    // Broker process stopped, open connections are closed and new ones refused, persistent sessions survive
+    void stop()
+    {
+        listening = false;
+        for (auto &session : sessions)
+        {
+            dropSession(session.second);
+        }
+    }
+
+    void start()
+    {
+        listening = true;
+        blackhole = false;
+        answersConnect = true;
+    }
+
+    bool accepts() { return listening && !blackhole; }
+
+    void connect(const std::string &clientId, bool cleanSession, int socket = -1, const NativeMessage &will = NativeMessage())
+    {
+        Session &previous = sessions[clientId];
+        dropSession(previous); // Taken over by the new connection
+        if (cleanSession)
+        {
+            sessions.erase(clientId);
+        }
+        Session &session = sessions[clientId];
+        session.connected = true;
+        session.socket = socket;
+        session.will = will;
+        connects++;
+    }
+
+    // DISCONNECT from the client, the will is discarded
+    void disconnect(const std::string &clientId)
+    {
+        Session &session = sessions[clientId];
+        session.connected = false;
+        session.will = NativeMessage();
+        closeSocket(session);
+    }
+
+    // Connection dropped without DISCONNECT, the session and its subscriptions stay
+    void forceDisconnect(const std::string &clientId)
+    {
+        dropSession(sessions[clientId]);
+    }
+
+    // Client closed its socket without DISCONNECT
+    void socketClosed(int socket)
+    {
+        for (auto &session : sessions)
+        {
+            if (session.second.connected && session.second.socket == socket)
+            {
+                session.second.socket = -1;
+                dropSession(session.second);
+            }
+        }
+    }
+
+    // Broker restart without persistence
+    void loseSessions()
+    {
+        for (auto &session : sessions)
+        {
+            closeSocket(session.second);
+        }
+        sessions.clear();
+    }
+
+    bool isConnected(const std::string &clientId)
+    {
+        auto it = sessions.find(clientId);
+        return it != sessions.end() && it->second.connected;
+    }
+
+    bool isConnected(const std::string &clientId, int socket)
+    {
+        return isConnected(clientId) && sessions[clientId].socket == socket;
+    }
+
+    size_t connectedClients()
+    {
+        size_t count = 0;
+        for (auto &session : sessions)
+        {
+            count += session.second.connected;
+        }
+        return count;
+    }
+
+    bool subscribe(const std::string &clientId, const std::string &topic, uint8_t qos = 1)
+    {
+        if (failSubscribe)
+        {
+            return false;
+        }
+        subscribes++;
+        Session &session = sessions[clientId];
+        session.subscriptions[topic] = qos;
+        auto it = retained.find(topic);
+        if (it != retained.end())
+        {
+            session.queue.push_back({topic, it->second, true});
+        }
+        return true;
+    }
+
+    void unsubscribe(const std::string &clientId, const std::string &topic)
+    {
+        unsubscribes++;
+        sessions[clientId].subscriptions.erase(topic);
+    }
+
+    bool isSubscribed(const std::string &clientId, const std::string &topic)
+    {
+        return sessions[clientId].subscriptions.count(topic) > 0;
+    }
+
+    std::vector<std::string> getSubscriptions(const std::string &clientId)
+    {
+        std::vector<std::string> topics;
+        for (const auto &subscription : sessions[clientId].subscriptions)
+        {
+            topics.push_back(subscription.first);
+        }
+        return topics;
+    }
+
+    // PUBLISH from a client or the test, an empty retained payload clears the retained message
+    void publish(const std::string &topic, const std::string &payload, bool retain = false)
+    {
+        publishesIn++;
+        published[topic]++;
+        bytesIn += nativePublishFrameSize(topic.size(), payload.size(), 0);
+        if (retain && payload.empty())
+        {
+            retained.erase(topic);
+        }
+        else if (retain)
+        {
+            retained[topic] = payload;
+        }
+        for (auto &session : sessions)
+        {
+            auto subscription = session.second.subscriptions.find(topic);
+            if (subscription != session.second.subscriptions.end() && (session.second.connected || subscription->second > 0))
+            {
+                session.second.queue.push_back({topic, payload, false});
+            }
+        }
+    }
+
+    // Messages delivered to a connected client, queued ones first
+    std::vector<NativeMessage> deliver(const std::string &clientId)
+    {
+        Session &session = sessions[clientId];
+        std::vector<NativeMessage> messages;
+        while (session.connected && !session.queue.empty())
+        {
+            NativeMessage &message = session.queue.front();
+            auto subscription = session.subscriptions.find(message.topic);
+            uint8_t qos = subscription != session.subscriptions.end() ? subscription->second : 1;
+            publishesOut++;
+            bytesOut += nativePublishFrameSize(message.topic.size(), message.payload.size(), qos);
+            messages.push_back(message);
+            session.queue.pop_front();
+        }
+        return messages;
+    }
+};
+
+inline NativeSocketStates nativeSocketPoll(int fd)
+{
+    NativeSocket &socket = nativeSockets[fd];
+    if (socket.state == NativeSocketStates::CONNECTING && millis() >= socket.connectTime)
+    {
+        auto endpoint = nativeEndpoints.find({socket.address, socket.port});
+        NativeBroker *broker = endpoint != nativeEndpoints.end() ? endpoint->second : nullptr;
+        if (broker == nullptr || !broker->listening)
+        {
+            socket.state = NativeSocketStates::REFUSED;
+        }
+        else if (!broker->blackhole)
+        {
+            socket.state = NativeSocketStates::CONNECTED;
+            socket.broker = broker;
+        }
+    }
+    return socket.state;
+}
+
+inline int nativeSocketOpen()
+{
+    int fd = NATIVE_SOCKET_FIRST;
+    while (nativeSocketExists(fd))
+    {
+        fd++;
+    }
+    nativeSockets[fd] = NativeSocket();
+    return fd;
+}
+
+inline void nativeSocketConnect(int fd, uint32_t address, uint16_t port)
+{
+    NativeSocket &socket = nativeSockets[fd];
+    socket.address = address;
+    socket.port = port;
+    socket.state = NativeSocketStates::CONNECTING;
+    socket.connectTime = millis() + nativeNetworkLatency;
+    nativeConnectCount++;
+}
+
+inline void nativeSocketClose(int fd)
+{
+    auto it = nativeSockets.find(fd);
+    if (it == nativeSockets.end())
+    {
+        return;
+    }
+    NativeBroker *broker = it->second.broker;
+    nativeSockets.erase(it);
+    if (broker != nullptr)
+    {
+        broker->socketClosed(fd);
+    }
+}
+
+// Broker behind a connected socket
+inline NativeBroker *nativeSocketBroker(int fd)
+{
+    if (!nativeSocketExists(fd) || nativeSocketPoll(fd) != NativeSocketStates::CONNECTED)
+    {
+        return nullptr;
+    }
+    return nativeSockets[fd].broker;
+}
+
+// Deliver the DNS answers that arrived, called between passes of the firmware loop
+inline void nativeNetworkLoop()
+{
+    while (!nativeDnsQueries.empty() && millis() >= nativeDnsQueries.front().answerTime)
+    {
+        NativeDnsQuery query = nativeDnsQueries.front();
+        nativeDnsQueries.pop_front();
+        auto it = nativeDns.find(query.name);
+        if (it != nativeDns.end() && !it->second.answers)
+        {
+            continue;
+        }
+        if (it == nativeDns.end())
+        {
+            query.callback(query.name.c_str(), NULL, query.arg);
+            continue;
+        }
+        it->second.cached = true;
+        ip_addr_t addr;
+        ip_2_ip4(&addr)->addr = it->second.address;
+        query.callback(query.name.c_str(), &addr, query.arg);
+    }
+}
+
+// Forget the cached DNS answers and pending queries, open connections stay
+inline void nativeNetworkReset()
+{
+    nativeDnsQueries.clear();
+    for (auto &entry : nativeDns)
+    {
+        entry.second.cached = false;
+        entry.second.answers = true;
+    }
+}
@@ -0,0 +1,107 @@
+#include "Network/discoveryCache.h"
+#include "Network/haDiscovery.h"
+#include "Network/mqttTopics.h"
+#include "ChipID/chipID.h"
+
+#include <Preferences.h>
+#include <unity.h>
+
+static const char *PRIMARY = "broker.local";
+static const char *BACKUP = "backup.local";
+
+// The decision mqttHomeAssistandDiscovery makes for a document on connect
+static bool needsPublish(BaseHaDiscovery &discovery, const char *server)
+{
+    return discoveryCacheChanged(discovery.getTopic(), server, discovery.getPayloadFingerprint());
+}
+
+// What streamHomeAssistantDiscovery does after a successful publish
+static void published(BaseHaDiscovery &discovery, const char *server)
+{
+    discoveryCacheStore(discovery.getTopic(), server, discovery.getPayloadFingerprint());
+}
+
+void setUp()
+{
+    nativePreferencesClear();
+    setDeviceName(MODELNAME);
+    mqttTopicsBuild("smartlamp");
+}
+
+void tearDown() {}
+
+static void test_unchanged_discovery_is_skipped()
+{
+    HaDiscovery discovery;
+    TEST_ASSERT_TRUE(needsPublish(discovery, PRIMARY));
+    published(discovery, PRIMARY);
+    TEST_ASSERT_FALSE(needsPublish(discovery, PRIMARY));
+
+    HaDiscovery afterReboot; // The fingerprint is rendered again from the same settings
+    TEST_ASSERT_FALSE(needsPublish(afterReboot, PRIMARY));
+}
+
+static void test_changed_discovery_is_published()
+{
+    HaDiscovery discovery;
+    published(discovery, PRIMARY);
+
+    setDeviceName("Kitchen");
+    mqttTopicsBuild("smartlamp");
+    HaDiscovery renamed;
+    TEST_ASSERT_TRUE(needsPublish(renamed, PRIMARY));
+    published(renamed, PRIMARY);
+    TEST_ASSERT_FALSE(needsPublish(renamed, PRIMARY));
+}
+
+// Retained messages live on each broker, so a failover publishes to the backup once
+static void test_each_broker_is_tracked_separately()
+{
+    HaDiscovery discovery;
+    published(discovery, PRIMARY);
+    TEST_ASSERT_TRUE(needsPublish(discovery, BACKUP));
+    published(discovery, BACKUP);
+    TEST_ASSERT_FALSE(needsPublish(discovery, PRIMARY));
+    TEST_ASSERT_FALSE(needsPublish(discovery, BACKUP));
+}
+
+// An evicted remote is published again when it returns
+static void test_removed_remote_is_published_again()
+{
+    const uint8_t uuid[4] = {1, 2, 3, 4};
+    RemoteHaDiscovery remote(uuid);
+    HaDiscovery device;
+    published(remote, PRIMARY);
+    published(remote, BACKUP);
+    published(device, PRIMARY);
+
+    discoveryCacheRemove(remote.getTopic(), PRIMARY);
+    discoveryCacheRemove(remote.getTopic(), BACKUP);
+    TEST_ASSERT_TRUE(needsPublish(remote, PRIMARY));
+    TEST_ASSERT_TRUE(needsPublish(remote, BACKUP));
+    TEST_ASSERT_FALSE(needsPublish(device, PRIMARY));
+}
+
+static void test_clear_publishes_everything_again()
+{
+    const uint8_t uuid[4] = {1, 2, 3, 4};
+    RemoteHaDiscovery remote(uuid);
+    HaDiscovery device;
+    published(remote, PRIMARY);
+    published(device, PRIMARY);
+
+    discoveryCacheClear();
+    TEST_ASSERT_TRUE(needsPublish(remote, PRIMARY));
+    TEST_ASSERT_TRUE(needsPublish(device, PRIMARY));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unchanged_discovery_is_skipped);
+    RUN_TEST(test_changed_discovery_is_published);
+    RUN_TEST(test_each_broker_is_tracked_separately);
+    RUN_TEST(test_removed_remote_is_published_again);
+    RUN_TEST(test_clear_publishes_everything_again);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+#include "ChipID/chipID.h"
+#include "Network/haDiscovery.h"
+#include "Network/mqttTopics.h"
+
+#include <Arduino.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <nativeHeap.h>
+#include <nativeNetwork.h>
+#include <unity.h>
+
+// Heap of publishing the device discovery through the MQTT client, buffered like before and streamed like publishDiscovery
+// Both runs go through the same in memory broker, so its copy of the payload is part of both peaks
+
+#define BUFFERED_SIZE 2048 // Client and render buffer the discovery was published with before it was streamed
+
+static NativeBroker broker("broker.local", "10.0.0.1", 1883);
+static char renderBuffer[BUFFERED_SIZE]; // Static like the render buffer of the buffered publish
+
+// Writes a rendered payload into renderBuffer
+class BufferPrint : public Print
+{
+public:
+    size_t used = 0;
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override
+    {
+        len = min(len, sizeof(renderBuffer) - used);
+        memcpy(renderBuffer + used, data, len);
+        used += len;
+        return len;
+    }
+};
+
+// Chunks the rendered payload into the client like MqttPublishStream
+class ChunkPrint : public Print
+{
+    PubSubClient &client;
+    uint8_t chunk[MQTT_STREAM_CHUNK_SIZE];
+    size_t used = 0;
+
+public:
+    ChunkPrint(PubSubClient &client) : client(client) {}
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override
+    {
+        size_t written = len;
+        while (len > 0)
+        {
+            size_t n = min(len, sizeof(chunk) - used);
+            memcpy(chunk + used, data, n);
+            used += n;
+            data += n;
+            len -= n;
+            if (used == sizeof(chunk))
+            {
+                flush();
+            }
+        }
+        return written;
+    }
+
+    void flush()
+    {
+        client.write(chunk, used);
+        used = 0;
+    }
+};
+
+static bool publishBuffered(PubSubClient &client, BaseHaDiscovery &discovery)
+{
+    BufferPrint out;
+    discovery.writePayload(out);
+    return client.publish(discovery.getTopic(), (const uint8_t *)renderBuffer, out.used, true);
+}
+
+static bool publishStreamed(PubSubClient &client, BaseHaDiscovery &discovery)
+{
+    if (!client.beginPublish(discovery.getTopic(), discovery.getPayloadSize(), true))
+    {
+        return false;
+    }
+    ChunkPrint out(client);
+    discovery.writePayload(out);
+    out.flush();
+    return client.endPublish() == 1;
+}
+
+struct HeapUse
+{
+    size_t steady; // Bytes held by the connected client after the publish
+    size_t peak;   // Bytes at the highest point while connecting and publishing
+};
+
+// Connects a client with the given buffer, publishes the discovery and measures the heap against the start
+static HeapUse measure(uint16_t bufferSize, bool (*publish)(PubSubClient &, BaseHaDiscovery &))
+{
+    HaDiscovery discovery;
+    size_t base = nativeHeapInUse;
+    nativeHeapResetPeak();
+    HeapUse use;
+    {
+        WiFiClient wifi;
+        PubSubClient client(wifi);
+        client.setBufferSize(bufferSize);
+        client.setServer(IPAddress(10, 0, 0, 1), 1883);
+        TEST_ASSERT_TRUE(client.connect("lamp", nullptr, nullptr, nullptr, 0, false, nullptr));
+        TEST_ASSERT_TRUE(publish(client, discovery));
+        TEST_ASSERT_EQUAL(discovery.getPayloadSize(), broker.retained[discovery.getTopic()].size());
+        broker.retained.clear(); // The broker copy is not held by the lamp
+        use.steady = nativeHeapInUse - base;
+        use.peak = nativeHeapPeak - base;
+        client.disconnect();
+    }
+    broker.loseSessions();
+    return use;
+}
+
+void setUp()
+{
+    setDeviceName(MODELNAME);
+    mqttTopicsBuild("smartlamp");
+}
+
+void tearDown() {}
+
+static void test_streamed_discovery_needs_less_heap()
+{
+    measure(MQTT_BUFFER_SIZE, publishStreamed); // Creates the bookkeeping of the broker both runs share
+    HeapUse buffered = measure(BUFFERED_SIZE, publishBuffered);
+    HeapUse streamed = measure(MQTT_BUFFER_SIZE, publishStreamed);
+    TEST_ASSERT_EQUAL(BUFFERED_SIZE - MQTT_BUFFER_SIZE, buffered.steady - streamed.steady);
+    TEST_ASSERT_EQUAL(BUFFERED_SIZE - MQTT_BUFFER_SIZE, buffered.peak - streamed.peak);
+
+    char message[200];
+    snprintf(message, sizeof(message), "Device discovery of %u bytes: buffered steady %u peak %u bytes heap and %u bytes static, "
+                                       "streamed steady %u peak %u bytes heap and %u bytes stack",
+             (unsigned)HaDiscovery().getPayloadSize(), (unsigned)buffered.steady, (unsigned)buffered.peak, (unsigned)sizeof(renderBuffer),
+             (unsigned)streamed.steady, (unsigned)streamed.peak, (unsigned)MQTT_STREAM_CHUNK_SIZE);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_streamed_discovery_needs_less_heap);
+    return UNITY_END();
+}
@@ -0,0 +1,335 @@
+#include "Network/groupControl.h"
+#include "Network/timeSync.h"
+#include "Output/ledControl.h"
+
+#include <Preferences.h>
+#include <WiFiUdp.h>
+#include <esp_sntp.h>
+#include <chrono>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unity.h>
+
+// Packets go over real UDP multicast on the loopback interface, the same path the lamps of a room share
+// The first test forks several firmware instances, each with its own group settings and LED state
+
+static WiFiUDP sender;
+static uint32_t sequence = 0;
+
+static GroupPacket makePacket(uint16_t group, uint16_t brightness)
+{
+    GroupPacket packet = {};
+    packet.magic = GROUP_PACKET_MAGIC;
+    packet.version = GROUP_PACKET_VERSION;
+    packet.flags = GROUP_FLAG_POWER | GROUP_FLAG_POWER_ON | GROUP_FLAG_BRIGHTNESS;
+    packet.group = group;
+    packet.sender = 0x5E4D0001;
+    packet.sequence = ++sequence;
+    packet.transitionTimeMs = 0;
+    packet.brightness = brightness;
+    return packet;
+}
+
+static void send(const void *data, size_t size)
+{
+    IPAddress address;
+    address.fromString(GROUP_CONTROL_ADDRESS);
+    TEST_ASSERT_EQUAL(1, sender.beginPacket(address, GROUP_CONTROL_PORT));
+    sender.write((const uint8_t *)data, size);
+    TEST_ASSERT_EQUAL(1, sender.endPacket());
+}
+
+static void send(const GroupPacket &packet)
+{
+    send(&packet, sizeof(packet));
+}
+
+static uint32_t countPackets(const GroupControlStats &stats)
+{
+    return stats.received + stats.duplicates + stats.invalid;
+}
+
+// Run the network task loop until the lamp handled the expected number of packets, loopback delivery is fast
+// but not synchronous, so real time is allowed to pass here
+static void receive(uint32_t packets)
+{
+    uint32_t expected = countPackets(getGroupControlStats()) + packets;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (countPackets(getGroupControlStats()) < expected && std::chrono::steady_clock::now() < deadline)
+    {
+        groupControlLoop();
+    }
+    groupControlLoop(); // Nothing more than expected arrived
+    TEST_ASSERT_EQUAL(expected, countPackets(getGroupControlStats()));
+    delay(LIGHT_COMMAND_COALESCE_TIME);
+    applyLightCommands();
+}
+
+void setUp()
+{
+    setGroupId(1);
+    setLedPower(false, 0);
+}
+
+void tearDown() {}
+
+static void test_packet_is_applied()
+{
+    GroupControlStats before = getGroupControlStats();
+    GroupPacket packet = makePacket(1, 600);
+    packet.flags |= GROUP_FLAG_COLOR_TEMPERATURE | GROUP_FLAG_RGB; // RGB is ignored by a CCT lamp
+    packet.mireds = 250;
+    packet.red = 1000;
+    send(packet);
+    receive(1);
+
+    TEST_ASSERT_EQUAL(before.received + 1, getGroupControlStats().received);
+    TEST_ASSERT_TRUE(getLedPower());
+    TEST_ASSERT_EQUAL(600, getLedBrightness());
+    TEST_ASSERT_EQUAL(250, getLedColorTemperature());
+}
+
+// Senders repeat every packet, only the first copy is applied
+static void test_repeated_packets_are_dropped()
+{
+    GroupControlStats before = getGroupControlStats();
+    GroupPacket packet = makePacket(1, 300);
+    for (int i = 0; i < 3; i++)
+    {
+        send(packet);
+    }
+    GroupPacket older = makePacket(1, 900);
+    older.sequence = packet.sequence - 1; // Reordered, an older command must not win
+    send(older);
+    receive(4);
+
+    TEST_ASSERT_EQUAL(before.received + 1, getGroupControlStats().received);
+    TEST_ASSERT_EQUAL(before.duplicates + 3, getGroupControlStats().duplicates);
+    TEST_ASSERT_EQUAL(300, getLedBrightness());
+}
+
+// Sequences are tracked per sender, and a restarted sender is accepted again after the timeout
+static void test_sequences_are_tracked_per_sender()
+{
+    GroupControlStats before = getGroupControlStats();
+    GroupPacket first = makePacket(1, 200);
+    GroupPacket second = makePacket(1, 400);
+    second.sender = 0x5E4D0002;
+    second.sequence = first.sequence;
+    send(first);
+    send(second);
+    receive(2);
+    TEST_ASSERT_EQUAL(before.received + 2, getGroupControlStats().received);
+    TEST_ASSERT_EQUAL(400, getLedBrightness());
+
+    GroupPacket restarted = makePacket(1, 100);
+    restarted.sequence = 1;
+    send(restarted);
+    receive(1);
+    TEST_ASSERT_EQUAL(before.duplicates + 1, getGroupControlStats().duplicates);
+
+    delay(GROUP_CONTROL_SEQUENCE_TIMEOUT);
+    send(restarted);
+    receive(1);
+    TEST_ASSERT_EQUAL(before.received + 3, getGroupControlStats().received);
+    TEST_ASSERT_EQUAL(100, getLedBrightness());
+}
+
+// More senders than slots replace the least recently seen one, which is accepted again as a new sender
+static void test_sender_slots_are_recycled()
+{
+    GroupControlStats before = getGroupControlStats();
+    GroupPacket packets[GROUP_CONTROL_SENDER_SLOTS + 1];
+    for (uint32_t i = 0; i <= GROUP_CONTROL_SENDER_SLOTS; i++)
+    {
+        packets[i] = makePacket(1, 100 + i);
+        packets[i].sender = 0x5E4D1000 + i;
+        send(packets[i]);
+        receive(1);
+        delay(1);
+    }
+    TEST_ASSERT_EQUAL(before.received + GROUP_CONTROL_SENDER_SLOTS + 1, getGroupControlStats().received);
+
+    send(packets[GROUP_CONTROL_SENDER_SLOTS]); // Still tracked
+    send(packets[0]);                          // Evicted by the last sender
+    receive(2);
+    TEST_ASSERT_EQUAL(before.duplicates + 1, getGroupControlStats().duplicates);
+    TEST_ASSERT_EQUAL(before.received + GROUP_CONTROL_SENDER_SLOTS + 2, getGroupControlStats().received);
+    TEST_ASSERT_EQUAL(100, getLedBrightness());
+}
+
+static void test_invalid_packets_are_counted()
+{
+    GroupControlStats before = getGroupControlStats();
+    GroupPacket magic = makePacket(1, 700);
+    magic.magic = 0x1234;
+    GroupPacket version = makePacket(1, 700);
+    version.version = GROUP_PACKET_VERSION + 1;
+    GroupPacket valid = makePacket(1, 700);
+    send(&magic, sizeof(magic));
+    send(&version, sizeof(version));
+    send(&valid, sizeof(valid) - 1); // Truncated
+    receive(3);
+
+    TEST_ASSERT_EQUAL(before.invalid + 3, getGroupControlStats().invalid);
+    TEST_ASSERT_EQUAL(before.received, getGroupControlStats().received);
+    TEST_ASSERT_FALSE(getLedPower());
+}
+
+// Packets of other groups are not counted at all, packets to all lamps reach lamps without a group too
+static void test_group_addressing()
+{
+    GroupControlStats before = getGroupControlStats();
+    send(makePacket(2, 800));
+    send(makePacket(GROUP_ID_ALL, 500));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (getGroupControlStats().received == before.received && std::chrono::steady_clock::now() < deadline)
+    {
+        groupControlLoop();
+    }
+    delay(LIGHT_COMMAND_COALESCE_TIME);
+    applyLightCommands();
+    TEST_ASSERT_EQUAL(before.received + 1, getGroupControlStats().received);
+    TEST_ASSERT_EQUAL(500, getLedBrightness());
+
+    setGroupId(GROUP_ID_NONE);
+    send(makePacket(GROUP_ID_ALL, 450));
+    receive(1);
+    TEST_ASSERT_EQUAL(450, getLedBrightness());
+}
+
+// A start time on the synchronized clock delays the transition, so all lamps of a room start together
+static void test_start_time_delays_the_transition()
+{
+    timeSyncBegin();
+    nativeSntpSync();
+    GroupPacket packet = makePacket(1, 1000);
+    packet.startAt = getEpochMillis() + 500;
+    send(packet);
+    receive(1);
+    TEST_ASSERT_NOT_EQUAL(1000, getLedBrightness()); // Still waiting for the start time
+    delay(500);
+    applyLightCommands();
+    TEST_ASSERT_EQUAL(1000, getLedBrightness());
+}
+
+struct InstanceResult
+{
+    GroupControlStats stats;
+    bool power;
+    uint16_t brightness;
+};
+
+// Firmware instance in a child process, reports its counters and light once the parent closes the control pipe
+static void runInstance(uint16_t group, int ready, int control, int result)
+{
+    nativePreferencesClear();
+    groupControlInit();
+    setGroupId(group);
+    setLedBrightness(100, 0);
+    setLedPower(false, 0);
+    groupControlBegin();
+    char byte = 1;
+    (void)!write(ready, &byte, 1);
+
+    struct pollfd closed = {control, POLLIN, 0};
+    while (poll(&closed, 1, 1) == 0)
+    {
+        groupControlLoop();
+        delay(LIGHT_COMMAND_COALESCE_TIME);
+        applyLightCommands();
+    }
+    groupControlLoop();
+    delay(LIGHT_COMMAND_COALESCE_TIME);
+    applyLightCommands();
+    InstanceResult instance = {getGroupControlStats(), getLedPower(), getLedBrightness()};
+    (void)!write(result, &instance, sizeof(instance));
+    _exit(0);
+}
+
+// Several lamps on loopback multicast, one packet switches every member of a group and nothing else
+static void test_instances_apply_one_packet_together()
+{
+    const uint16_t groups[] = {1, 1, 1, 2, GROUP_ID_NONE};
+    const size_t count = sizeof(groups) / sizeof(groups[0]);
+    pid_t pids[count];
+    int controls[count];
+    int results[count];
+    for (size_t i = 0; i < count; i++)
+    {
+        int ready[2], control[2], result[2];
+        TEST_ASSERT_EQUAL(0, pipe(ready));
+        TEST_ASSERT_EQUAL(0, pipe(control));
+        TEST_ASSERT_EQUAL(0, pipe(result));
+        fflush(stdout);
+        pids[i] = fork();
+        if (pids[i] == 0)
+        {
+            for (size_t j = 0; j < i; j++) // Pipes of the earlier instances must close when the parent closes them
+            {
+                close(controls[j]);
+                close(results[j]);
+            }
+            close(control[1]);
+            runInstance(groups[i], ready[1], control[0], result[1]);
+        }
+        close(ready[1]);
+        close(control[0]);
+        close(result[1]);
+        char byte;
+        TEST_ASSERT_EQUAL(1, read(ready[0], &byte, 1)); // Joined the multicast group
+        close(ready[0]);
+        controls[i] = control[1];
+        results[i] = result[0];
+    }
+
+    GroupPacket scene = makePacket(1, 640);
+    for (int i = 0; i < 3; i++)
+    {
+        send(scene);
+    }
+    send(makePacket(2, 320));
+    GroupPacket all = makePacket(GROUP_ID_ALL, 0);
+    all.flags = GROUP_FLAG_POWER; // Everything off except the brightness
+    send(all);
+    usleep(200000);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        close(controls[i]);
+        InstanceResult instance;
+        TEST_ASSERT_EQUAL(sizeof(instance), read(results[i], &instance, sizeof(instance)));
+        close(results[i]);
+        int status;
+        waitpid(pids[i], &status, 0);
+        TEST_ASSERT_TRUE(WIFEXITED(status));
+
+        uint32_t received = groups[i] == GROUP_ID_NONE ? 1 : 2;
+        TEST_ASSERT_EQUAL(received, instance.stats.received);
+        TEST_ASSERT_EQUAL(groups[i] == 1 ? 2 : 0, instance.stats.duplicates);
+        TEST_ASSERT_EQUAL(0, instance.stats.invalid);
+        TEST_ASSERT_FALSE(instance.power);
+        uint16_t brightness = groups[i] == 1 ? 640 : (groups[i] == 2 ? 320 : 100);
+        TEST_ASSERT_EQUAL(brightness, instance.brightness);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    nativePreferencesClear();
+    ledInit();
+    groupControlInit();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_instances_apply_one_packet_together); // Forked before this process joins, the instances need sockets of their own
+    groupControlBegin();
+    RUN_TEST(test_packet_is_applied);
+    RUN_TEST(test_repeated_packets_are_dropped);
+    RUN_TEST(test_sequences_are_tracked_per_sender);
+    RUN_TEST(test_sender_slots_are_recycled);
+    RUN_TEST(test_invalid_packets_are_counted);
+    RUN_TEST(test_group_addressing);
+    RUN_TEST(test_start_time_delays_the_transition);
+    return UNITY_END();
+}
@@ -0,0 +1,305 @@
+#include "Network/haDiscovery.h"
+#include "Network/mqttTopics.h"
+#include "Network/fingerprint.h"
+#include "ChipID/chipID.h"
+
+#include <ArduinoJson.h>
+#include <nativeHeap.h>
+#include <string>
+#include <unity.h>
+
+// Collects a rendered payload
+class StringPrint : public Print
+{
+public:
+    std::string str;
+
+    size_t write(uint8_t c) override
+    {
+        str += (char)c;
+        return 1;
+    }
+};
+
+// Drops a rendered payload like the MQTT stream, without allocating
+class NullPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override { return 1; }
+    size_t write(const uint8_t *buffer, size_t size) override { return size; }
+};
+
+// Device discovery built with ArduinoJson the way it was before the templates, the rendered template must match it byte for byte
+static std::string buildDeviceReference()
+{
+    const MqttTopics &topics = getMqttTopics();
+    std::string id = ChipID::getChipID();
+    JsonDocument doc;
+
+    JsonObject device = doc["dev"].to<JsonObject>();
+    device["ids"] = id;
+    device["name"] = getDeviceName();
+    device["mf"] = "MarcusVoss";
+    device["mdl"] = MODELNAME;
+    device["sw"] = SW_VERSION;
+    device["sn"] = id;
+
+    JsonObject origin = doc["o"].to<JsonObject>();
+    origin["name"] = "MarcusVoss";
+
+    JsonObject components = doc["cmps"].to<JsonObject>();
+
+    JsonObject light = components["light"].to<JsonObject>();
+    light["p"] = "light";
+    light["name"] = "Light";
+    light["schema"] = "json";
+    light["device_class"] = "light";
+    light["brightness_scale"] = LED_MAX_VAL;
+    light["command_topic"] = topics.set;
+    light["availability_topic"] = topics.status;
+    JsonArray colorModes = light["supported_color_modes"].to<JsonArray>();
+    switch (LED_MODE)
+    {
+    case LED_MODES::SINGLE:
+        colorModes.add("brightness");
+        break;
+    case LED_MODES::CCT:
+        colorModes.add("color_temp");
+        light["max_mireds"] = MAX_MIREDS;
+        light["min_mireds"] = MIN_MIREDS;
+        break;
+    case LED_MODES::RGB:
+        colorModes.add("rgb");
+        break;
+    case LED_MODES::RGBW:
+        colorModes.add("rgbw");
+        break;
+    case LED_MODES::RGBWW:
+        colorModes.add("rgbww");
+        break;
+    }
+    light["state_topic"] = topics.light;
+    light["unique_id"] = id + "_light";
+
+    JsonObject diagnosticIP = components["diagIP"].to<JsonObject>();
+    diagnosticIP["p"] = "sensor";
+    diagnosticIP["name"] = "IP Address";
+    diagnosticIP["entity_category"] = "diagnostic";
+    diagnosticIP["unique_id"] = id + "_ip";
+    diagnosticIP["state_topic"] = topics.diagnostic;
+    diagnosticIP["value_template"] = "{{ value_json.ip }}";
+
+    JsonObject diagnosticRSSI = components["diagRSSI"].to<JsonObject>();
+    diagnosticRSSI["p"] = "sensor";
+    diagnosticRSSI["name"] = "RSSI";
+    diagnosticRSSI["device_class"] = "signal_strength";
+    diagnosticRSSI["entity_category"] = "diagnostic";
+    diagnosticRSSI["unique_id"] = id + "_rssi";
+    diagnosticRSSI["state_topic"] = topics.diagnostic;
+    diagnosticRSSI["unit_of_measurement"] = "dBm";
+    diagnosticRSSI["value_template"] = "{{ value_json.rssi }}";
+
+    JsonObject publishLatency = components["publishLatency"].to<JsonObject>();
+    publishLatency["p"] = "sensor";
+    publishLatency["name"] = "Publish Latency";
+    publishLatency["device_class"] = "duration";
+    publishLatency["entity_category"] = "diagnostic";
+    publishLatency["unique_id"] = id + "_publishLatency";
+    publishLatency["state_topic"] = topics.diagnostic;
+    publishLatency["unit_of_measurement"] = "ms";
+    publishLatency["value_template"] = "{{ value_json.publishLatency }}";
+    publishLatency["json_attributes_topic"] = topics.stats;
+
+#ifdef RF24RADIO_ENABLED
+    JsonObject radioChannel = components["radioChannel"].to<JsonObject>();
+    radioChannel["p"] = "sensor";
+    radioChannel["name"] = "Radio Channel";
+    radioChannel["entity_category"] = "diagnostic";
+    radioChannel["unique_id"] = id + "_radioChannel";
+    radioChannel["state_topic"] = topics.diagnostic;
+    radioChannel["value_template"] = "{{ value_json.radioChannel }}";
+
+    JsonObject radioAddress = components["radioAddress"].to<JsonObject>();
+    radioAddress["p"] = "sensor";
+    radioAddress["name"] = "Radio Address";
+    radioAddress["entity_category"] = "diagnostic";
+    radioAddress["unique_id"] = id + "_radioAddress";
+    radioAddress["state_topic"] = topics.diagnostic;
+    radioAddress["value_template"] = "{{ value_json.radioAddress }}";
+#endif
+
+    std::string payload;
+    serializeJson(doc, payload);
+    return payload;
+}
+
+static void addRemoteSensor(JsonObject components, const char *key, const char *name, const char *deviceClass,
+                            const char *unit, const std::string &remoteName)
+{
+    JsonObject sensor = components[key].to<JsonObject>();
+    sensor["p"] = "sensor";
+    sensor["name"] = name;
+    if (deviceClass != NULL)
+    {
+        sensor["device_class"] = deviceClass;
+    }
+    else
+    {
+        sensor["entity_category"] = "diagnostic";
+    }
+    if (strcmp(key, "lostFrames") == 0)
+    {
+        sensor["state_class"] = "total_increasing";
+    }
+    if (unit != NULL)
+    {
+        sensor["unit_of_measurement"] = unit;
+    }
+    sensor["unique_id"] = remoteName + "_" + key;
+    sensor["value_template"] = std::string("{{ value_json.") + key + " }}";
+}
+
+// Remote discovery built with ArduinoJson the way it was before the templates
+static std::string buildRemoteReference(const uint8_t *uuid)
+{
+    char uuidStr[9];
+    snprintf(uuidStr, sizeof(uuidStr), "%02X%02X%02X%02X", uuid[0], uuid[1], uuid[2], uuid[3]);
+    std::string remoteName = std::string("RF24-Remote-") + uuidStr;
+    JsonDocument doc;
+
+    JsonObject device = doc["dev"].to<JsonObject>();
+    device["ids"] = remoteName;
+    device["name"] = remoteName;
+    device["mf"] = "MarcusVoss";
+    device["mdl"] = "RF24-Remote";
+    device["state_topic"] = getMqttRemoteTopic(uuid);
+    device["schema"] = "json";
+
+    JsonObject origin = doc["o"].to<JsonObject>();
+    origin["name"] = "MarcusVoss";
+
+    JsonObject components = doc["cmps"].to<JsonObject>();
+    addRemoteSensor(components, "battery", "Battery", "battery", "%", remoteName);
+    addRemoteSensor(components, "batteryVoltage", "Battery Voltage", "voltage", "mV", remoteName);
+    addRemoteSensor(components, "lastSeenBy", "Last Seen By", NULL, NULL, remoteName);
+    addRemoteSensor(components, "linkQuality", "Link Quality", NULL, "%", remoteName);
+    addRemoteSensor(components, "lostFrames", "Lost Frames", NULL, NULL, remoteName);
+    addRemoteSensor(components, "strongSignal", "Strong Signal", NULL, "%", remoteName);
+
+    std::string payload;
+    serializeJson(doc, payload);
+    return payload;
+}
+
+// Render a discovery document and check size, content and fingerprint against the reference
+static void assertMatchesReference(BaseHaDiscovery &discovery, const std::string &reference)
+{
+    StringPrint out;
+    size_t written = discovery.writePayload(out);
+    TEST_ASSERT_EQUAL_STRING(reference.c_str(), out.str.c_str());
+    TEST_ASSERT_EQUAL(reference.size(), written);
+    TEST_ASSERT_EQUAL(reference.size(), discovery.getPayloadSize());
+    TEST_ASSERT_EQUAL_HEX32(fingerprint(reference.data(), reference.size()), discovery.getPayloadFingerprint());
+}
+
+void setUp()
+{
+    setDeviceName(MODELNAME);
+    mqttTopicsBuild("smartlamp");
+}
+
+void tearDown() {}
+
+static void test_device_discovery_matches_reference()
+{
+    HaDiscovery discovery;
+    assertMatchesReference(discovery, buildDeviceReference());
+    TEST_ASSERT_EQUAL_STRING(getMqttTopics().discovery, discovery.getTopic());
+}
+
+// Runtime values are escaped like ArduinoJson escapes strings
+static void test_device_discovery_escapes_runtime_values()
+{
+    setDeviceName("Lamp \"Desk\"\\\t\n\xC3\xA4/");
+    mqttTopicsBuild("smart\"lamp");
+    HaDiscovery discovery;
+    std::string reference = buildDeviceReference();
+    TEST_ASSERT_TRUE(reference.find("\\\"Desk\\\"\\\\\\t\\n") != std::string::npos);
+    assertMatchesReference(discovery, reference);
+}
+
+static void test_remote_discovery_matches_reference()
+{
+    const uint8_t uuid[4] = {0x01, 0xAB, 0x00, 0xFF};
+    RemoteHaDiscovery discovery(uuid);
+    assertMatchesReference(discovery, buildRemoteReference(uuid));
+    TEST_ASSERT_EQUAL_STRING("homeassistant/device/RF24-Remote-01AB00FF/config", discovery.getTopic());
+}
+
+static void test_fingerprint_follows_content()
+{
+    uint32_t initial = HaDiscovery().getPayloadFingerprint();
+    TEST_ASSERT_EQUAL_HEX32(initial, HaDiscovery().getPayloadFingerprint());
+
+    setDeviceName("Kitchen");
+    mqttTopicsBuild("smartlamp");
+    TEST_ASSERT_NOT_EQUAL(initial, HaDiscovery().getPayloadFingerprint());
+}
+
+struct HeapUse
+{
+    size_t allocations;
+    size_t peak; // Bytes
+};
+
+template <typename Build>
+static HeapUse measureHeap(Build build)
+{
+    size_t allocations = nativeHeapAllocations;
+    size_t inUse = nativeHeapInUse;
+    nativeHeapResetPeak();
+    build();
+    return {nativeHeapAllocations - allocations, nativeHeapPeak - inUse};
+}
+
+// Heap of one discovery publish, the ArduinoJson document with its serialized payload against the rendered template
+static void assertHeapReport(const char *name, BaseHaDiscovery &discovery, std::string (*buildReference)())
+{
+    HeapUse reference = measureHeap([&]()
+                                    { buildReference(); });
+    HeapUse rendered = measureHeap([&]()
+                                   {
+                                       NullPrint out;
+                                       discovery.getPayloadSize();
+                                       discovery.writePayload(out);
+                                   });
+    TEST_ASSERT_EQUAL(0, rendered.allocations);
+    TEST_ASSERT_GREATER_OR_EQUAL(discovery.getPayloadSize(), reference.peak); // At least the serialized payload
+
+    char message[200];
+    snprintf(message, sizeof(message), "%s discovery of %u bytes: ArduinoJson peak heap %u bytes in %u allocations, template %u bytes in %u allocations",
+             name, (unsigned)discovery.getPayloadSize(), (unsigned)reference.peak, (unsigned)reference.allocations,
+             (unsigned)rendered.peak, (unsigned)rendered.allocations);
+    TEST_MESSAGE(message);
+}
+
+static void test_rendering_does_not_allocate()
+{
+    static const uint8_t uuid[4] = {0x01, 0xAB, 0x00, 0xFF};
+    HaDiscovery device;
+    assertHeapReport("Device", device, buildDeviceReference);
+    RemoteHaDiscovery remote(uuid);
+    assertHeapReport("Remote", remote, []()
+                     { return buildRemoteReference(uuid); });
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_device_discovery_matches_reference);
+    RUN_TEST(test_device_discovery_escapes_runtime_values);
+    RUN_TEST(test_remote_discovery_matches_reference);
+    RUN_TEST(test_fingerprint_follows_content);
+    RUN_TEST(test_rendering_does_not_allocate);
+    return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include "RF/linkQuality.h"
+
+#include <unity.h>
+
+void setUp() {}
+void tearDown() {}
+
+static void test_perfect_link_across_msg_num_wrap()
+{
+    LinkQualityEstimator link;
+    for (int i = 0; i < 600; i++)
+    {
+        link.frameReceived(i & 0xFF);
+    }
+    TEST_ASSERT_EQUAL(100, link.getQuality());
+    TEST_ASSERT_EQUAL(600, link.getReceived());
+    TEST_ASSERT_EQUAL(0, link.getLost());
+    TEST_ASSERT_EQUAL(0, link.getDuplicates());
+}
+
+static void test_first_frame_starts_at_any_msg_num()
+{
+    LinkQualityEstimator link;
+    link.frameReceived(200);
+    link.frameReceived(201);
+    TEST_ASSERT_EQUAL(0, link.getLost());
+    TEST_ASSERT_EQUAL(100, link.getQuality());
+}
+
+// Every fourth frame is lost, the moving average settles around 75 %
+static void test_periodic_loss_converges()
+{
+    LinkQualityEstimator link;
+    uint8_t msgNum = 0;
+    for (int i = 0; i < 400; i++)
+    {
+        msgNum += (i % 3 == 0) ? 2 : 1;
+        link.frameReceived(msgNum);
+    }
+    TEST_ASSERT_EQUAL(133, link.getLost());
+    TEST_ASSERT_INT_WITHIN(8, 75, link.getQuality());
+}
+
+static void test_gap_counts_each_missing_frame()
+{
+    LinkQualityEstimator link;
+    link.frameReceived(250);
+    link.frameReceived(3); // 251 -> 2 missing across the wrap
+    TEST_ASSERT_EQUAL(8, link.getLost());
+    TEST_ASSERT_EQUAL(2, link.getReceived());
+    TEST_ASSERT_LESS_THAN(50, link.getQuality());
+}
+
+// A gap larger than LINK_QUALITY_MAX_GAP is a restarted remote, not a burst of losses
+static void test_large_gap_is_a_restart()
+{
+    LinkQualityEstimator link;
+    link.frameReceived(10);
+    link.frameReceived(10 + LINK_QUALITY_MAX_GAP + 1);
+    TEST_ASSERT_EQUAL(0, link.getLost());
+    TEST_ASSERT_EQUAL(100, link.getQuality());
+
+    link.frameReceived(10 + 2 * LINK_QUALITY_MAX_GAP + 1);
+    TEST_ASSERT_EQUAL(LINK_QUALITY_MAX_GAP - 1, link.getLost());
+}
+
+// A repeated MSG_NUM means the remote missed our ACK and sent the frame again
+static void test_duplicates_count_as_lost_samples()
+{
+    LinkQualityEstimator link;
+    link.frameReceived(1);
+    link.frameReceived(1);
+    link.frameReceived(1);
+    TEST_ASSERT_EQUAL(2, link.getDuplicates());
+    TEST_ASSERT_EQUAL(0, link.getLost());
+    TEST_ASSERT_EQUAL(77, link.getQuality()); // 100 * (7/8)^2
+}
+
+static void test_checksum_failures_count_as_lost_samples()
+{
+    LinkQualityEstimator link;
+    link.frameReceived(1);
+    link.checksumFailed();
+    TEST_ASSERT_EQUAL(1, link.getChecksumFailures());
+    TEST_ASSERT_EQUAL(88, link.getQuality()); // 100 * 7/8
+}
+
+static void test_recovers_after_an_outage()
+{
+    LinkQualityEstimator link;
+    uint8_t msgNum = 0;
+    link.frameReceived(msgNum);
+    for (int i = 0; i < 10; i++)
+    {
+        link.checksumFailed();
+    }
+    TEST_ASSERT_LESS_THAN(30, link.getQuality());
+    for (int i = 0; i < 40; i++)
+    {
+        link.frameReceived(++msgNum);
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(95, link.getQuality());
+}
+
+static void test_strong_signal_percentage()
+{
+    LinkQualityEstimator link;
+    TEST_ASSERT_EQUAL(0, link.getStrongSignalPercentage());
+    for (int i = 0; i < 10; i++)
+    {
+        link.signalSampled(i < 7);
+    }
+    TEST_ASSERT_EQUAL(70, link.getStrongSignalPercentage());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_perfect_link_across_msg_num_wrap);
+    RUN_TEST(test_first_frame_starts_at_any_msg_num);
+    RUN_TEST(test_periodic_loss_converges);
+    RUN_TEST(test_gap_counts_each_missing_frame);
+    RUN_TEST(test_large_gap_is_a_restart);
+    RUN_TEST(test_duplicates_count_as_lost_samples);
+    RUN_TEST(test_checksum_failures_count_as_lost_samples);
+    RUN_TEST(test_recovers_after_an_outage);
+    RUN_TEST(test_strong_signal_percentage);
+    return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include "Network/lightState.h"
+#include "Network/localApi.h"
+#include "Output/ledControl.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WebServer.h>
+#include <WebSocketsServer.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+// REST and WebSocket routes of the local API, requests are handed to the routes without TCP
+// The load test measures the time spent in the firmware per request, not the network or the WebServer library
+
+#define LOAD_REQUESTS 20000 // Requests of the load test
+#define LOAD_PUT_EVERY 10   // Every n-th request of the load test is a command
+
+static WebServer server;
+static WebSocketsServer *webSocket;
+
+static std::string getLightState()
+{
+    char state[LIGHT_STATE_SIZE];
+    size_t size = serializeLightState(state, sizeof(state));
+    return std::string(state, size);
+}
+
+// Applies the queued commands and hands the state change to the API like the network task does
+static void applyCommands()
+{
+    delay(LIGHT_COMMAND_COALESCE_TIME);
+    applyLightCommands();
+    Event event = {};
+    event.type = EventTypes::LED_STATE_CHANGED;
+    localApiHandleEvent(event);
+}
+
+void setUp()
+{
+    setLedPower(false, 0);
+}
+
+void tearDown()
+{
+    for (uint8_t client = 0; client < WEBSOCKETS_SERVER_CLIENT_MAX; client++)
+    {
+        if (webSocket->clients[client].connected)
+        {
+            webSocket->nativeDisconnect(client);
+        }
+    }
+}
+
+static void test_get_returns_the_light_state()
+{
+    TEST_ASSERT_EQUAL(200, server.request(HTTP_GET, "/api/light"));
+    TEST_ASSERT_EQUAL_STRING("application/json", server.responseType.c_str());
+    TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), server.response.c_str());
+}
+
+static void test_put_queues_the_command()
+{
+    TEST_ASSERT_EQUAL(202, server.request(HTTP_PUT, "/api/light", "{\"state\":\"ON\",\"brightness\":128,\"transition\":0}"));
+    applyCommands();
+    TEST_ASSERT_TRUE(getLedPower());
+    TEST_ASSERT_EQUAL(200, server.request(HTTP_GET, "/api/light"));
+    TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), server.response.c_str());
+}
+
+static void test_invalid_put_is_rejected()
+{
+    LightCommandStats before = getLightCommandStats();
+    TEST_ASSERT_EQUAL(400, server.request(HTTP_PUT, "/api/light", "{\"state\":"));
+    TEST_ASSERT_EQUAL(before.received, getLightCommandStats().received);
+}
+
+static void test_websocket_pushes_each_change_once()
+{
+    TEST_ASSERT_TRUE(webSocket->nativeConnect(0));
+    TEST_ASSERT_TRUE(webSocket->nativeConnect(1));
+    TEST_ASSERT_EQUAL(1, webSocket->clients[0].frames); // The state on connect
+    TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), webSocket->clients[0].last.c_str());
+
+    webSocket->nativeText(0, "{\"state\":\"ON\",\"transition\":0}");
+    applyCommands();
+    applyCommands(); // A second event without a change is not sent
+    localApiLoop();
+    TEST_ASSERT_EQUAL(2, webSocket->clients[0].frames);
+    TEST_ASSERT_EQUAL(2, webSocket->clients[1].frames);
+    TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), webSocket->clients[1].last.c_str());
+
+    webSocket->nativeText(1, "{\"state\":");
+    TEST_ASSERT_EQUAL_STRING("{\"error\":\"invalid light command\"}", webSocket->clients[1].last.c_str());
+}
+
+// Polling GET /api/light with every WebSocket client slot taken and a command every LOAD_PUT_EVERY requests
+static void test_request_latency_and_throughput()
+{
+    for (uint8_t client = 0; client < WEBSOCKETS_SERVER_CLIENT_MAX; client++)
+    {
+        webSocket->nativeConnect(client);
+    }
+    size_t broadcasts = webSocket->broadcasts;
+    std::vector<double> getLatencies;
+    std::vector<double> putLatencies;
+    double total = 0;
+    int changes = 0;
+    for (int i = 0; i < LOAD_REQUESTS; i++)
+    {
+        bool put = i % LOAD_PUT_EVERY == LOAD_PUT_EVERY - 1;
+        char body[64];
+        snprintf(body, sizeof(body), "{\"state\":\"ON\",\"brightness\":%i,\"transition\":0}", 10 + changes % 200);
+
+        auto start = std::chrono::steady_clock::now();
+        int code = put ? server.request(HTTP_PUT, "/api/light", body) : server.request(HTTP_GET, "/api/light");
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        total += us;
+        (put ? putLatencies : getLatencies).push_back(us);
+
+        if (put)
+        {
+            TEST_ASSERT_EQUAL(202, code);
+            applyCommands();
+            changes++;
+        }
+        else
+        {
+            TEST_ASSERT_EQUAL(200, code);
+            TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), server.response.c_str());
+        }
+    }
+    TEST_ASSERT_EQUAL(changes, webSocket->broadcasts - broadcasts); // One push per change, not per request or event
+    TEST_ASSERT_EQUAL_STRING(getLightState().c_str(), webSocket->clients[WEBSOCKETS_SERVER_CLIENT_MAX - 1].last.c_str());
+
+    std::sort(getLatencies.begin(), getLatencies.end());
+    std::sort(putLatencies.begin(), putLatencies.end());
+    double getP99 = getLatencies[getLatencies.size() * 99 / 100];
+    double putP99 = putLatencies[putLatencies.size() * 99 / 100];
+    char message[200];
+    snprintf(message, sizeof(message), "%i requests, GET p50 %.2f us p99 %.2f us, PUT p50 %.2f us p99 %.2f us, %.0f requests/s on the host",
+             LOAD_REQUESTS, getLatencies[getLatencies.size() / 2], getP99, putLatencies[putLatencies.size() / 2], putP99,
+             LOAD_REQUESTS / (total / 1000000));
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(1000, getP99);
+    TEST_ASSERT_LESS_THAN(1000, putP99);
+}
+
+int main(int argc, char **argv)
+{
+    nativePreferencesClear();
+    ledInit();
+    localApiRegister(server);
+    localApiBegin();
+    webSocket = nativeWebSocketsServer;
+
+    UNITY_BEGIN();
+    RUN_TEST(test_get_returns_the_light_state);
+    RUN_TEST(test_put_queues_the_command);
+    RUN_TEST(test_invalid_put_is_rejected);
+    RUN_TEST(test_websocket_pushes_each_change_once);
+    RUN_TEST(test_request_latency_and_throughput);
+    return UNITY_END();
+}
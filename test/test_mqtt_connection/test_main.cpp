@@ -0,0 +1,202 @@
+#include "ChipID/chipID.h"
+#include "Network/mqtt.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <nativeNetwork.h>
+#include <unity.h>
+
+// Steps of the firmware connection state machine against one broker on the in memory network
+// Every handleMQTTConnection call advances at most one step, the waits are polled across calls
+
+static NativeBroker broker("broker.local", "10.0.0.1", 1883);
+
+// One pass of the network task loop, returns how long handleMQTTConnection blocked
+static unsigned long step()
+{
+    unsigned long start = millis();
+    handleMQTTConnection();
+    unsigned long blocked = millis() - start;
+    nativeNetworkLoop();
+    return blocked;
+}
+
+// Runs the loop for the given time, returns the longest time a single call blocked
+static unsigned long run(unsigned long ms)
+{
+    unsigned long longest = 0;
+    unsigned long end = millis() + ms;
+    while (millis() < end)
+    {
+        longest = max(longest, step());
+        delay(1);
+    }
+    return longest;
+}
+
+static unsigned long runUntilOnline(unsigned long timeout)
+{
+    unsigned long start = millis();
+    while (!getMQTTConnected() && millis() - start <= timeout)
+    {
+        run(1);
+    }
+    return millis() - start;
+}
+
+static void begin(const char *server = "broker.local")
+{
+    mqttInit();
+    setMqttSettings(server, 1883, "", "", "smartlamp", "");
+}
+
+void setUp()
+{
+    nativeNetworkReset();
+    nativePreferencesClear();
+    broker.start();
+    broker.failSubscribe = false;
+    broker.connects = 0;
+}
+
+// Leave the lamp online, so the next test starts without backoff
+void tearDown()
+{
+    nativeNetworkReset();
+    broker.start();
+    broker.failSubscribe = false;
+    begin();
+    runUntilOnline(MQTT_RECONNECT_MAX_DELAY);
+    broker.loseSessions();
+}
+
+static void test_steps_from_resolve_to_online()
+{
+    const char *clientId = ChipID::getChipID();
+    begin();
+    size_t queries = nativeDnsQueryCount;
+    size_t connects = nativeConnectCount;
+
+    TEST_ASSERT_EQUAL(0, step()); // RESOLVE sends the DNS query
+    TEST_ASSERT_EQUAL(queries + 1, nativeDnsQueryCount);
+    TEST_ASSERT_EQUAL(0, step()); // No answer yet
+    delay(nativeNetworkLatency);
+    nativeNetworkLoop();
+    TEST_ASSERT_EQUAL(0, step()); // RESOLVE done
+    TEST_ASSERT_EQUAL(connects, nativeConnectCount);
+
+    TEST_ASSERT_EQUAL(0, step()); // TCP_CONNECT sends SYN
+    TEST_ASSERT_EQUAL(connects + 1, nativeConnectCount);
+    TEST_ASSERT_EQUAL(0, step()); // Handshake in progress
+    delay(nativeNetworkLatency);
+    TEST_ASSERT_EQUAL(0, step()); // TCP_CONNECT done
+    TEST_ASSERT_EQUAL(0, broker.connects);
+
+    TEST_ASSERT_EQUAL(0, step()); // CONNECT and CONNACK
+    TEST_ASSERT_TRUE(broker.isConnected(clientId));
+    TEST_ASSERT_FALSE(broker.isSubscribed(clientId, getMqttTopics().set));
+
+    TEST_ASSERT_EQUAL(0, step()); // SUBSCRIBE
+    TEST_ASSERT_TRUE(broker.isSubscribed(clientId, getMqttTopics().set));
+    TEST_ASSERT_TRUE(broker.isSubscribed(clientId, MQTT_HA_STATUS_TOPIC));
+
+    TEST_ASSERT_EQUAL(0, step()); // DISCOVERY is scheduled
+    TEST_ASSERT_EQUAL(0, broker.published[getMqttTopics().discovery]);
+    TEST_ASSERT_FALSE(getMQTTConnected());
+
+    TEST_ASSERT_EQUAL(0, step()); // ONLINE
+    TEST_ASSERT_TRUE(getMQTTConnected());
+    TEST_ASSERT_EQUAL_STRING("online", broker.retained[getMqttTopics().status].c_str());
+
+    TEST_ASSERT_EQUAL(0, step()); // CONNECTED publishes the scheduled discovery
+    TEST_ASSERT_EQUAL(1, broker.published[getMqttTopics().discovery]);
+}
+
+// A failed attempt backs off without a second broker, no connect is tried in the meantime
+static void assertBackoff()
+{
+    size_t connects = nativeConnectCount;
+    size_t queries = nativeDnsQueryCount;
+    run(MQTT_RECONNECT_INITIAL_DELAY / 2 - 100);
+    TEST_ASSERT_EQUAL(connects, nativeConnectCount);
+    TEST_ASSERT_EQUAL(queries, nativeDnsQueryCount);
+    TEST_ASSERT_FALSE(getMQTTConnected());
+}
+
+static void test_unknown_host_fails_without_connecting()
+{
+    size_t connects = nativeConnectCount;
+    begin("missing.local");
+    TEST_ASSERT_EQUAL(0, run(10 * nativeNetworkLatency));
+    TEST_ASSERT_EQUAL(connects, nativeConnectCount);
+    assertBackoff();
+}
+
+// The loop keeps running while the DNS server does not answer
+static void test_dns_timeout_does_not_block()
+{
+    nativeDnsSetAnswers("broker.local", false);
+    size_t connects = nativeConnectCount;
+    begin();
+    TEST_ASSERT_EQUAL(0, run(MQTT_CONNECT_TIMEOUT + 10));
+    TEST_ASSERT_EQUAL(connects, nativeConnectCount);
+    assertBackoff();
+}
+
+static void test_refused_connect_fails_after_one_round_trip()
+{
+    broker.stop();
+    begin();
+    TEST_ASSERT_EQUAL(0, run(10 * nativeNetworkLatency));
+    TEST_ASSERT_EQUAL(0, broker.connects);
+    assertBackoff();
+}
+
+// The loop keeps running while the TCP handshake gets no answer
+static void test_tcp_connect_timeout_does_not_block()
+{
+    broker.blackhole = true;
+    begin();
+    TEST_ASSERT_EQUAL(0, run(MQTT_CONNECT_TIMEOUT - 100));
+    TEST_ASSERT_EQUAL(0, broker.connects);
+    TEST_ASSERT_EQUAL(0, run(200));
+    assertBackoff();
+}
+
+// PubSubClient waits for CONNACK, so a broker that accepts the socket but never answers blocks one call
+// for the socket timeout, MQTT_CONNECT_TIMEOUT
+static void test_missing_connack_blocks_for_the_connect_timeout()
+{
+    broker.answersConnect = false;
+    begin();
+    TEST_ASSERT_EQUAL(MQTT_CONNECT_TIMEOUT, run(10 * nativeNetworkLatency));
+    TEST_ASSERT_FALSE(broker.isConnected(ChipID::getChipID()));
+    assertBackoff();
+}
+
+static void test_failed_subscribe_closes_the_connection()
+{
+    broker.failSubscribe = true;
+    begin();
+    run(10 * nativeNetworkLatency);
+    TEST_ASSERT_EQUAL(1, broker.connects);
+    TEST_ASSERT_FALSE(broker.isConnected(ChipID::getChipID()));
+    assertBackoff();
+
+    broker.failSubscribe = false;
+    TEST_ASSERT_LESS_OR_EQUAL(MQTT_RECONNECT_INITIAL_DELAY, runUntilOnline(MQTT_RECONNECT_INITIAL_DELAY));
+}
+
+int main(int argc, char **argv)
+{
+    nativeMillis = 1000; // WiFi is up a while after boot, the connection timers use 0 for not started
+    UNITY_BEGIN();
+    RUN_TEST(test_steps_from_resolve_to_online);
+    RUN_TEST(test_unknown_host_fails_without_connecting);
+    RUN_TEST(test_dns_timeout_does_not_block);
+    RUN_TEST(test_refused_connect_fails_after_one_round_trip);
+    RUN_TEST(test_tcp_connect_timeout_does_not_block);
+    RUN_TEST(test_missing_connack_blocks_for_the_connect_timeout);
+    RUN_TEST(test_failed_subscribe_closes_the_connection);
+    return UNITY_END();
+}
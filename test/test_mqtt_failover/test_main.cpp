@@ -0,0 +1,176 @@
+#include "ChipID/chipID.h"
+#include "Network/mqtt.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <nativeNetwork.h>
+#include <string>
+#include <unity.h>
+
+// The firmware connection state machine against a primary and a backup broker on the in memory network
+
+static NativeBroker primary("primary.local", "10.0.0.1", 1883);
+static NativeBroker backup("backup.local", "10.0.0.2", 1883);
+
+// Loop of the network task for the given time
+static void run(unsigned long ms)
+{
+    unsigned long end = millis() + ms;
+    while (millis() < end)
+    {
+        handleMQTTConnection();
+        nativeNetworkLoop();
+        delay(1);
+    }
+}
+
+// Runs until the lamp is online on broker, returns the time it took or timeout + 1
+static unsigned long runUntilOnline(NativeBroker &broker, unsigned long timeout)
+{
+    unsigned long start = millis();
+    while (millis() - start <= timeout)
+    {
+        if (getMQTTConnected() && broker.isConnected(ChipID::getChipID()))
+        {
+            return millis() - start;
+        }
+        run(1);
+    }
+    return timeout + 1;
+}
+
+static void begin()
+{
+    mqttInit();
+    setMqttSettings("primary.local", 1883, "", "", "smartlamp", "backup.local:1883");
+}
+
+void setUp()
+{
+    nativeNetworkReset();
+    nativePreferencesClear();
+    primary.start();
+    backup.start();
+    primary.connects = 0;
+    backup.connects = 0;
+}
+
+// Leave the lamp online on the primary broker, so the next test starts without backoff
+void tearDown()
+{
+    primary.start();
+    backup.start();
+    runUntilOnline(primary, MQTT_RECONNECT_MAX_DELAY + MQTT_PRIMARY_PROBE_INTERVAL);
+    primary.loseSessions();
+    backup.loseSessions();
+}
+
+static void test_connects_to_the_primary_broker()
+{
+    begin();
+    TEST_ASSERT_LESS_THAN(100, runUntilOnline(primary, 1000));
+    TEST_ASSERT_EQUAL_STRING("primary.local", getMqttActiveBroker());
+    TEST_ASSERT_EQUAL_STRING("online", primary.retained[getMqttTopics().status].c_str());
+    TEST_ASSERT_EQUAL(0, backup.connects);
+}
+
+// A refused connect moves on to the backup broker right away, without waiting for a backoff
+static void test_refused_primary_fails_over_within_one_attempt()
+{
+    primary.stop();
+    begin();
+    TEST_ASSERT_LESS_THAN(100, runUntilOnline(backup, MQTT_RECONNECT_INITIAL_DELAY));
+    TEST_ASSERT_EQUAL_STRING("backup.local", getMqttActiveBroker());
+    TEST_ASSERT_EQUAL(1, backup.connects);
+}
+
+// A primary that drops the handshake costs one connect timeout before the backup broker is used
+static void test_unreachable_primary_fails_over_after_the_connect_timeout()
+{
+    primary.blackhole = true;
+    begin();
+    unsigned long time = runUntilOnline(backup, MQTT_RECONNECT_INITIAL_DELAY);
+    TEST_ASSERT_GREATER_OR_EQUAL(MQTT_CONNECT_TIMEOUT, time);
+    TEST_ASSERT_LESS_THAN(MQTT_CONNECT_TIMEOUT + 100, time);
+}
+
+// The reconnect only backs off once every broker failed, the next round starts with the primary broker
+static void test_backoff_after_every_broker_failed_once()
+{
+    primary.stop();
+    backup.stop();
+    begin();
+    size_t connects = nativeConnectCount;
+    run(100);
+    TEST_ASSERT_EQUAL(2, nativeConnectCount - connects);
+
+    run(MQTT_RECONNECT_INITIAL_DELAY / 2 - 100);
+    TEST_ASSERT_EQUAL(2, nativeConnectCount - connects);
+
+    primary.start();
+    TEST_ASSERT_LESS_THAN(MQTT_RECONNECT_INITIAL_DELAY, runUntilOnline(primary, MQTT_RECONNECT_INITIAL_DELAY));
+    TEST_ASSERT_EQUAL(0, backup.connects);
+}
+
+// A single dropped connection is retried on the same broker and does not count as a failure
+static void test_single_drop_reconnects_to_the_same_broker()
+{
+    begin();
+    runUntilOnline(primary, 1000);
+    primary.forceDisconnect(ChipID::getChipID());
+    TEST_ASSERT_EQUAL_STRING("offline", primary.retained[getMqttTopics().status].c_str()); // Will of the lamp
+
+    TEST_ASSERT_LESS_THAN(100, runUntilOnline(primary, 1000));
+    TEST_ASSERT_EQUAL(2, primary.connects);
+    TEST_ASSERT_EQUAL(0, backup.connects);
+}
+
+// A drop whose reconnect fails moves on to the backup broker right away
+static void test_failed_reconnect_after_a_drop_fails_over()
+{
+    begin();
+    runUntilOnline(primary, 1000);
+    primary.stop();
+    TEST_ASSERT_LESS_THAN(100, runUntilOnline(backup, 1000));
+}
+
+// The primary broker is probed while the backup connection keeps delivering commands
+static void test_returns_to_the_primary_without_blocking()
+{
+    primary.stop();
+    begin();
+    runUntilOnline(backup, 1000);
+
+    primary.start();
+    primary.blackhole = true; // The probe stays pending until its timeout
+    size_t connects = nativeConnectCount;
+    run(MQTT_PRIMARY_PROBE_INTERVAL + 10);
+    TEST_ASSERT_EQUAL(1, nativeConnectCount - connects);
+
+    size_t delivered = backup.publishesOut;
+    backup.publish(getMqttTopics().set, "{\"state\":\"ON\"}");
+    run(10);
+    TEST_ASSERT_EQUAL(delivered + 1, backup.publishesOut);
+    TEST_ASSERT_TRUE(getMQTTConnected());
+
+    run(MQTT_PRIMARY_PROBE_TIMEOUT);
+    TEST_ASSERT_EQUAL_STRING("backup.local", getMqttActiveBroker()); // Probe timed out
+
+    primary.blackhole = false;
+    TEST_ASSERT_LESS_THAN(MQTT_PRIMARY_PROBE_INTERVAL, runUntilOnline(primary, MQTT_PRIMARY_PROBE_INTERVAL));
+    TEST_ASSERT_FALSE(backup.isConnected(ChipID::getChipID()));
+}
+
+int main(int argc, char **argv)
+{
+    nativeMillis = 1000; // WiFi is up a while after boot, the connection timers use 0 for not started
+    UNITY_BEGIN();
+    RUN_TEST(test_connects_to_the_primary_broker);
+    RUN_TEST(test_refused_primary_fails_over_within_one_attempt);
+    RUN_TEST(test_unreachable_primary_fails_over_after_the_connect_timeout);
+    RUN_TEST(test_backoff_after_every_broker_failed_once);
+    RUN_TEST(test_single_drop_reconnects_to_the_same_broker);
+    RUN_TEST(test_failed_reconnect_after_a_drop_fails_over);
+    RUN_TEST(test_returns_to_the_primary_without_blocking);
+    return UNITY_END();
+}
@@ -0,0 +1,179 @@
+#include "ChipID/chipID.h"
+#include "Network/mqtt.h"
+#include "Output/ledControl.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <nativeNetwork.h>
+#include <string>
+#include <unity.h>
+
+// Broker fan-out of broadcast and group commands to a fleet, compared with one publish per lamp
+// The firmware lamp subscribes through the connection state machine, the rest of the fleet are sessions
+// with the same subscriptions under their own chip ID
+
+#define FLEET_SIZE 200
+
+static NativeBroker broker("broker.local", "10.0.0.1", 1883);
+static const char *COMMAND = "{\"state\":\"OFF\",\"transition\":2}";
+
+static void run(unsigned long ms)
+{
+    unsigned long end = millis() + ms;
+    while (millis() < end)
+    {
+        handleMQTTConnection();
+        nativeNetworkLoop();
+        delay(1);
+    }
+}
+
+static std::string replaceAll(std::string text, const std::string &from, const std::string &to)
+{
+    for (size_t pos = text.find(from); pos != std::string::npos; pos = text.find(from, pos + to.size()))
+    {
+        text.replace(pos, from.size(), to);
+    }
+    return text;
+}
+
+static std::string getLampId(int lamp)
+{
+    return lamp == 0 ? ChipID::getChipID() : "SIM-Lamp-" + std::to_string(lamp);
+}
+
+// Every second lamp is in the kitchen group, like the firmware lamp
+static void connectFleet()
+{
+    std::string firmwareId = ChipID::getChipID();
+    std::string kitchen = getMqttTopics().groups[0];
+    for (int lamp = 1; lamp < FLEET_SIZE; lamp++)
+    {
+        std::string id = getLampId(lamp);
+        broker.connect(id, false);
+        for (const std::string &topic : broker.getSubscriptions(firmwareId))
+        {
+            if (topic != kitchen || lamp % 2 == 0)
+            {
+                broker.subscribe(id, replaceAll(topic, firmwareId, id));
+            }
+        }
+    }
+}
+
+static void deliverFleet()
+{
+    for (int lamp = 1; lamp < FLEET_SIZE; lamp++)
+    {
+        broker.deliver(getLampId(lamp));
+    }
+}
+
+struct FanOut
+{
+    size_t publishesIn;
+    size_t bytesIn;
+    size_t publishesOut;
+    size_t bytesOut;
+};
+
+// Publishes of Home Assistant on the given topics and what the broker delivered for them
+static FanOut publish(const std::vector<std::string> &topics)
+{
+    FanOut before = {broker.publishesIn, broker.bytesIn, broker.publishesOut, broker.bytesOut};
+    for (const std::string &topic : topics)
+    {
+        broker.publish(topic, COMMAND);
+    }
+    size_t received = getLightCommandStats().received;
+    run(10);
+    deliverFleet();
+    TEST_ASSERT_EQUAL(received + 1, getLightCommandStats().received); // The firmware lamp got the command once
+    return {broker.publishesIn - before.publishesIn, broker.bytesIn - before.bytesIn, broker.publishesOut - before.publishesOut,
+            broker.bytesOut - before.bytesOut};
+}
+
+static void report(const char *name, int lamps, const FanOut &shared, const FanOut &perDevice)
+{
+    printf("%s to %i lamps: %u publishes with %u bytes from Home Assistant instead of %u with %u bytes, "
+           "%u deliveries with %u bytes instead of %u with %u bytes\n",
+           name, lamps, (unsigned)shared.publishesIn, (unsigned)shared.bytesIn,
+           (unsigned)perDevice.publishesIn, (unsigned)perDevice.bytesIn, (unsigned)shared.publishesOut, (unsigned)shared.bytesOut,
+           (unsigned)perDevice.publishesOut, (unsigned)perDevice.bytesOut);
+}
+
+void setUp()
+{
+    nativePreferencesClear();
+    mqttInit();
+    setMqttSettings("broker.local", 1883, "", "", "smartlamp", "");
+    setMqttGroups("kitchen");
+    run(MQTT_REPLAY_WINDOW + 100); // Commands right after connecting may have been queued before the boot
+    TEST_ASSERT_TRUE(getMQTTConnected());
+    connectFleet();
+}
+
+void tearDown()
+{
+    broker.loseSessions();
+}
+
+// One publish on <base>/all/set reaches every lamp, one publish per lamp sends FLEET_SIZE frames from Home Assistant
+static void test_broadcast_fan_out()
+{
+    FanOut shared = publish({getMqttTopics().all});
+    TEST_ASSERT_EQUAL(1, shared.publishesIn);
+    TEST_ASSERT_EQUAL(FLEET_SIZE, shared.publishesOut);
+
+    std::vector<std::string> topics;
+    for (int lamp = 0; lamp < FLEET_SIZE; lamp++)
+    {
+        topics.push_back(replaceAll(getMqttTopics().set, ChipID::getChipID(), getLampId(lamp)));
+    }
+    FanOut perDevice = publish(topics);
+    TEST_ASSERT_EQUAL(FLEET_SIZE, perDevice.publishesIn);
+    TEST_ASSERT_EQUAL(FLEET_SIZE, perDevice.publishesOut);
+    TEST_ASSERT_LESS_THAN(perDevice.bytesIn / 100, shared.bytesIn);
+    report("Broadcast", FLEET_SIZE, shared, perDevice);
+}
+
+// One publish on <base>/group/<name>/set reaches the members of the group only
+static void test_group_fan_out()
+{
+    FanOut shared = publish({getMqttTopics().groups[0]});
+    TEST_ASSERT_EQUAL(1, shared.publishesIn);
+    TEST_ASSERT_EQUAL(FLEET_SIZE / 2, shared.publishesOut);
+
+    std::vector<std::string> topics;
+    for (int lamp = 0; lamp < FLEET_SIZE; lamp += 2)
+    {
+        topics.push_back(replaceAll(getMqttTopics().set, ChipID::getChipID(), getLampId(lamp)));
+    }
+    FanOut perDevice = publish(topics);
+    TEST_ASSERT_EQUAL(FLEET_SIZE / 2, perDevice.publishesIn);
+    TEST_ASSERT_EQUAL(FLEET_SIZE / 2, perDevice.publishesOut);
+    report("Group", FLEET_SIZE / 2, shared, perDevice);
+}
+
+// Changing the groups changes the subscriptions on the open connection
+static void test_group_change_keeps_the_connection()
+{
+    size_t connects = broker.connects;
+    std::string kitchen = getMqttTopics().groups[0];
+    setMqttGroups("living");
+    TEST_ASSERT_EQUAL(connects, broker.connects);
+    TEST_ASSERT_TRUE(getMQTTConnected());
+    TEST_ASSERT_FALSE(broker.isSubscribed(ChipID::getChipID(), kitchen));
+    TEST_ASSERT_TRUE(broker.isSubscribed(ChipID::getChipID(), getMqttTopics().groups[0]));
+    setMqttGroups("kitchen");
+}
+
+int main(int argc, char **argv)
+{
+    nativeMillis = 1000; // WiFi is up a while after boot, the connection timers use 0 for not started
+    UNITY_BEGIN();
+    RUN_TEST(test_broadcast_fan_out);
+    RUN_TEST(test_group_fan_out);
+    RUN_TEST(test_group_change_keeps_the_connection);
+    return UNITY_END();
+}
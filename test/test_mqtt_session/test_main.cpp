@@ -0,0 +1,306 @@
+#include "Network/mqttSession.h"
+#include "Network/mqttTopics.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <nativeNetwork.h>
+#include <string>
+#include <unity.h>
+
+static const char *CLIENT_ID = "lamp-ABCDEF";
+static const char *SERVER = "broker.local";
+static NativeBroker broker; // Driven directly, without the firmware connection state machine
+static std::vector<std::string> applied; // Payloads of the commands that passed the filters
+
+static bool changeSubscription(const char *topic, bool subscribe)
+{
+    if (subscribe)
+    {
+        return broker.subscribe(CLIENT_ID, topic);
+    }
+    broker.unsubscribe(CLIENT_ID, topic);
+    return true;
+}
+
+// The command topics the way mqttSubscribeCommands lists them
+static bool subscribeCommands(bool resubscribe = true)
+{
+    const MqttTopics &topics = getMqttTopics();
+    const char *list[MQTT_SESSION_MAX_TOPICS];
+    uint8_t count = 0;
+    list[count++] = topics.set;
+    list[count++] = topics.config;
+    list[count++] = MQTT_HA_STATUS_TOPIC;
+    list[count++] = topics.all;
+    for (uint8_t i = 0; i < topics.groupCount; i++)
+    {
+        list[count++] = topics.groups[i];
+    }
+    return mqttSessionSubscribe(SERVER, list, count, resubscribe, changeSubscription);
+}
+
+// CONNECT, CONNACK and SUBSCRIBE like the connection state machine
+static bool connect()
+{
+    broker.connect(CLIENT_ID, MQTT_CLEAN_SESSION);
+    mqttSessionOnline();
+    return subscribeCommands();
+}
+
+static void disconnect()
+{
+    broker.forceDisconnect(CLIENT_ID);
+    mqttSessionOffline();
+}
+
+// Delivered messages go through the same filters as mqttCallback, "start" payloads carry a start time in the past
+static void receive(unsigned long startAge = 0)
+{
+    for (const NativeMessage &message : broker.deliver(CLIENT_ID))
+    {
+        if (!mqttSessionIsSubscribed(message.topic.c_str()))
+        {
+            continue;
+        }
+        LightCommand command;
+        if (message.payload == "start")
+        {
+            command.hasStartTime = true;
+            command.startTime = millis() - startAge;
+        }
+        if (!mqttSessionIsStale(command))
+        {
+            applied.push_back(message.payload);
+        }
+    }
+}
+
+void setUp()
+{
+    applied.clear();
+    mqttTopicsBuildGroups("");
+    mqttTopicsBuild("smartlamp");
+    delay(MQTT_REPLAY_WINDOW); // Leave the replay window of the previous test
+}
+
+void tearDown()
+{
+    disconnect();
+}
+
+// After a reboot the offline time is unknown, so commands the broker queued before are not applied
+static void test_commands_queued_before_boot_are_dropped()
+{
+    nativeMillis = 5000;
+    broker.connect(CLIENT_ID, false);
+    broker.forceDisconnect(CLIENT_ID);
+    broker.subscribe(CLIENT_ID, getMqttTopics().set);
+    broker.publish(getMqttTopics().set, "queued");
+
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(0, applied.size());
+    TEST_ASSERT_EQUAL(1, mqttSessionGetStaleCount());
+
+    delay(MQTT_REPLAY_WINDOW);
+    broker.publish(getMqttTopics().set, "live");
+    receive();
+    TEST_ASSERT_EQUAL(1, applied.size());
+}
+
+static void test_short_outage_replays_queued_commands()
+{
+    TEST_ASSERT_TRUE(connect());
+    disconnect();
+    broker.publish(getMqttTopics().set, "while offline");
+    delay(MQTT_COMMAND_MAX_AGE / 2);
+
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(1, applied.size());
+    TEST_ASSERT_EQUAL_STRING("while offline", applied[0].c_str());
+}
+
+static void test_long_outage_drops_queued_commands()
+{
+    TEST_ASSERT_TRUE(connect());
+    disconnect();
+    broker.publish(getMqttTopics().set, "while offline");
+    delay(MQTT_COMMAND_MAX_AGE + 1);
+
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(0, applied.size());
+
+    delay(MQTT_REPLAY_WINDOW);
+    broker.publish(getMqttTopics().set, "live");
+    receive();
+    TEST_ASSERT_EQUAL(1, applied.size());
+}
+
+// Failed reconnect attempts do not move the time the connection was lost
+static void test_failed_attempts_count_as_offline_time()
+{
+    TEST_ASSERT_TRUE(connect());
+    disconnect();
+    broker.publish(getMqttTopics().set, "while offline");
+    for (int i = 0; i < 4; i++)
+    {
+        delay(MQTT_COMMAND_MAX_AGE / 3);
+        mqttSessionOffline(); // CONNECT failed
+    }
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(0, applied.size());
+}
+
+// A start time gives the exact age of a command, inside and outside the replay window
+static void test_start_time_decides_the_age()
+{
+    TEST_ASSERT_TRUE(connect());
+    disconnect();
+    broker.publish(getMqttTopics().set, "start");
+    delay(MQTT_COMMAND_MAX_AGE + 1);
+    TEST_ASSERT_TRUE(connect());
+    receive(1000);
+    TEST_ASSERT_EQUAL(1, applied.size());
+
+    delay(MQTT_REPLAY_WINDOW);
+    broker.publish(getMqttTopics().set, "start");
+    receive(MQTT_COMMAND_MAX_AGE + 1);
+    TEST_ASSERT_EQUAL(1, applied.size());
+}
+
+// A new base topic unsubscribes the old topics, commands the broker queued on them are ignored
+static void test_base_topic_change_unsubscribes_old_topics()
+{
+    TEST_ASSERT_TRUE(connect());
+    std::string oldSet = getMqttTopics().set;
+    std::string oldAll = getMqttTopics().all;
+    disconnect();
+    broker.publish(oldSet, "old topic");
+
+    mqttTopicsBuild("lamps");
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(0, applied.size());
+    TEST_ASSERT_FALSE(broker.isSubscribed(CLIENT_ID, oldSet));
+    TEST_ASSERT_FALSE(broker.isSubscribed(CLIENT_ID, oldAll));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().set));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, MQTT_HA_STATUS_TOPIC));
+
+    broker.publish(oldSet, "old topic");
+    delay(MQTT_REPLAY_WINDOW);
+    broker.publish(getMqttTopics().set, "new topic");
+    receive();
+    TEST_ASSERT_EQUAL(1, applied.size());
+    TEST_ASSERT_EQUAL_STRING("new topic", applied[0].c_str());
+}
+
+// A subscribe that fails keeps the stored topics, so the next connection still unsubscribes the old ones
+static void test_failed_subscribe_keeps_old_topics_for_cleanup()
+{
+    TEST_ASSERT_TRUE(connect());
+    std::string oldSet = getMqttTopics().set;
+    disconnect();
+
+    mqttTopicsBuild("lamps");
+    broker.failSubscribe = true;
+    broker.connect(CLIENT_ID, false);
+    mqttSessionOnline();
+    TEST_ASSERT_FALSE(subscribeCommands());
+    disconnect();
+    broker.failSubscribe = false;
+
+    TEST_ASSERT_TRUE(connect());
+    TEST_ASSERT_FALSE(broker.isSubscribed(CLIENT_ID, oldSet));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().set));
+}
+
+// A broker that lost the session gets every topic again, the stored list alone would skip them
+static void test_lost_session_is_subscribed_again()
+{
+    TEST_ASSERT_TRUE(connect());
+    disconnect();
+    broker.loseSessions();
+    TEST_ASSERT_TRUE(connect());
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().set));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().config));
+}
+
+// Like setMqttGroups on an open connection, only the changed groups are sent to the broker
+static void test_group_change_while_connected()
+{
+    mqttTopicsBuildGroups("kitchen,living");
+    TEST_ASSERT_TRUE(connect());
+    std::string kitchen = getMqttTopics().groups[0];
+    std::string living = getMqttTopics().groups[1];
+
+    size_t subscribes = broker.subscribes;
+    size_t unsubscribes = broker.unsubscribes;
+    mqttTopicsBuildGroups("living,upstairs");
+    TEST_ASSERT_TRUE(subscribeCommands(false));
+    TEST_ASSERT_EQUAL(1, broker.subscribes - subscribes);
+    TEST_ASSERT_EQUAL(1, broker.unsubscribes - unsubscribes);
+    TEST_ASSERT_FALSE(broker.isSubscribed(CLIENT_ID, kitchen));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, living));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().groups[1]));
+}
+
+// Like setMqttGroups while offline, the removed group is unsubscribed with the next connection
+static void test_group_removed_while_disconnected()
+{
+    mqttTopicsBuildGroups("kitchen,living");
+    TEST_ASSERT_TRUE(connect());
+    std::string kitchen = getMqttTopics().groups[0];
+    disconnect();
+    broker.publish(kitchen, "kitchen group");
+
+    mqttTopicsBuildGroups("living");
+    delay(MQTT_COMMAND_MAX_AGE / 2);
+    TEST_ASSERT_TRUE(connect());
+    receive();
+    TEST_ASSERT_EQUAL(0, applied.size());
+    TEST_ASSERT_FALSE(broker.isSubscribed(CLIENT_ID, kitchen));
+    TEST_ASSERT_TRUE(broker.isSubscribed(CLIENT_ID, getMqttTopics().groups[0]));
+}
+
+static size_t countStoredSessions()
+{
+    size_t stored = 0;
+    for (const auto &value : nativePreferences)
+    {
+        stored += value.first.rfind("mqtt_session/", 0) == 0;
+    }
+    return stored;
+}
+
+// Each broker has its own session, so the subscriptions are stored per broker
+static void test_subscriptions_are_stored_per_broker()
+{
+    nativePreferencesClear();
+    TEST_ASSERT_TRUE(connect());
+    TEST_ASSERT_EQUAL(1, countStoredSessions());
+
+    const MqttTopics &topics = getMqttTopics();
+    const char *list[] = {topics.set};
+    TEST_ASSERT_TRUE(mqttSessionSubscribe("backup.local", list, 1, true, changeSubscription));
+    TEST_ASSERT_EQUAL(2, countStoredSessions());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_commands_queued_before_boot_are_dropped);
+    RUN_TEST(test_short_outage_replays_queued_commands);
+    RUN_TEST(test_long_outage_drops_queued_commands);
+    RUN_TEST(test_failed_attempts_count_as_offline_time);
+    RUN_TEST(test_start_time_decides_the_age);
+    RUN_TEST(test_base_topic_change_unsubscribes_old_topics);
+    RUN_TEST(test_failed_subscribe_keeps_old_topics_for_cleanup);
+    RUN_TEST(test_lost_session_is_subscribed_again);
+    RUN_TEST(test_group_change_while_connected);
+    RUN_TEST(test_group_removed_while_disconnected);
+    RUN_TEST(test_subscriptions_are_stored_per_broker);
+    return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include "ChipID/chipID.h"
+#include "Network/mqttTopics.h"
+
+#include <Arduino.h>
+#include <chrono>
+#include <nativeHeap.h>
+#include <unity.h>
+
+// The topic table against the String concatenation the topics were built with on every publish before
+
+static const uint8_t REMOTE_UUID[4] = {0x0A, 0x1B, 0x2C, 0x3D};
+
+static String getDeviceTopic(const char *base)
+{
+    return String(base) + "/" + ChipID::getChipID();
+}
+
+static String getRemoteName()
+{
+    char uuid[9];
+    snprintf(uuid, sizeof(uuid), "%02X%02X%02X%02X", REMOTE_UUID[0], REMOTE_UUID[1], REMOTE_UUID[2], REMOTE_UUID[3]);
+    return String("RF24-Remote-") + uuid;
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+static void assertTopics(const char *base)
+{
+    mqttTopicsBuild(base);
+    mqttTopicsBuildGroups("kitchen, living room");
+    const MqttTopics &topics = getMqttTopics();
+    TEST_ASSERT_EQUAL_STRING(getDeviceTopic(base).c_str(), topics.device);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/light").c_str(), topics.light);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/diagnostic").c_str(), topics.diagnostic);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/stats").c_str(), topics.stats);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/status").c_str(), topics.status);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/set").c_str(), topics.set);
+    TEST_ASSERT_EQUAL_STRING((getDeviceTopic(base) + "/config/set").c_str(), topics.config);
+    TEST_ASSERT_EQUAL_STRING((String(base) + "/all/set").c_str(), topics.all);
+    TEST_ASSERT_EQUAL(2, topics.groupCount);
+    TEST_ASSERT_EQUAL_STRING((String(base) + "/group/kitchen/set").c_str(), topics.groups[0]);
+    TEST_ASSERT_EQUAL_STRING((String(base) + "/group/living room/set").c_str(), topics.groups[1]);
+    TEST_ASSERT_EQUAL_STRING((String("homeassistant/device/") + ChipID::getChipID() + "/config").c_str(), topics.discovery);
+    TEST_ASSERT_EQUAL_STRING((String(base) + "/" + getRemoteName()).c_str(), getMqttRemoteTopic(REMOTE_UUID));
+    TEST_ASSERT_EQUAL_STRING(("homeassistant/device/" + getRemoteName() + "/config").c_str(), getMqttRemoteDiscoveryTopic(REMOTE_UUID));
+}
+
+static void test_topics_match_the_concatenated_topics()
+{
+    assertTopics("smartlamp");
+    assertTopics("home/first floor/lights");
+}
+
+// A base topic change rebuilds the remote topics as well
+static void test_base_topic_change_rebuilds_remote_topics()
+{
+    mqttTopicsBuild("smartlamp");
+    const char *before = getMqttRemoteTopic(REMOTE_UUID);
+    TEST_ASSERT_EQUAL_STRING(("smartlamp/" + getRemoteName()).c_str(), before);
+    mqttTopicsBuild("lights");
+    TEST_ASSERT_EQUAL_STRING(("lights/" + getRemoteName()).c_str(), getMqttRemoteTopic(REMOTE_UUID));
+}
+
+// Topics of one publish cycle: light, diagnostic, stats and the state of one remote
+static void test_benchmark_topic_lookup()
+{
+    const size_t cycles = 100000;
+    const char *base = "smartlamp";
+    mqttTopicsBuild(base);
+    size_t length = 0; // Checked at the end, so the loops are not optimized away
+
+    size_t before = nativeHeapAllocations;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < cycles; i++)
+    {
+        length += (getDeviceTopic(base) + "/light").length();
+        length += (getDeviceTopic(base) + "/diagnostic").length();
+        length += (getDeviceTopic(base) + "/stats").length();
+        length += (String(base) + "/" + getRemoteName()).length();
+    }
+    std::chrono::duration<double, std::nano> concatenated = std::chrono::steady_clock::now() - start;
+    size_t concatenatedAllocations = nativeHeapAllocations - before;
+
+    before = nativeHeapAllocations;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < cycles; i++)
+    {
+        const MqttTopics &topics = getMqttTopics();
+        length += strlen(topics.light);
+        length += strlen(topics.diagnostic);
+        length += strlen(topics.stats);
+        length += strlen(getMqttRemoteTopic(REMOTE_UUID));
+    }
+    std::chrono::duration<double, std::nano> table = std::chrono::steady_clock::now() - start;
+    TEST_ASSERT_EQUAL(before, nativeHeapAllocations);
+
+    char message[160];
+    snprintf(message, sizeof(message), "Topics of a publish cycle: %.0f ns and %.1f allocations concatenated, %.0f ns from the table",
+             concatenated.count() / cycles, (double)concatenatedAllocations / cycles, table.count() / cycles);
+    TEST_MESSAGE(message);
+    const MqttTopics &topics = getMqttTopics();
+    size_t cycleLength = strlen(topics.light) + strlen(topics.diagnostic) + strlen(topics.stats) + strlen(getMqttRemoteTopic(REMOTE_UUID));
+    TEST_ASSERT_EQUAL(2 * cycles * cycleLength, length);
+    TEST_ASSERT_LESS_THAN(concatenated.count(), table.count());
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_topics_match_the_concatenated_topics);
+    RUN_TEST(test_base_topic_change_rebuilds_remote_topics);
+    RUN_TEST(test_benchmark_topic_lookup);
+    return UNITY_END();
+}
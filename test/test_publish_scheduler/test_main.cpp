@@ -0,0 +1,241 @@
+#include "Network/publishScheduler.h"
+
+#include <Arduino.h>
+#include <string>
+#include <unity.h>
+#include <vector>
+
+struct Publish
+{
+    std::string topic;
+    std::string payload;
+    unsigned long time;
+};
+
+static std::vector<Publish> published;
+static bool senderFails = false;
+static int value = 0;            // Current state rendered by buildValue
+static int streamedContext = -1; // Context of the last streamed publish
+
+static bool sendPayload(const char *topic, const uint8_t *payload, size_t size)
+{
+    if (senderFails)
+    {
+        return false;
+    }
+    published.push_back({topic, std::string((const char *)payload, size), millis()});
+    return true;
+}
+
+static size_t buildValue(char *buff, size_t len, uint32_t context)
+{
+    return snprintf(buff, len, "%i/%u", value, context);
+}
+
+static size_t buildNothing(char *buff, size_t len, uint32_t context)
+{
+    return 0;
+}
+
+static size_t streamPayload(const char *topic, uint32_t context)
+{
+    streamedContext = context;
+    published.push_back({topic, "stream", millis()});
+    return 100;
+}
+
+static const char *LIGHT = "base/lamp/light";
+static const char *DIAGNOSTIC = "base/lamp/diagnostic";
+static const char *REMOTE = "base/RF24-Remote-01020304";
+static const char *DISCOVERY = "homeassistant/device/lamp/config";
+
+void setUp()
+{
+    published.clear();
+    senderFails = false;
+    value = 0;
+    nativeMillis = 1000;
+}
+
+void tearDown() {}
+
+// A burst of changes to one topic is published once with the newest state
+static void test_burst_is_coalesced_to_the_final_state()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    for (value = 0; value < 100; value++)
+    {
+        scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    }
+    value = 99;
+    TEST_ASSERT_EQUAL(1, scheduler.getPendingCount());
+    TEST_ASSERT_EQUAL(1, scheduler.process());
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_EQUAL_STRING("99/0", published[0].payload.c_str());
+    TEST_ASSERT_EQUAL(0, scheduler.getPendingCount());
+}
+
+static void test_priority_order()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    scheduler.scheduleStream(DISCOVERY, PublishPriorities::DISCOVERY, streamPayload, 5);
+    scheduler.schedule(DIAGNOSTIC, PublishPriorities::DIAGNOSTIC, buildValue);
+    scheduler.schedule(REMOTE, PublishPriorities::REMOTE, buildValue, 7);
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    TEST_ASSERT_EQUAL(4, scheduler.process());
+    TEST_ASSERT_EQUAL_STRING(LIGHT, published[0].topic.c_str());
+    TEST_ASSERT_EQUAL_STRING(REMOTE, published[1].topic.c_str());
+    TEST_ASSERT_EQUAL_STRING("0/7", published[1].payload.c_str());
+    TEST_ASSERT_EQUAL_STRING(DIAGNOSTIC, published[2].topic.c_str());
+    TEST_ASSERT_EQUAL_STRING(DISCOVERY, published[3].topic.c_str());
+    TEST_ASSERT_EQUAL(5, streamedContext);
+}
+
+// After the burst is used up, publishes are paced by the rate and the newest state still goes out
+static void test_rate_limit_after_burst()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    for (value = 0; value < 3 * MQTT_PUBLISH_BURST; value++)
+    {
+        scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+        scheduler.process();
+    }
+    TEST_ASSERT_EQUAL(MQTT_PUBLISH_BURST, published.size());
+    TEST_ASSERT_EQUAL(1, scheduler.getPendingCount());
+
+    value--;
+    delay(1000 / MQTT_PUBLISH_RATE - 1);
+    TEST_ASSERT_EQUAL(0, scheduler.process());
+    delay(1);
+    TEST_ASSERT_EQUAL(1, scheduler.process());
+    char expected[16];
+    snprintf(expected, sizeof(expected), "%i/0", 3 * MQTT_PUBLISH_BURST - 1);
+    TEST_ASSERT_EQUAL_STRING(expected, published.back().payload.c_str());
+}
+
+// Changes every millisecond for ten seconds, no light change waits longer than one token interval
+// The remote state is starved while the light keeps changing and goes out once the light settles
+static void test_latency_is_bounded_under_load()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    unsigned long firstUnpublished = 0; // millis() of the oldest change that was not published yet, 0 if none
+    unsigned long maxLatency = 0;
+    for (int i = 0; i < 10000; i++)
+    {
+        value = i;
+        scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+        scheduler.schedule(REMOTE, PublishPriorities::REMOTE, buildValue, 1);
+        if (firstUnpublished == 0)
+        {
+            firstUnpublished = millis();
+        }
+        size_t before = published.size();
+        scheduler.process();
+        if (published.size() > before && published[before].topic == LIGHT)
+        {
+            maxLatency = max(maxLatency, millis() - firstUnpublished);
+            firstUnpublished = 0;
+        }
+        delay(1);
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(1000 / MQTT_PUBLISH_RATE, maxLatency);
+    TEST_ASSERT_LESS_OR_EQUAL(10 * MQTT_PUBLISH_RATE + MQTT_PUBLISH_BURST, published.size());
+
+    delay(1000);
+    scheduler.process();
+    TEST_ASSERT_EQUAL(0, scheduler.getPendingCount());
+    TEST_ASSERT_EQUAL_STRING("9999/0", published[published.size() - 2].payload.c_str());
+    TEST_ASSERT_EQUAL_STRING("9999/1", published.back().payload.c_str());
+}
+
+static void test_unchanged_payload_is_suppressed_until_keepalive()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    scheduler.process();
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    scheduler.process();
+    TEST_ASSERT_EQUAL(1, published.size());
+    TEST_ASSERT_EQUAL(1, scheduler.getStats().suppressed);
+
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue, 0, true);
+    scheduler.process();
+    TEST_ASSERT_EQUAL(2, published.size());
+
+    delay(MQTT_KEEPALIVE_INTERVAL);
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    scheduler.process();
+    TEST_ASSERT_EQUAL(3, published.size());
+}
+
+static void test_failed_publish_stays_pending()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    senderFails = true;
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    TEST_ASSERT_EQUAL(0, scheduler.process());
+    TEST_ASSERT_EQUAL(1, scheduler.getPendingCount());
+
+    senderFails = false;
+    value = 5;
+    TEST_ASSERT_EQUAL(1, scheduler.process());
+    TEST_ASSERT_EQUAL_STRING("5/0", published[0].payload.c_str());
+}
+
+static void test_empty_payload_is_not_published()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildNothing);
+    TEST_ASSERT_EQUAL(1, scheduler.process());
+    TEST_ASSERT_EQUAL(0, published.size());
+    TEST_ASSERT_EQUAL(0, scheduler.getPendingCount());
+}
+
+static void test_removed_topic_is_not_published()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    scheduler.schedule(REMOTE, PublishPriorities::REMOTE, buildValue);
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue);
+    scheduler.remove(REMOTE);
+    TEST_ASSERT_EQUAL(1, scheduler.process());
+    TEST_ASSERT_EQUAL_STRING(LIGHT, published[0].topic.c_str());
+}
+
+static void test_schedules_are_dropped_when_all_slots_are_pending()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    static char topics[PUBLISH_SCHEDULER_SLOTS + 1][16];
+    for (size_t i = 0; i <= PUBLISH_SCHEDULER_SLOTS; i++)
+    {
+        snprintf(topics[i], sizeof(topics[i]), "topic/%zu", i);
+        scheduler.schedule(topics[i], PublishPriorities::DIAGNOSTIC, buildValue);
+    }
+    TEST_ASSERT_EQUAL(PUBLISH_SCHEDULER_SLOTS, scheduler.getPendingCount());
+    TEST_ASSERT_EQUAL(1, scheduler.getStats().dropped);
+}
+
+static void test_sent_bytes_include_the_packet_header()
+{
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    value = 12;
+    scheduler.schedule(LIGHT, PublishPriorities::STATE, buildValue); // "12/0"
+    scheduler.process();
+    TEST_ASSERT_EQUAL(1 + 1 + 2 + strlen(LIGHT) + 4, scheduler.getStats().bytes);
+    TEST_ASSERT_EQUAL(1, scheduler.getStats().sent);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_burst_is_coalesced_to_the_final_state);
+    RUN_TEST(test_priority_order);
+    RUN_TEST(test_rate_limit_after_burst);
+    RUN_TEST(test_latency_is_bounded_under_load);
+    RUN_TEST(test_unchanged_payload_is_suppressed_until_keepalive);
+    RUN_TEST(test_failed_publish_stays_pending);
+    RUN_TEST(test_empty_payload_is_not_published);
+    RUN_TEST(test_removed_topic_is_not_published);
+    RUN_TEST(test_schedules_are_dropped_when_all_slots_are_pending);
+    RUN_TEST(test_sent_bytes_include_the_packet_header);
+    return UNITY_END();
+}
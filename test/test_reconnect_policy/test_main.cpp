@@ -0,0 +1,114 @@
+#include "Network/reconnectPolicy.h"
+
+#include <Arduino.h>
+#include <unity.h>
+
+void setUp()
+{
+    nativeMillis = 1000;
+}
+
+void tearDown() {}
+
+static void test_first_attempt_is_immediate()
+{
+    ReconnectPolicy policy("Test", 1000, 16000);
+    TEST_ASSERT_TRUE(policy.ready());
+    TEST_ASSERT_EQUAL(0, policy.getDelay());
+    TEST_ASSERT_EQUAL(0, policy.getFailures());
+}
+
+// Each delay lies in the upper half of the doubled base delay until the cap is reached
+static void test_delay_doubles_up_to_the_cap()
+{
+    ReconnectPolicy policy("Test", 1000, 16000);
+    const uint32_t bases[] = {1000, 2000, 4000, 8000, 16000, 16000, 16000};
+    for (uint32_t base : bases)
+    {
+        policy.failed();
+        TEST_ASSERT_GREATER_OR_EQUAL(base / 2, policy.getDelay());
+        TEST_ASSERT_LESS_OR_EQUAL(base, policy.getDelay());
+    }
+    TEST_ASSERT_EQUAL(7, policy.getFailures());
+}
+
+// The shift must not overflow after many failures
+static void test_delay_stays_capped_after_many_failures()
+{
+    ReconnectPolicy policy("Test", 5000, 120000);
+    for (int i = 0; i < 300; i++)
+    {
+        policy.failed();
+        TEST_ASSERT_LESS_OR_EQUAL(120000, policy.getDelay());
+    }
+    TEST_ASSERT_GREATER_OR_EQUAL(60000, policy.getDelay());
+    TEST_ASSERT_EQUAL(UINT8_MAX, policy.getFailures());
+}
+
+static void test_ready_after_the_delay()
+{
+    ReconnectPolicy policy("Test", 1000, 16000);
+    policy.failed();
+    uint32_t wait = policy.getDelay();
+    TEST_ASSERT_FALSE(policy.ready());
+    delay(wait - 1);
+    TEST_ASSERT_FALSE(policy.ready());
+    delay(1);
+    TEST_ASSERT_TRUE(policy.ready());
+}
+
+static void test_success_resets_the_backoff()
+{
+    ReconnectPolicy policy("Test", 1000, 16000);
+    policy.failed();
+    policy.failed();
+    policy.succeeded();
+    TEST_ASSERT_TRUE(policy.ready());
+    TEST_ASSERT_EQUAL(0, policy.getFailures());
+    policy.failed();
+    TEST_ASSERT_LESS_OR_EQUAL(1000, policy.getDelay());
+}
+
+static void test_jitter_is_stable_and_in_range()
+{
+    uint32_t jitter = getDeviceJitter(1000);
+    TEST_ASSERT_LESS_OR_EQUAL(1000, jitter);
+    TEST_ASSERT_EQUAL(jitter, getDeviceJitter(1000));
+    TEST_ASSERT_EQUAL(0, getDeviceJitter(0));
+    TEST_ASSERT_LESS_OR_EQUAL(UINT32_MAX, getDeviceJitter(UINT32_MAX));
+}
+
+// A fleet that lost its broker at the same moment spreads its first reconnects over the window
+static void test_fleet_reconnects_are_spread()
+{
+    const uint32_t window = MQTT_RECONNECT_INITIAL_DELAY / 2;
+    const size_t devices = 200;
+    const size_t buckets = 10;
+    size_t counts[buckets] = {};
+    for (size_t i = 0; i < devices; i++)
+    {
+        char id[32];
+        snprintf(id, sizeof(id), "%s-%02X%02X%02X", MODELNAME, 0x24, (unsigned)(i >> 8), (unsigned)(i & 0xFF));
+        uint32_t jitter = getIdJitter(id, window);
+        TEST_ASSERT_LESS_OR_EQUAL(window, jitter);
+        counts[min((size_t)jitter * buckets / window, buckets - 1)]++;
+    }
+    for (size_t i = 0; i < buckets; i++)
+    {
+        TEST_ASSERT_GREATER_THAN(devices / buckets / 3, counts[i]); // No part of the window is left empty
+        TEST_ASSERT_LESS_THAN(3 * devices / buckets, counts[i]);   // And none gets a stampede
+    }
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_first_attempt_is_immediate);
+    RUN_TEST(test_delay_doubles_up_to_the_cap);
+    RUN_TEST(test_delay_stays_capped_after_many_failures);
+    RUN_TEST(test_ready_after_the_delay);
+    RUN_TEST(test_success_resets_the_backoff);
+    RUN_TEST(test_jitter_is_stable_and_in_range);
+    RUN_TEST(test_fleet_reconnects_are_spread);
+    return UNITY_END();
+}
@@ -0,0 +1,272 @@
+#include "RF/radio.h"
+#include "RF/radioMessage.h"
+#include "RF/remoteRegistry.h"
+#include "Output/ledControl.h"
+#include "Events/eventBus.h"
+
+#include <chrono>
+#include <unity.h>
+
+static QueueHandle_t events;
+static uint8_t msgNum = 0;
+
+// Inject a v1 frame of the remote into the loopback transport
+static void injectCommands(uint32_t id, const RemoteCommand *commands, size_t count, bool corrupt = false)
+{
+    uint8_t frame[REMOTE_MAX_FRAME_SIZE];
+    frame[0] = (uint8_t)RemoteProtocolVersions::V1;
+    memcpy(frame + 1, &id, sizeof(id));
+    frame[5] = ++msgNum;
+    frame[6] = (uint8_t)MessageTypes::REMOTE;
+    size_t size = encodeRemoteRadioMessageData(frame + 7, sizeof(frame) - 9, 255, 3000, commands, count);
+    TEST_ASSERT_GREATER_THAN(0, size);
+
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < 6; i++) // Protocol version, UUID and MSG_NUM
+    {
+        checksum += frame[i];
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        checksum += frame[7 + i];
+    }
+    if (corrupt)
+    {
+        checksum++;
+    }
+    frame[7 + size] = checksum & 0xFF;
+    frame[8 + size] = checksum >> 8;
+    TEST_ASSERT_TRUE(getLoopbackTransport().inject(frame, 9 + size));
+}
+
+static void injectBrightness(uint32_t id, uint16_t brightness, bool corrupt = false)
+{
+    RemoteCommand command;
+    command.type = RemoteCommandTypes::BRIGHTNESS;
+    command.value[0] = brightness;
+    injectCommands(id, &command, 1, corrupt);
+}
+
+// Let the io task apply the coalesced commands
+static void applyCommands()
+{
+    delay(LIGHT_COMMAND_COALESCE_TIME);
+    applyLightCommands();
+}
+
+static size_t countEvents(EventTypes type)
+{
+    size_t count = 0;
+    Event event;
+    while (xQueueReceive(events, &event, 0) == pdTRUE)
+    {
+        count += event.type == type;
+    }
+    return count;
+}
+
+void setUp()
+{
+    countEvents(EventTypes::REMOTE_SEEN); // Drop the events of earlier tests
+}
+
+void tearDown() {}
+
+static void test_frame_is_dispatched_to_the_light()
+{
+    injectBrightness(0x01000001, 700);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_EQUAL(700, getLedBrightness());
+    TEST_ASSERT_TRUE(getLedPower());
+
+    Remote remote;
+    TEST_ASSERT_TRUE(getRemote(0x01000001, remote));
+    TEST_ASSERT_EQUAL((uint8_t)RemoteTransportTypes::LOOPBACK, (uint8_t)remote.transport);
+    TEST_ASSERT_EQUAL(100, remote.batteryPercentage);
+    TEST_ASSERT_EQUAL(3000, remote.batteryVoltage);
+    TEST_ASSERT_EQUAL(1, remote.link.getReceived());
+    TEST_ASSERT_EQUAL(1, countEvents(EventTypes::REMOTE_SEEN));
+}
+
+static void test_commands_of_one_frame_are_applied_in_order()
+{
+    RemoteCommand commands[3];
+    commands[0].type = RemoteCommandTypes::EVENT;
+    commands[0].event = RemoteEvents::OFF;
+    commands[1].type = RemoteCommandTypes::BRIGHTNESS; // Turns the lamp on again
+    commands[1].value[0] = 400;
+    commands[2].type = RemoteCommandTypes::DELTA;
+    commands[2].target = RemoteDeltaTargets::BRIGHTNESS;
+    commands[2].delta = -100;
+    injectCommands(0x01000001, commands, 3);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_TRUE(getLedPower());
+    TEST_ASSERT_EQUAL(300, getLedBrightness());
+    TEST_ASSERT_EQUAL(0, countEvents(EventTypes::REMOTE_SEEN));
+}
+
+static RemoteCommand makeCommand(RemoteCommandTypes type, uint16_t value)
+{
+    RemoteCommand command;
+    command.type = type;
+    if (type == RemoteCommandTypes::SCENE_RECALL || type == RemoteCommandTypes::SCENE_STORE)
+    {
+        command.id = value;
+    }
+    else
+    {
+        command.value[0] = value;
+    }
+    return command;
+}
+
+// A scene store gets the state of the commands before it, even if later commands arrive in the same window
+static void test_scene_store_is_not_merged_with_later_commands()
+{
+    RemoteCommand commands[] = {
+        makeCommand(RemoteCommandTypes::BRIGHTNESS, 300),
+        makeCommand(RemoteCommandTypes::SCENE_STORE, 3),
+        makeCommand(RemoteCommandTypes::BRIGHTNESS, 800),
+        makeCommand(RemoteCommandTypes::SCENE_STORE, 4),
+        makeCommand(RemoteCommandTypes::SCENE_RECALL, 3), // Does not discard the pending store of scene 4
+    };
+    injectCommands(0x01000001, commands, 5);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_EQUAL(300, getLedBrightness());
+
+    RemoteCommand recall = makeCommand(RemoteCommandTypes::SCENE_RECALL, 4);
+    injectCommands(0x01000001, &recall, 1);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_EQUAL(800, getLedBrightness());
+}
+
+// RGB in a mode without RGB channels and deltas of an unknown target are dropped, not applied to another field
+static void test_unsupported_commands_are_rejected()
+{
+    RemoteCommand commands[2];
+    commands[0] = makeCommand(RemoteCommandTypes::RGB, 1000); // The native test lamp is CCT
+    commands[1].type = RemoteCommandTypes::DELTA;
+    commands[1].target = static_cast<RemoteDeltaTargets>(7);
+    commands[1].delta = -100;
+    LightCommandStats before = getLightCommandStats();
+    injectCommands(0x01000001, commands, 2);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_EQUAL(before.received, getLightCommandStats().received);
+}
+
+static void test_feedback_follows_the_lamp_state()
+{
+    injectBrightness(0x01000001, 512);
+    radioLoop();
+    applyCommands();
+    radioLoop(); // The state change is picked up on the next pass
+
+    uint8_t size;
+    const uint8_t *feedback = getLoopbackTransport().getFeedback(size);
+    TEST_ASSERT_EQUAL(LampStateRadioMessage::SIZE, size);
+    TEST_ASSERT_EQUAL((uint8_t)MessageTypes::LAMP_STATE, feedback[1]);
+    TEST_ASSERT_EQUAL(getLedStateSeq(), feedback[2]);
+    TEST_ASSERT_EQUAL(512, feedback[5] | (feedback[6] << 8));
+}
+
+static void test_checksum_failure_is_accounted_to_the_remote()
+{
+    injectBrightness(0x01000001, 100, true);
+    radioLoop();
+    applyCommands();
+    TEST_ASSERT_EQUAL(512, getLedBrightness());
+
+    Remote remote;
+    TEST_ASSERT_TRUE(getRemote(0x01000001, remote));
+    TEST_ASSERT_EQUAL(1, remote.link.getChecksumFailures());
+}
+
+static void test_remotes_beyond_the_registry_are_evicted()
+{
+    for (uint32_t i = 0; i < REMOTE_REGISTRY_MAX; i++)
+    {
+        injectBrightness(0x02000000 + i, 600);
+        radioLoop();
+    }
+    uint32_t ids[REMOTE_REGISTRY_MAX + 1];
+    TEST_ASSERT_EQUAL(REMOTE_REGISTRY_MAX, getRemoteIds(ids, REMOTE_REGISTRY_MAX + 1));
+    size_t seen = 0;
+    size_t evicted = 0;
+    Event event;
+    while (xQueueReceive(events, &event, 0) == pdTRUE)
+    {
+        seen += event.type == EventTypes::REMOTE_SEEN;
+        evicted += event.type == EventTypes::REMOTE_EVICTED;
+    }
+    TEST_ASSERT_EQUAL(REMOTE_REGISTRY_MAX, seen);
+    TEST_ASSERT_EQUAL(1, evicted); // Together with the remote of the earlier tests one remote too many was seen
+}
+
+// The registry is full of the remotes of the last test, all seen within the same second
+static void test_least_recently_seen_remote_is_evicted()
+{
+    injectBrightness(0x02000000, 600); // The oldest remote is seen again
+    radioLoop();
+    injectBrightness(0x03000000, 600);
+    radioLoop();
+
+    Remote remote;
+    TEST_ASSERT_TRUE(getRemote(0x02000000, remote));
+    TEST_ASSERT_TRUE(getRemote(0x03000000, remote));
+    TEST_ASSERT_FALSE(getRemote(0x02000001, remote));
+    TEST_ASSERT_EQUAL(1, countEvents(EventTypes::REMOTE_EVICTED));
+}
+
+// Time from injecting a frame to its light command being queued, reported with the test output
+static void test_benchmark_dispatch()
+{
+    const size_t frames = 4000;
+    RemoteCommand command;
+    command.type = RemoteCommandTypes::DELTA;
+    command.delta = 1;
+
+    LightCommandStats before = getLightCommandStats();
+    std::chrono::nanoseconds elapsed(0);
+    for (size_t i = 0; i < frames; i += LOOPBACK_QUEUE_LENGTH)
+    {
+        for (size_t j = 0; j < LOOPBACK_QUEUE_LENGTH; j++)
+        {
+            injectCommands(0x02000000, &command, 1);
+        }
+        auto start = std::chrono::steady_clock::now();
+        radioLoop();
+        elapsed += std::chrono::steady_clock::now() - start;
+        applyCommands();
+    }
+    LightCommandStats after = getLightCommandStats();
+    TEST_ASSERT_EQUAL(frames, after.received - before.received);
+
+    char message[96];
+    snprintf(message, sizeof(message), "Loopback dispatch: %zu frames, %.2f us per frame",
+             frames, elapsed.count() / 1000.0 / frames);
+    TEST_MESSAGE(message);
+}
+
+int main(int argc, char **argv)
+{
+    events = eventBusSubscribe(EVENT_MASK(EventTypes::REMOTE_SEEN) | EVENT_MASK(EventTypes::REMOTE_EVICTED), 2 * REMOTE_REGISTRY_MAX);
+    ledInit();
+    radioLoop(); // Start the transports like radioTask, starting the loopback clears it
+
+    UNITY_BEGIN();
+    RUN_TEST(test_frame_is_dispatched_to_the_light);
+    RUN_TEST(test_commands_of_one_frame_are_applied_in_order);
+    RUN_TEST(test_scene_store_is_not_merged_with_later_commands);
+    RUN_TEST(test_unsupported_commands_are_rejected);
+    RUN_TEST(test_feedback_follows_the_lamp_state);
+    RUN_TEST(test_checksum_failure_is_accounted_to_the_remote);
+    RUN_TEST(test_remotes_beyond_the_registry_are_evicted);
+    RUN_TEST(test_least_recently_seen_remote_is_evicted);
+    RUN_TEST(test_benchmark_dispatch);
+    return UNITY_END();
+}
@@ -0,0 +1,202 @@
+#include "RF/radioMessage.h"
+#include "RF/remoteTransport.h"
+
+#include <unity.h>
+
+static const uint8_t TEST_UUID[4] = {0x12, 0x34, 0x56, 0x78};
+
+// Wrap REMOTE data into a complete frame with header and checksum, returns the frame size
+static size_t buildFrame(uint8_t *frame, uint8_t protocolVersion, uint8_t msgNum, const uint8_t *data, size_t size)
+{
+    frame[0] = protocolVersion;
+    memcpy(frame + 1, TEST_UUID, sizeof(TEST_UUID));
+    frame[5] = msgNum;
+    frame[6] = (uint8_t)MessageTypes::REMOTE;
+    memcpy(frame + 7, data, size);
+
+    uint16_t checksum = protocolVersion + msgNum;
+    for (size_t i = 0; i < sizeof(TEST_UUID); i++)
+    {
+        checksum += TEST_UUID[i];
+    }
+    for (size_t i = 0; i < size; i++)
+    {
+        checksum += data[i];
+    }
+    frame[7 + size] = checksum & 0xFF;
+    frame[8 + size] = checksum >> 8;
+    return 9 + size;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_v1_round_trip_all_command_types()
+{
+    RemoteCommand commands[7];
+    commands[0].type = RemoteCommandTypes::EVENT;
+    commands[0].event = RemoteEvents::TOGGLE;
+    commands[1].type = RemoteCommandTypes::BRIGHTNESS;
+    commands[1].value[0] = 700;
+    commands[2].type = RemoteCommandTypes::MIREDS;
+    commands[2].value[0] = 300;
+    commands[3].type = RemoteCommandTypes::RGB;
+    commands[3].value[0] = 1024;
+    commands[3].value[1] = 512;
+    commands[3].value[2] = 1;
+    commands[4].type = RemoteCommandTypes::SCENE_RECALL;
+    commands[4].id = 3;
+    commands[5].type = RemoteCommandTypes::SCENE_STORE;
+    commands[5].id = 15;
+    commands[6].type = RemoteCommandTypes::DELTA;
+    commands[6].target = RemoteDeltaTargets::COLOR;
+    commands[6].delta = -64;
+
+    uint8_t data[REMOTE_MAX_FRAME_SIZE];
+    size_t size = encodeRemoteRadioMessageData(data, sizeof(data) - 9, 255, 2950, commands, 2);
+    TEST_ASSERT_EQUAL(3 + 3 + 4, size);
+
+    // All seven commands do not fit one radio frame, so they are checked in two frames
+    RemoteRadioMessageData first((uint8_t)RemoteProtocolVersions::V1, data, size);
+    TEST_ASSERT_TRUE(first.getValid());
+    TEST_ASSERT_EQUAL(100, first.getBatteryPercentage()); // Sent as 0 -> 255
+    TEST_ASSERT_EQUAL(2950, first.getBatteryVoltage());
+    TEST_ASSERT_EQUAL(2, first.getCommandCount());
+    TEST_ASSERT_EQUAL((uint8_t)RemoteEvents::TOGGLE, (uint8_t)first.getCommand(0).event);
+    TEST_ASSERT_EQUAL(700, first.getCommand(1).value[0]);
+
+    uint8_t large[64];
+    size = encodeRemoteRadioMessageData(large, sizeof(large), 10, 3300, commands, 7);
+    TEST_ASSERT_EQUAL(3 + 3 + 4 + 4 + 8 + 3 + 3 + 5, size);
+    RemoteRadioMessageData all((uint8_t)RemoteProtocolVersions::V1, large, size);
+    TEST_ASSERT_TRUE(all.getValid());
+    TEST_ASSERT_EQUAL(7, all.getCommandCount());
+    for (size_t i = 0; i < 7; i++)
+    {
+        TEST_ASSERT_EQUAL((uint8_t)commands[i].type, (uint8_t)all.getCommand(i).type);
+    }
+    TEST_ASSERT_EQUAL(300, all.getCommand(2).value[0]);
+    TEST_ASSERT_EQUAL(1024, all.getCommand(3).value[0]);
+    TEST_ASSERT_EQUAL(512, all.getCommand(3).value[1]);
+    TEST_ASSERT_EQUAL(1, all.getCommand(3).value[2]);
+    TEST_ASSERT_EQUAL(3, all.getCommand(4).id);
+    TEST_ASSERT_EQUAL(15, all.getCommand(5).id);
+    TEST_ASSERT_EQUAL((uint8_t)RemoteDeltaTargets::COLOR, (uint8_t)all.getCommand(6).target);
+    TEST_ASSERT_EQUAL(-64, all.getCommand(6).delta);
+}
+
+static void test_v1_frame_through_radio_message()
+{
+    RemoteCommand command;
+    command.type = RemoteCommandTypes::BRIGHTNESS;
+    command.value[0] = 0x0201;
+    uint8_t data[16];
+    size_t size = encodeRemoteRadioMessageData(data, sizeof(data), 50, 3000, &command, 1);
+
+    uint8_t frame[REMOTE_MAX_FRAME_SIZE];
+    size_t frameSize = buildFrame(frame, (uint8_t)RemoteProtocolVersions::V1, 9, data, size);
+    RadioMessageReceived msg(frame, frameSize);
+    TEST_ASSERT_TRUE(msg.getValid());
+    TEST_ASSERT_EQUAL(9, msg.getMsgNum());
+    TEST_ASSERT_EQUAL_MEMORY(TEST_UUID, msg.getUUID(), sizeof(TEST_UUID));
+    TEST_ASSERT_EQUAL(size, msg.getDataSize());
+
+    RemoteRadioMessageData remoteData(msg.getProtocolVersion(), msg.getData(), msg.getDataSize());
+    TEST_ASSERT_TRUE(remoteData.getValid());
+    TEST_ASSERT_EQUAL(1, remoteData.getCommandCount());
+    TEST_ASSERT_EQUAL(0x0201, remoteData.getCommand(0).value[0]);
+}
+
+// Frames of remotes built before the TLV format must decode to the same single event
+static void test_v0_frame_compatibility()
+{
+    const uint8_t data[4] = {(uint8_t)RemoteEvents::UP2, 200, 0xB8, 0x0B}; // UP2, 200 / 255 battery, 3000 mV
+    uint8_t frame[REMOTE_MAX_FRAME_SIZE];
+    size_t frameSize = buildFrame(frame, (uint8_t)RemoteProtocolVersions::V0, 1, data, sizeof(data));
+    TEST_ASSERT_EQUAL(13, frameSize);
+
+    RadioMessageReceived msg(frame, frameSize);
+    TEST_ASSERT_TRUE(msg.getValid());
+    TEST_ASSERT_EQUAL((uint8_t)MessageTypes::REMOTE, (uint8_t)msg.getMsgType());
+
+    RemoteRadioMessageData remoteData(msg.getProtocolVersion(), msg.getData(), msg.getDataSize());
+    TEST_ASSERT_TRUE(remoteData.getValid());
+    TEST_ASSERT_EQUAL(1, remoteData.getCommandCount());
+    TEST_ASSERT_EQUAL((uint8_t)RemoteCommandTypes::EVENT, (uint8_t)remoteData.getCommand(0).type);
+    TEST_ASSERT_EQUAL((uint8_t)RemoteEvents::UP2, (uint8_t)remoteData.getCommand(0).event);
+    TEST_ASSERT_EQUAL(78, remoteData.getBatteryPercentage());
+    TEST_ASSERT_EQUAL(3000, remoteData.getBatteryVoltage());
+}
+
+static void test_v0_wrong_size_is_invalid()
+{
+    const uint8_t data[5] = {(uint8_t)RemoteEvents::ON, 100, 0, 0, 0};
+    RemoteRadioMessageData remoteData((uint8_t)RemoteProtocolVersions::V0, data, sizeof(data));
+    TEST_ASSERT_FALSE(remoteData.getValid());
+}
+
+static void test_v1_unknown_command_is_skipped()
+{
+    const uint8_t data[] = {
+        90, 0xE8, 0x03,                         // Battery, 1000 mV
+        0xF0, 3, 0xAA, 0xBB, 0xCC,              // Command type from a newer remote
+        (uint8_t)RemoteCommandTypes::EVENT, 1, (uint8_t)RemoteEvents::OFF,
+    };
+    RemoteRadioMessageData remoteData((uint8_t)RemoteProtocolVersions::V1, data, sizeof(data));
+    TEST_ASSERT_TRUE(remoteData.getValid());
+    TEST_ASSERT_EQUAL(1, remoteData.getCommandCount());
+    TEST_ASSERT_EQUAL((uint8_t)RemoteEvents::OFF, (uint8_t)remoteData.getCommand(0).event);
+}
+
+static void test_v1_malformed_commands_are_invalid()
+{
+    const uint8_t truncatedValue[] = {90, 0, 0, (uint8_t)RemoteCommandTypes::RGB, 6, 1, 2, 3};
+    TEST_ASSERT_FALSE(RemoteRadioMessageData((uint8_t)RemoteProtocolVersions::V1, truncatedValue, sizeof(truncatedValue)).getValid());
+
+    const uint8_t truncatedHeader[] = {90, 0, 0, (uint8_t)RemoteCommandTypes::EVENT};
+    TEST_ASSERT_FALSE(RemoteRadioMessageData((uint8_t)RemoteProtocolVersions::V1, truncatedHeader, sizeof(truncatedHeader)).getValid());
+
+    const uint8_t wrongLength[] = {90, 0, 0, (uint8_t)RemoteCommandTypes::BRIGHTNESS, 1, 5};
+    TEST_ASSERT_FALSE(RemoteRadioMessageData((uint8_t)RemoteProtocolVersions::V1, wrongLength, sizeof(wrongLength)).getValid());
+
+    const uint8_t unknownVersion[] = {90, 0, 0};
+    TEST_ASSERT_FALSE(RemoteRadioMessageData(7, unknownVersion, sizeof(unknownVersion)).getValid());
+}
+
+static void test_encode_rejects_commands_that_do_not_fit()
+{
+    RemoteCommand command;
+    command.type = RemoteCommandTypes::RGB;
+    uint8_t data[16];
+    TEST_ASSERT_EQUAL(0, encodeRemoteRadioMessageData(data, 10, 0, 0, &command, 1)); // Header, type, length and 6 value bytes need 11
+    TEST_ASSERT_EQUAL(11, encodeRemoteRadioMessageData(data, 11, 0, 0, &command, 1));
+
+    RemoteCommand empty;
+    TEST_ASSERT_EQUAL(0, encodeRemoteRadioMessageData(data, sizeof(data), 0, 0, &empty, 1));
+}
+
+static void test_checksum_mismatch_is_invalid()
+{
+    const uint8_t data[4] = {(uint8_t)RemoteEvents::ON, 100, 0, 0};
+    uint8_t frame[REMOTE_MAX_FRAME_SIZE];
+    size_t frameSize = buildFrame(frame, (uint8_t)RemoteProtocolVersions::V0, 1, data, sizeof(data));
+    frame[7] ^= 0x01;
+    TEST_ASSERT_FALSE(RadioMessageReceived(frame, frameSize).getValid());
+
+    TEST_ASSERT_FALSE(RadioMessageReceived(frame, 8).getValid());  // Shorter than the header
+    TEST_ASSERT_FALSE(RadioMessageReceived(frame, 33).getValid()); // Longer than a radio frame
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_v1_round_trip_all_command_types);
+    RUN_TEST(test_v1_frame_through_radio_message);
+    RUN_TEST(test_v0_frame_compatibility);
+    RUN_TEST(test_v0_wrong_size_is_invalid);
+    RUN_TEST(test_v1_unknown_command_is_skipped);
+    RUN_TEST(test_v1_malformed_commands_are_invalid);
+    RUN_TEST(test_encode_rejects_commands_that_do_not_fit);
+    RUN_TEST(test_checksum_mismatch_is_invalid);
+    return UNITY_END();
+}
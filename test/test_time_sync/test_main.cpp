@@ -0,0 +1,74 @@
+#include "Network/timeSync.h"
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <unity.h>
+
+void setUp()
+{
+    nativeMillis = 100000;
+}
+
+void tearDown() {}
+
+// Runs first, before the SNTP callback was ever called
+static void test_conversion_fails_without_synchronization()
+{
+    timeSyncBegin();
+    uint32_t localMs = 0;
+    TEST_ASSERT_FALSE(getTimeSynced());
+    TEST_ASSERT_FALSE(epochToLocalMillis(getEpochMillis(), localMs));
+    TEST_ASSERT_EQUAL(0, localMs);
+}
+
+static void test_future_start_time_maps_to_millis()
+{
+    nativeSntpSync();
+    TEST_ASSERT_TRUE(getTimeSynced());
+    uint32_t localMs;
+    TEST_ASSERT_TRUE(epochToLocalMillis(getEpochMillis() + 5000, localMs));
+    TEST_ASSERT_INT_WITHIN(50, 105000, localMs); // The host clock advances while the test runs
+}
+
+static void test_past_start_time_maps_before_now()
+{
+    uint32_t localMs;
+    TEST_ASSERT_TRUE(epochToLocalMillis(getEpochMillis() - 2000, localMs));
+    TEST_ASSERT_INT_WITHIN(50, 98000, localMs);
+}
+
+static void test_long_past_start_time_is_clamped()
+{
+    uint32_t localMs;
+    TEST_ASSERT_TRUE(epochToLocalMillis(getEpochMillis() - 10 * TIME_SYNC_MAX_SCHEDULE_AHEAD, localMs));
+    TEST_ASSERT_INT_WITHIN(50, 100000 - TIME_SYNC_MAX_SCHEDULE_AHEAD, localMs);
+}
+
+static void test_start_time_too_far_ahead_is_rejected()
+{
+    uint32_t localMs = 0;
+    TEST_ASSERT_FALSE(epochToLocalMillis(getEpochMillis() + TIME_SYNC_MAX_SCHEDULE_AHEAD + 1000, localMs));
+    TEST_ASSERT_EQUAL(0, localMs);
+}
+
+// millis() may wrap between now and the start time, the LED engine compares with signed differences
+static void test_start_time_across_millis_wrap()
+{
+    nativeMillis = UINT32_MAX - 1000;
+    uint32_t localMs;
+    TEST_ASSERT_TRUE(epochToLocalMillis(getEpochMillis() + 3000, localMs));
+    TEST_ASSERT_LESS_THAN(2000, localMs);
+    TEST_ASSERT_INT_WITHIN(50, 3000, (int32_t)(localMs - (uint32_t)millis()));
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_conversion_fails_without_synchronization);
+    RUN_TEST(test_future_start_time_maps_to_millis);
+    RUN_TEST(test_past_start_time_maps_before_now);
+    RUN_TEST(test_long_past_start_time_is_clamped);
+    RUN_TEST(test_start_time_too_far_ahead_is_rejected);
+    RUN_TEST(test_start_time_across_millis_wrap);
+    return UNITY_END();
+}
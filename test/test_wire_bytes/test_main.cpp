@@ -0,0 +1,160 @@
+#include "Network/mqtt.h"
+#include "Network/publishScheduler.h"
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <nativeNetwork.h>
+#include <unity.h>
+
+// Bytes on the wire of the periodic publishes of one lamp over an hour, before and after the RSSI deadband
+// Payloads are rendered like the firmware renders the default RF24 controller topics
+// The client is MQTT 3.1.1, so every PUBLISH carries its full topic, MQTT 5 topic aliases and expiry are out of scope
+
+static const char *LIGHT = "smartlamp/SMART-WIFI-RF24-Lamp-A1B2C3/light";
+static const char *DIAGNOSTIC = "smartlamp/SMART-WIFI-RF24-Lamp-A1B2C3/diagnostic";
+static const char *STATS = "smartlamp/SMART-WIFI-RF24-Lamp-A1B2C3/stats";
+
+static int rssi = 0;             // Current reading of the simulated radio
+static Deadband *rssiDeadband;   // Deadband of the run
+static uint32_t statsCounter = 0; // The counters change between every stats publish
+
+static bool sendPayload(const char *topic, const uint8_t *payload, size_t size)
+{
+    return true;
+}
+
+static size_t buildLight(char *buff, size_t len, uint32_t context)
+{
+    return snprintf(buff, len, "{\"mode\":\"CCT\",\"state\":\"ON\",\"brightness\":512,\"color_mode\":\"color_temp\",\"color_temp\":300}");
+}
+
+static size_t buildDiagnostic(char *buff, size_t len, uint32_t context)
+{
+    return snprintf(buff, len, "{\"ip\":\"192.168.1.57\",\"rssi\":%i,\"publishLatency\":3,\"timeSynced\":true,\"broker\":\"broker.local\","
+                               "\"radioChannel\":76,\"radioAddress\":\"0xE7E7E7E7E7\"}",
+                    (int)rssiDeadband->filter(rssi));
+}
+
+static size_t buildStats(char *buff, size_t len, uint32_t context)
+{
+    statsCounter++;
+    return snprintf(buff, len, "{\"published\":%u,\"suppressed\":%u,\"publishDropped\":0,\"publishBytes\":%u,\"publishLatency\":3,"
+                               "\"publishMaxLatency\":41,\"commandsReceived\":12,\"commandsApplied\":9,\"commandsStale\":0,\"eventsDropped\":0,"
+                               "\"groupReceived\":0,\"groupDuplicates\":0,\"groupInvalid\":0}",
+                    statsCounter * 7, statsCounter * 3, statsCounter * 1500);
+}
+
+// Indoor noise of +-3 dBm around a level that drops by 8 dBm after 20 minutes
+static int getRssi(unsigned long elapsed, uint32_t &random)
+{
+    random = random * 1103515245 + 12345;
+    return (elapsed < 1200000 ? -60 : -68) + (int)((random >> 16) % 7) - 3;
+}
+
+// One hour of the periodic publish path of handleMQTTConnection with an idle light
+// The RSSI follows getRssi, the payloads are rendered like the firmware renders them
+static uint32_t simulateHour(int32_t band)
+{
+    Deadband deadband(band);
+    rssiDeadband = &deadband;
+    PublishScheduler scheduler(sendPayload, MQTT_PUBLISH_RATE, MQTT_PUBLISH_BURST);
+    uint32_t random = 12345;
+    unsigned long lastStats = 0;
+    nativeMillis = 1000;
+    for (unsigned long elapsed = 0; elapsed < 3600000; elapsed += MQTT_PUBLISH_INTERVAL)
+    {
+        rssi = getRssi(elapsed, random);
+        scheduler.schedule(LIGHT, PublishPriorities::STATE, buildLight);
+        scheduler.schedule(DIAGNOSTIC, PublishPriorities::DIAGNOSTIC, buildDiagnostic);
+        if (lastStats == 0 || millis() - lastStats >= MQTT_STATS_INTERVAL)
+        {
+            scheduler.schedule(STATS, PublishPriorities::DIAGNOSTIC, buildStats);
+            lastStats = millis();
+        }
+        scheduler.process();
+        delay(MQTT_PUBLISH_INTERVAL);
+    }
+    return scheduler.getStats().bytes;
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void test_deadband_holds_small_changes()
+{
+    Deadband deadband(4);
+    TEST_ASSERT_EQUAL(-60, deadband.filter(-60));
+    TEST_ASSERT_EQUAL(-60, deadband.filter(-64));
+    TEST_ASSERT_EQUAL(-60, deadband.filter(-56));
+    TEST_ASSERT_EQUAL(-65, deadband.filter(-65));
+    TEST_ASSERT_EQUAL(-65, deadband.filter(-62));
+}
+
+static void test_rssi_deadband_reduces_bytes_on_the_wire()
+{
+    uint32_t before = simulateHour(0);
+    uint32_t after = simulateHour(MQTT_RSSI_DEADBAND);
+
+    char message[160];
+    snprintf(message, sizeof(message), "Bytes per lamp and hour: %u without and %u with a %i dBm RSSI deadband, %u and %u for 150 lamps",
+             before, after, MQTT_RSSI_DEADBAND, before * 150, after * 150);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_LESS_THAN(before / 2, after);
+}
+
+// One hour of the firmware itself against the in memory broker, which counts the PUBLISH frames it receives
+// with fixed header, remaining length, topic and payload, the same bytes the scheduler counter reports
+static void test_firmware_frames_on_the_broker()
+{
+    NativeBroker broker("broker.local", "10.0.0.1", 1883);
+    nativeMillis = 1000;
+    nativePreferencesClear();
+    mqttInit();
+    setMqttSettings("broker.local", 1883, "", "", "smartlamp", "");
+    for (int i = 0; i < 1000 && !getMQTTConnected(); i++)
+    {
+        handleMQTTConnection();
+        nativeNetworkLoop();
+        delay(1);
+    }
+    TEST_ASSERT_TRUE(getMQTTConnected());
+    for (int i = 0; i < 100; i++) // Discovery and the first state
+    {
+        handleMQTTConnection();
+        delay(10);
+    }
+
+    size_t frames = broker.publishesIn;
+    size_t bytes = broker.bytesIn;
+    uint32_t counted = getMqttPublishStats().bytes;
+    uint32_t random = 12345;
+    for (unsigned long elapsed = 0; elapsed < 3600000; elapsed += 50)
+    {
+        if (elapsed % MQTT_PUBLISH_INTERVAL == 0)
+        {
+            nativeRssi = getRssi(elapsed, random);
+        }
+        handleMQTTConnection();
+        delay(50);
+    }
+    frames = broker.publishesIn - frames;
+    bytes = broker.bytesIn - bytes;
+    counted = getMqttPublishStats().bytes - counted;
+
+    char message[160];
+    snprintf(message, sizeof(message), "Firmware with a %i dBm RSSI deadband: %u PUBLISH frames with %u bytes per hour on the broker",
+             MQTT_RSSI_DEADBAND, (unsigned)frames, (unsigned)bytes);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL(counted, bytes);
+    TEST_ASSERT_LESS_THAN(simulateHour(0) / 2, bytes);
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_deadband_holds_small_changes);
+    RUN_TEST(test_rssi_deadband_reduces_bytes_on_the_wire);
+    RUN_TEST(test_firmware_frames_on_the_broker);
+    return UNITY_END();
+}